@@ -2,3 +2,9 @@ map = "maps/GDC1.txt"
 init_x = 14.7
 init_y = 14.24
 init_r = 0
+
+-- Observation likelihood model: variance of the gaussian portion and the
+-- range errors it is truncated at
+obs_variance = 1.0
+obs_d_short = 0.5
+obs_d_long = 0.5
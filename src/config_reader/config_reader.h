@@ -30,6 +30,7 @@ extern "C" {
 }
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <fstream>
 #include <memory>
@@ -39,6 +40,7 @@ extern "C" {
 #include <unordered_map>
 #include <vector>
 
+#include "config_reader/config_snapshot.h"
 #include "config_reader/lua_script.h"
 #include "config_reader/macros.h"
 #include "config_reader/types/config_generic.h"
@@ -50,9 +52,9 @@ namespace config_reader {
 inline void LuaRead(const std::vector<std::string>& files) {
   // Create the LuaScript object
   LuaScript script(files);
-  // Loop through the unordered map
-  for (const auto& pair : MapSingleton::Singleton()) {
-    config_types::TypeInterface* t = pair.second.get();
+  // Loop through the registered vars
+  for (const auto& var : MapSingleton::Singleton()) {
+    config_types::TypeInterface* t = var.get();
     if (t->GetType() == config_types::CNULL) {
       std::cerr << "Key has a type CNULL!" << std::endl;
       return;
@@ -60,6 +62,16 @@ inline void LuaRead(const std::vector<std::string>& files) {
     t->SetValue(&script);
   }
   *MapSingleton::NewKeyAdded() = false;
+  // Publish all the values read at once, so snapshot readers never see a
+  // partially applied reload
+  const KeyRegistry& registry = MapSingleton::Singleton();
+  std::shared_ptr<ConfigSnapshot> snapshot = std::make_shared<ConfigSnapshot>(
+      registry.size(),
+      SnapshotRegistry::Version()->load(std::memory_order_relaxed) + 1);
+  for (const auto& var : registry) {
+    var->Store(snapshot.get());
+  }
+  PublishSnapshot(snapshot);
 }
 
 class ConfigReader {
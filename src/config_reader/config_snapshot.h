@@ -0,0 +1,193 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// Immutable snapshots of all config values. Every reload builds a complete new
+// snapshot and publishes it with a single pointer swap, so a reader holding a
+// snapshot sees one consistent version of every key and never a value that is
+// being written. Readers on hot paths call CurrentSnapshot(), which costs one
+// atomic load and a reference count increment unless a reload happened since
+// the thread's last call.
+
+#ifndef CONFIGREADER_CONFIG_SNAPSHOT_H_
+#define CONFIGREADER_CONFIG_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace config_reader {
+
+// Handle to a config key in a snapshot, declared by the CONFIG_* macros as
+// CONFIG_KEY_<name>.
+template <typename T>
+struct ConfigKey {
+  explicit ConfigKey(size_t slot) : slot(slot) {}
+  size_t slot;
+};
+
+class ConfigSnapshot {
+ public:
+  ConfigSnapshot(size_t num_slots, uint64_t version)
+      : version_(version), numbers_(num_slots, 0), strings_(num_slots) {}
+
+  // Number of reloads before this snapshot was built.
+  uint64_t GetVersion() const { return version_; }
+
+  // Keys registered after the snapshot was built read as zero / empty until
+  // the next reload picks them up.
+  template <typename T>
+  T Get(const ConfigKey<T>& key) const {
+    if (key.slot >= numbers_.size()) return T();
+    return static_cast<T>(numbers_[key.slot]);
+  }
+
+  const std::string& Get(const ConfigKey<std::string>& key) const {
+    static const std::string kEmpty;
+    if (key.slot >= strings_.size()) return kEmpty;
+    return strings_[key.slot];
+  }
+
+  // Only used while building the snapshot, before it is published.
+  void Set(size_t slot, double value) { numbers_[slot] = value; }
+  void Set(size_t slot, const std::string& value) { strings_[slot] = value; }
+
+ private:
+  uint64_t version_;
+  // Every supported numeric type (int, unsigned int, float, double, bool) is
+  // exactly representable as a double.
+  std::vector<double> numbers_;
+  std::vector<std::string> strings_;
+};
+
+using ConfigSnapshotPtr = std::shared_ptr<const ConfigSnapshot>;
+using ConfigCallback = std::function<void(const ConfigSnapshot&)>;
+
+class SnapshotRegistry {
+ public:
+  // The published snapshot. Only accessed through std::atomic_load and
+  // std::atomic_store.
+  static ConfigSnapshotPtr* Published() {
+    static ConfigSnapshotPtr published =
+        std::make_shared<const ConfigSnapshot>(0, 0);
+    return &published;
+  }
+
+  // Incremented after every publish, so readers can tell whether their cached
+  // snapshot is stale without touching the shared_ptr.
+  static std::atomic<uint64_t>* Version() {
+    static std::atomic<uint64_t> version(0);
+    return &version;
+  }
+
+  static std::mutex* CallbackMutex() {
+    static std::mutex mutex;
+    return &mutex;
+  }
+
+  static std::vector<std::pair<int, ConfigCallback>>* Callbacks() {
+    static std::vector<std::pair<int, ConfigCallback>> callbacks;
+    return &callbacks;
+  }
+};
+
+// Published snapshot, read directly. std::atomic_load of a shared_ptr takes a
+// lock, so prefer CurrentSnapshot() on hot paths.
+inline ConfigSnapshotPtr AcquireSnapshot() {
+  return std::atomic_load(SnapshotRegistry::Published());
+}
+
+namespace internal {
+
+// Latest snapshot, cached per thread. The cache is replaced by the thread's
+// next call after a reload, so the reference must not outlive the caller's
+// expression.
+inline const ConfigSnapshotPtr& ThreadSnapshot() {
+  static thread_local ConfigSnapshotPtr cached;
+  static thread_local uint64_t cached_version = 0;
+  const uint64_t version =
+      SnapshotRegistry::Version()->load(std::memory_order_acquire);
+  if (!cached || version != cached_version) {
+    cached = AcquireSnapshot();
+    cached_version = version;
+  }
+  return cached;
+}
+
+}  // namespace internal
+
+// Latest snapshot, which the caller may keep for as long as it likes. Fetch it
+// once per cycle and read all values of that cycle from it.
+inline ConfigSnapshotPtr CurrentSnapshot() {
+  return internal::ThreadSnapshot();
+}
+
+// Value of a config key, declared by the CONFIG_* macros as CONFIG_<name>.
+// Every conversion reads the latest snapshot; fetch the snapshot once instead
+// to read several values from the same reload.
+template <typename T>
+class ConfigVar {
+ public:
+  explicit ConfigVar(const ConfigKey<T>& key) : key_(key) {}
+  operator T() const { return internal::ThreadSnapshot()->Get(key_); }
+
+ private:
+  ConfigKey<T> key_;
+};
+
+// Make @snapshot the current config, then run the change callbacks on the
+// calling thread. Called by LuaRead on the config reader daemon.
+inline void PublishSnapshot(const ConfigSnapshotPtr& snapshot) {
+  std::atomic_store(SnapshotRegistry::Published(), snapshot);
+  SnapshotRegistry::Version()->fetch_add(1, std::memory_order_release);
+  std::lock_guard<std::mutex> lock(*SnapshotRegistry::CallbackMutex());
+  for (const auto& callback : *SnapshotRegistry::Callbacks()) {
+    callback.second(*snapshot);
+  }
+}
+
+// Register @callback to be run after every reload, on the config reader
+// thread, with the new snapshot. Use it to rebuild tables derived from config
+// values off the hot path. The callback is also run once immediately with the
+// current snapshot. Returns an id for UnregisterCallback().
+inline int RegisterCallback(const ConfigCallback& callback) {
+  static int next_id = 0;
+  std::lock_guard<std::mutex> lock(*SnapshotRegistry::CallbackMutex());
+  const int id = next_id++;
+  SnapshotRegistry::Callbacks()->emplace_back(id, callback);
+  callback(*AcquireSnapshot());
+  return id;
+}
+
+inline void UnregisterCallback(int id) {
+  std::lock_guard<std::mutex> lock(*SnapshotRegistry::CallbackMutex());
+  auto* callbacks = SnapshotRegistry::Callbacks();
+  for (auto it = callbacks->begin(); it != callbacks->end(); ++it) {
+    if (it->first == id) {
+      callbacks->erase(it);
+      return;
+    }
+  }
+}
+
+}  // namespace config_reader
+
+#endif  // CONFIGREADER_CONFIG_SNAPSHOT_H_
@@ -24,49 +24,77 @@
 
 #include <atomic>
 #include <memory>
+#include <string>
+#include <utility>
 #include <unordered_map>
 #include <vector>
 
+#include "config_reader/config_snapshot.h"
 #include "config_reader/types/config_generic.h"
 #include "config_reader/types/config_numeric.h"
 #include "config_reader/types/type_interface.h"
 
 namespace config_reader {
 #define MAKE_NAME(name) CONFIG_ ## name
+#define MAKE_KEY_NAME(name) CONFIG_KEY_ ## name
 
-// Define macros for creating new config vars
-
-#define CONFIG_INT(name, key)                                                  \
-  const int& MAKE_NAME(name) =                                                 \
-      ::config_reader::InitVar<int, ::config_reader::config_types::ConfigInt>( \
-          key)
-#define CONFIG_UINT(name, key)                                    \
-  const unsigned int& MAKE_NAME(name) = ::config_reader::InitVar< \
-      unsigned int, ::config_reader::config_types::ConfigUnsignedInt>(key)
-#define CONFIG_DOUBLE(name, key)                            \
-  const double& MAKE_NAME(name) = ::config_reader::InitVar< \
-      double, ::config_reader::config_types::ConfigDouble>(key)
-#define CONFIG_FLOAT(name, key)                            \
-  const float& MAKE_NAME(name) = ::config_reader::InitVar< \
-      float, ::config_reader::config_types::ConfigFloat>(key)
-#define CONFIG_STRING(name, key)                                 \
-  const std::string& MAKE_NAME(name) = ::config_reader::InitVar< \
-      std::string, ::config_reader::config_types::ConfigString>(key)
-#define CONFIG_BOOL(name, key)       \
-  const bool& MAKE_NAME(name) =      \
-      ::config_reader::InitVar<bool, \
-                               ::config_reader::config_types::ConfigBool>(key)
+// Define macros for creating new config vars. Each declares a snapshot key,
+// CONFIG_KEY_<name>, for reading several values from one ConfigSnapshot, and
+// CONFIG_<name>, which converts to the value in the latest published snapshot.
+// Neither reads the value the config reader thread writes.
 
-class MapSingleton {
-  static constexpr int kNumMapBuckets = 1000000;
+#define DECLARE_CONFIG(CPPType, ConfigType, name, key)                       \
+  const ::config_reader::ConfigKey<CPPType> MAKE_KEY_NAME(name) =            \
+      ::config_reader::InitKey<CPPType,                                      \
+                               ::config_reader::config_types::ConfigType>(   \
+          key);                                                              \
+  const ::config_reader::ConfigVar<CPPType> MAKE_NAME(name)(MAKE_KEY_NAME(name))
+
+#define CONFIG_INT(name, key) DECLARE_CONFIG(int, ConfigInt, name, key)
+#define CONFIG_UINT(name, key) \
+  DECLARE_CONFIG(unsigned int, ConfigUnsignedInt, name, key)
+#define CONFIG_DOUBLE(name, key) DECLARE_CONFIG(double, ConfigDouble, name, key)
+#define CONFIG_FLOAT(name, key) DECLARE_CONFIG(float, ConfigFloat, name, key)
+#define CONFIG_STRING(name, key) \
+  DECLARE_CONFIG(std::string, ConfigString, name, key)
+#define CONFIG_BOOL(name, key) DECLARE_CONFIG(bool, ConfigBool, name, key)
 
+// Registered config vars, in registration order. A var's index is its slot in
+// config snapshots, so once a CONFIG_KEY_<name> handle is resolved at static
+// init, reading the var is an array index. The key lookup is only used while
+// registering and grows with the keys actually declared.
+class KeyRegistry {
  public:
-  using KeyLookupMap =
-      std::unordered_map<std::string,
-                         std::unique_ptr<config_types::TypeInterface>>;
+  using Entries = std::vector<std::unique_ptr<config_types::TypeInterface>>;
+
+  config_types::TypeInterface* Find(const std::string& key) const {
+    const auto it = index_.find(key);
+    return (it == index_.end()) ? nullptr : entries_[it->second].get();
+  }
 
-  static KeyLookupMap& Singleton() {
-    static KeyLookupMap config(kNumMapBuckets);
+  // Takes ownership of @var and assigns it the next slot. Returns nullptr if
+  // the key is already registered.
+  config_types::TypeInterface* Insert(config_types::TypeInterface* var) {
+    std::unique_ptr<config_types::TypeInterface> owned(var);
+    if (!index_.emplace(var->GetKey(), entries_.size()).second) return nullptr;
+    var->SetSlot(entries_.size());
+    entries_.push_back(std::move(owned));
+    return var;
+  }
+
+  size_t size() const { return entries_.size(); }
+  Entries::const_iterator begin() const { return entries_.begin(); }
+  Entries::const_iterator end() const { return entries_.end(); }
+
+ private:
+  Entries entries_;
+  std::unordered_map<std::string, size_t> index_;
+};
+
+class MapSingleton {
+ public:
+  static KeyRegistry& Singleton() {
+    static KeyRegistry config;
     return config;
   }
 
@@ -76,12 +104,12 @@ class MapSingleton {
   }
 };
 
-template <typename CPPType, typename ConfigType>
-const CPPType& InitVar(const std::string& key) {
-  auto& map = MapSingleton::Singleton();
-  auto find_res = map.find(key);
-  if (find_res != map.end()) {
-    config_types::TypeInterface* ti = find_res->second.get();
+// Find or create the var for @key, checking that it has the requested type.
+template <typename ConfigType>
+ConfigType* RegisterVar(const std::string& key) {
+  auto& registry = MapSingleton::Singleton();
+  config_types::TypeInterface* ti = registry.Find(key);
+  if (ti != nullptr) {
     if (ti->GetType() != ConfigType::GetEnumType()) {
       std::cerr << "Mismatch of types for key " << key
                 << ". Existing type: " << ti->GetType()
@@ -89,17 +117,20 @@ const CPPType& InitVar(const std::string& key) {
                 << std::endl;
       exit(0);
     }
-    return static_cast<ConfigType*>(ti)->GetValue();
+    return static_cast<ConfigType*>(ti);
   }
-  auto insert_res = map.insert(
-      {key, std::unique_ptr<config_types::TypeInterface>(new ConfigType(key))});
-  if (!insert_res.second) {
+  ti = registry.Insert(new ConfigType(key));
+  if (ti == nullptr) {
     std::cerr << "Creation of " << key << " failed!" << std::endl;
     exit(0);
   }
   *MapSingleton::NewKeyAdded() = true;
-  config_types::TypeInterface* ti = insert_res.first->second.get();
-  return static_cast<ConfigType*>(ti)->GetValue();
+  return static_cast<ConfigType*>(ti);
+}
+
+template <typename CPPType, typename ConfigType>
+ConfigKey<CPPType> InitKey(const std::string& key) {
+  return ConfigKey<CPPType>(RegisterVar<ConfigType>(key)->GetSlot());
 }
 }  // namespace config_reader
 
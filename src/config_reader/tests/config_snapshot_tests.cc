@@ -0,0 +1,156 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config_reader/config_snapshot.h"
+
+using config_reader::ConfigKey;
+using config_reader::ConfigSnapshot;
+using config_reader::ConfigSnapshotPtr;
+using config_reader::ConfigVar;
+using config_reader::CurrentSnapshot;
+using config_reader::PublishSnapshot;
+using std::string;
+
+namespace {
+
+const size_t kNumSlots = 8;
+
+// A snapshot in which every number is @version, as a reload of a config file
+// edited in one go would produce.
+ConfigSnapshotPtr MakeSnapshot(uint64_t version) {
+  std::shared_ptr<ConfigSnapshot> snapshot =
+      std::make_shared<ConfigSnapshot>(kNumSlots, version);
+  for (size_t slot = 0; slot + 1 < kNumSlots; ++slot) {
+    snapshot->Set(slot, static_cast<double>(version));
+  }
+  snapshot->Set(kNumSlots - 1, "version " + std::to_string(version));
+  return snapshot;
+}
+
+uint64_t LatestVersion() {
+  return CurrentSnapshot()->GetVersion();
+}
+
+TEST(ConfigSnapshot, GetReadsTypedSlots) {
+  const ConfigSnapshotPtr snapshot = MakeSnapshot(3);
+  EXPECT_EQ(3, snapshot->Get(ConfigKey<int>(0)));
+  EXPECT_EQ(3.0f, snapshot->Get(ConfigKey<float>(1)));
+  EXPECT_TRUE(snapshot->Get(ConfigKey<bool>(2)));
+  EXPECT_EQ("version 3", snapshot->Get(ConfigKey<string>(kNumSlots - 1)));
+  // Keys registered after the snapshot was built.
+  EXPECT_EQ(0.0, snapshot->Get(ConfigKey<double>(kNumSlots)));
+  EXPECT_EQ("", snapshot->Get(ConfigKey<string>(kNumSlots)));
+}
+
+TEST(ConfigSnapshot, HeldSnapshotSurvivesReload) {
+  PublishSnapshot(MakeSnapshot(LatestVersion() + 1));
+  const ConfigSnapshotPtr held = CurrentSnapshot();
+  const uint64_t version = held->GetVersion();
+  const ConfigVar<double> var((ConfigKey<double>(0)));
+  PublishSnapshot(MakeSnapshot(version + 1));
+  // Reading a config var refreshes the thread's cached snapshot, which must
+  // not free the one still held.
+  EXPECT_EQ(static_cast<double>(version + 1), static_cast<double>(var));
+  EXPECT_EQ(version, held->GetVersion());
+  EXPECT_EQ(static_cast<double>(version), held->Get(ConfigKey<double>(0)));
+  EXPECT_EQ("version " + std::to_string(version),
+            held->Get(ConfigKey<string>(kNumSlots - 1)));
+}
+
+TEST(ConfigSnapshot, ReadersSeeConsistentSnapshotsDuringReloads) {
+  const uint64_t first = LatestVersion() + 1;
+  const uint64_t kNumReloads = 2000;
+  PublishSnapshot(MakeSnapshot(first));
+  std::atomic<bool> done(false);
+  std::atomic<int> errors(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 3; ++r) {
+    readers.emplace_back([&]() {
+      const ConfigVar<int> var((ConfigKey<int>(0)));
+      uint64_t last = 0;
+      while (!done.load()) {
+        const ConfigSnapshotPtr snapshot = CurrentSnapshot();
+        const uint64_t version = snapshot->GetVersion();
+        for (size_t slot = 0; slot + 1 < kNumSlots; ++slot) {
+          if (snapshot->Get(ConfigKey<double>(slot)) != version) ++errors;
+        }
+        if (snapshot->Get(ConfigKey<string>(kNumSlots - 1)) !=
+            "version " + std::to_string(version)) {
+          ++errors;
+        }
+        // Reloads are seen in order, by snapshots and config vars alike.
+        if (version < last) ++errors;
+        const uint64_t var_version = static_cast<uint64_t>(
+            static_cast<int>(var));
+        if (var_version < version) ++errors;
+        last = var_version;
+      }
+    });
+  }
+  for (uint64_t v = first + 1; v <= first + kNumReloads; ++v) {
+    PublishSnapshot(MakeSnapshot(v));
+  }
+  done = true;
+  for (std::thread& reader : readers) reader.join();
+  EXPECT_EQ(0, errors.load());
+  EXPECT_EQ(first + kNumReloads, LatestVersion());
+}
+
+TEST(ConfigSnapshot, CallbacksRunOnRegisterAndEveryReload) {
+  PublishSnapshot(MakeSnapshot(LatestVersion() + 1));
+  const uint64_t version = LatestVersion();
+  std::vector<uint64_t> seen;
+  const int id = config_reader::RegisterCallback(
+      [&seen](const ConfigSnapshot& snapshot) {
+        seen.push_back(snapshot.GetVersion());
+      });
+  ASSERT_EQ(1u, seen.size());
+  EXPECT_EQ(version, seen[0]);
+
+  PublishSnapshot(MakeSnapshot(version + 1));
+  PublishSnapshot(MakeSnapshot(version + 2));
+  ASSERT_EQ(3u, seen.size());
+  EXPECT_EQ(version + 1, seen[1]);
+  EXPECT_EQ(version + 2, seen[2]);
+  // By the time a callback runs, readers already get the new snapshot.
+  int readers_behind = 0;
+  const int check_id = config_reader::RegisterCallback(
+      [&readers_behind](const ConfigSnapshot& snapshot) {
+        if (CurrentSnapshot()->GetVersion() != snapshot.GetVersion()) {
+          ++readers_behind;
+        }
+      });
+  PublishSnapshot(MakeSnapshot(version + 3));
+  EXPECT_EQ(0, readers_behind);
+
+  config_reader::UnregisterCallback(id);
+  config_reader::UnregisterCallback(check_id);
+  PublishSnapshot(MakeSnapshot(version + 4));
+  EXPECT_EQ(4u, seen.size());
+}
+
+}  // namespace
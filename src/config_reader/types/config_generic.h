@@ -40,7 +40,9 @@ namespace config_types {
       val_ = lua_script->GetVariable<CPPType>(key_);                \
     }                                                               \
                                                                     \
-    const CPPType& GetValue() { return this->val_; }                \
+    void Store(ConfigSnapshot* snapshot) const override {           \
+      snapshot->Set(slot_, val_);                                   \
+    }                                                               \
                                                                     \
     static Type GetEnumType() { return Type::EnumName; }            \
                                                                     \
@@ -62,7 +62,9 @@ namespace config_types {
       val_ = value;                                                     \
     }                                                                   \
                                                                         \
-    const CPPType& GetValue() { return this->val_; }                    \
+    void Store(ConfigSnapshot* snapshot) const override {               \
+      snapshot->Set(slot_, val_);                                       \
+    }                                                                   \
                                                                         \
     static Type GetEnumType() { return Type::EnumName; }                \
                                                                         \
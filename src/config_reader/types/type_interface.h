@@ -22,9 +22,12 @@
 #ifndef CONFIGREADER_TYPES_TYPE_INTERFACE_H_
 #define CONFIGREADER_TYPES_TYPE_INTERFACE_H_
 
+#include <stddef.h>
+
 #include <iostream>
 #include <string>
 
+#include "config_reader/config_snapshot.h"
 #include "config_reader/lua_script.h"
 
 namespace config_reader {
@@ -44,15 +47,21 @@ class TypeInterface {
  public:
   TypeInterface() = delete;
   TypeInterface(const std::string& key, const Type& type)
-      : key_(key), type_(type) {}
+      : key_(key), type_(type), slot_(0) {}
   virtual ~TypeInterface() {}
   std::string GetKey() const { return key_; };
   Type GetType() const { return type_; };
+  // Index of the value in config snapshots, assigned at registration.
+  size_t GetSlot() const { return slot_; }
+  void SetSlot(size_t slot) { slot_ = slot; }
   virtual void SetValue(LuaScript* lua_script) = 0;
+  // Copy the current value into @snapshot while it is being built.
+  virtual void Store(ConfigSnapshot* snapshot) const = 0;
 
  protected:
   std::string key_;
   Type type_;
+  size_t slot_;
 };
 }  // namespace config_types
 }  // namespace config_reader
@@ -1,5 +1,11 @@
 #include "global_planner.h"
 
+#include <algorithm>
+
+#include "shared/util/metrics.h"
+#include "shared/util/trace.h"
+#include "visualization/viz_channel.h"
+
 using std::string;
 using std::vector;
 using Eigen::Vector2f;
@@ -8,12 +14,31 @@ using std::cout;
 using std::endl;
 using geometry::line2f;
 
+namespace {
+// Humans further than this from a node don't contribute to its social cost (m)
+const float kSocialRadius = 10;
+// How far ahead human motion is predicted, and the spacing of the predictions (s)
+const float kPredictionHorizon = 8;
+const float kPredictionBucket = 0.5;
+// Deviation from the predicted human pose that triggers a replan (m, rad)
+const float kReplanDistance = 0.5;
+const float kReplanAngle = 0.5;
+// A newly tracked human only forces a replan when this close to the current path (m)
+const float kNewHumanPathDistance = 3;
+
+util::metrics::Counter expansions_("global_planner_expansions_total", "Nodes expanded by A*");
+} // namespace
+
 //========================= GENERAL FUNCTIONS =========================//
 
-GlobalPlanner::GlobalPlanner(){
+GlobalPlanner::GlobalPlanner(Clock clock) :
+human_index_(kSocialRadius / 2),
+predictor_(kPredictionHorizon, kPredictionBucket, kSocialRadius / 2),
+clock_(clock)
+{
 	// Initialize blueprint map
-	map_.Load("maps/GDC1.txt");
-	cout << "Initialized GDC1 map with " << map_.lines.size() << " lines." << endl;
+	map_ = vector_map::LoadShared("maps/GDC1.txt");
+	cout << "Initialized GDC1 map with " << map_->lines.size() << " lines." << endl;
 }
 
 void GlobalPlanner::setResolution(float resolution){
@@ -21,6 +46,10 @@ void GlobalPlanner::setResolution(float resolution){
 	cout << "Resolution set to: " << map_resolution_ << endl;
 }
 
+void GlobalPlanner::setNominalSpeed(float speed){
+	nominal_speed_ = speed;
+}
+
 
 //========================= NODE FUNCTIONS ============================//
 
@@ -71,7 +100,7 @@ bool GlobalPlanner::isValidNeighbor(const Node &node, const Neighbor &neighbor){
 	auto cushion_lines = getCushionLines(edge, 0.5);
 
 	// Check for collisions
-	for (const line2f map_line : map_.lines)
+	for (const line2f map_line : map_->lines)
     {
 		bool intersection = map_line.Intersects(edge);
 		for (const line2f bounding_box_edge : cushion_lines){
@@ -177,25 +206,82 @@ void GlobalPlanner::addHuman(human::Human* Bob){
 	population_.push_back(Bob);
 	population_locs_.push_back(Bob->getLoc());
 	population_angles_.push_back(Bob->getAngle());
+	population_vels_.push_back(Bob->getVel());
+	population_angular_vels_.push_back(Bob->getAngularVel());
+	population_times_.push_back(clock_());
+	human_index_.insert(Bob);
+}
+
+void GlobalPlanner::insertHuman(human::Human* Bob){
+	const bool replan_needed = need_social_replan_ or isNearPath(Bob->getLoc(), kNewHumanPathDistance);
+	addHuman(Bob);
+	need_social_replan_ = replan_needed;
+}
+
+void GlobalPlanner::updateHuman(human::Human* Bob){
+	human_index_.update(Bob);
+}
+
+void GlobalPlanner::removeHuman(human::Human* Bob){
+	const auto it = std::find(population_.begin(), population_.end(), Bob);
+	if (it == population_.end()) return;
+	const size_t i = it - population_.begin();
+	population_.erase(population_.begin() + i);
+	population_locs_.erase(population_locs_.begin() + i);
+	population_angles_.erase(population_angles_.begin() + i);
+	population_vels_.erase(population_vels_.begin() + i);
+	population_angular_vels_.erase(population_angular_vels_.begin() + i);
+	population_times_.erase(population_times_.begin() + i);
+	human_index_.remove(Bob);
+}
+
+bool GlobalPlanner::isNearPath(const Vector2f &loc, float distance){
+	for (const string &key : global_path_){
+		if ((nav_map_[key].loc - loc).norm() < distance) return true;
+	}
+	return false;
 }
 
 void GlobalPlanner::clearPopulation(){
 	population_.clear();
+	population_locs_.clear();
+	population_angles_.clear();
+	population_vels_.clear();
+	population_angular_vels_.clear();
+	population_times_.clear();
+	human_index_.clear();
+	predictor_.clear();
+}
+
+void GlobalPlanner::predictHumans(){
+	for (size_t i = 0; i < population_.size(); i++) snapshotHuman(i);
+	predictor_.predict(population_);
+}
+
+void GlobalPlanner::snapshotHuman(size_t i){
+	population_locs_[i] = population_[i]->getLoc();
+	population_angles_[i] = population_[i]->getAngle();
+	population_vels_[i] = population_[i]->getVel();
+	population_angular_vels_[i] = population_[i]->getAngularVel();
+	population_times_[i] = clock_();
 }
 
 bool GlobalPlanner::needSocialReplan(Eigen::Vector2f robot_loc){
 	if (need_social_replan_) return true;
 
+	// The plan already accounts for humans following their predicted motion
+	const double now = clock_();
 	for (size_t i = 0; i < population_.size(); i++){
 		const human::Human &person = *population_[i];
-		if (person.isHidden(robot_loc, map_)) continue; // Do not replan if we cannot see the human
-
-		bool human_moved  = (person.getLoc() - population_locs_[i]).norm() > 0.5;
-		bool human_turned = abs(math_util::AngleDiff(person.getAngle(), population_angles_[i])) > 0.5;
+		human_index_.update(population_[i]);
+		if (person.isHidden(robot_loc, *map_)) continue; // Do not replan if we cannot see the human
+
+		const float t = now - population_times_[i];
+		const Vector2f expected_loc = population_locs_[i] + population_vels_[i] * t;
+		const float expected_angle = population_angles_[i] + population_angular_vels_[i] * t;
+		bool human_moved  = (person.getLoc() - expected_loc).norm() > kReplanDistance;
+		bool human_turned = abs(math_util::AngleDiff(person.getAngle(), expected_angle)) > kReplanAngle;
 		need_social_replan_ = need_social_replan_ or human_moved or human_turned;
-
-		if (human_moved)  population_locs_[i]   = person.getLoc();
-		if (human_turned) population_angles_[i] = person.getAngle();
 	}
 
 	return need_social_replan_;
@@ -212,15 +298,17 @@ float GlobalPlanner::getSocialCost(Node &new_node){
 	// 'n' is none, 's' is safety, 'v' is visibility, 'h' is hidden
 	char social_type = 'n';
 
-	for(auto &H : population_){
-		// Skip if node is further than 10m from this human
-		if ( (new_node.loc - H->getLoc()).norm() > 10 ) continue;
-		
+	// Use the humans as they are predicted to be when the robot gets here
+	const int layer = predictor_.layerAt(new_node.cost / nominal_speed_);
+	const human::HumanIndex &humans = (layer == 0) ? human_index_ : predictor_.getLayer(layer);
+
+	// Only humans within 10m of the node contribute
+	humans.forEachNear(new_node.loc, kSocialRadius, [&](human::Human* H){
 		// If node is hidden behind wall, return surprise factor
-		if ( H->isHidden(new_node.loc, map_) ){
+		if ( H->isHidden(new_node.loc, *map_) ){
 			// Line of sight from human to node
 			const line2f view_line(H->getLoc(), new_node.loc);
-			for (const line2f map_line : map_.lines){
+			for (const line2f map_line : map_->lines){
 				Vector2f intersection_point;
 				bool intersects = map_line.Intersection(view_line, &intersection_point);
 				if (intersects){
@@ -235,22 +323,27 @@ float GlobalPlanner::getSocialCost(Node &new_node){
 		}
 		// Otherwise, return safety or visibility factor, whichever is higher
 		else{
-			safety_cost = H->safetyCost(new_node.loc);
-			visibility_cost = H->visibilityCost(new_node.loc);
+			H->stampCosts(new_node.loc, &safety_cost, &visibility_cost);
 			float social_cost = std::max(safety_cost, visibility_cost);
 			if (social_cost > max_social_cost){
 				max_social_cost = social_cost;
 				social_type = (safety_cost > visibility_cost) ? 's' : 'v';
 			}
 		}
-	}
+	});
 	new_node.social_type = social_type;
 	// Scale by arbitrary factor to weight social costs with distance costs appropriately
 	return max_social_cost;
 }
 
 void GlobalPlanner::getGlobalPath(Vector2f nav_goal_loc){
+	static CumulativeFunctionTimer function_timer_(__FUNCTION__);
+	CumulativeFunctionTimer::Invocation invoke(&function_timer_);
+	TRACE_FUNCTION();
 	nav_goal_ = nav_goal_loc;
+	// Humans may have moved since they were last filed
+	human_index_.updateAll();
+	predictHumans();
 
 	bool global_path_success = false;
 	int loop_counter = 0; // exit condition if while loop gets stuck (goal unreachable)
@@ -292,6 +385,7 @@ void GlobalPlanner::getGlobalPath(Vector2f nav_goal_loc){
 		}
 		loop_counter++;
 	}
+	expansions_.Increment(loop_counter);
 
 	vector<string> global_path;
 	if (global_path_success){
@@ -346,7 +440,7 @@ Node GlobalPlanner::getClosestPathNode(Eigen::Vector2f robot_loc, amrl_msgs::Vis
 
 	// Draw Circle around Robot's Location that will Intersect with Global Path
 	float circle_rad_min = 2.0;
-	visualization::DrawArc(robot_loc,circle_rad_min,0.0,2*M_PI,0x909090, msg);
+	if (visualization::kVisualizationEnabled) visualization::DrawArc(robot_loc,circle_rad_min,0.0,2*M_PI,0x909090, msg);
 
 	// Find the closest node to the robot
 	float min_distance = 100;
@@ -385,9 +479,9 @@ Node GlobalPlanner::getClosestPathNode(Eigen::Vector2f robot_loc, amrl_msgs::Vis
 		Vector2f target_loc = nav_map_[global_path_[i]].loc;
 		line2f car_to_goal(robot_loc, target_loc);
 
-		visualization::DrawLine(robot_loc, target_loc, 0x000000, msg);
+		if (visualization::kVisualizationEnabled) visualization::DrawLine(robot_loc, target_loc, 0x000000, msg);
 
-		bool intersection = map_.Intersects(robot_loc, target_loc);
+		bool intersection = map_->Intersects(robot_loc, target_loc);
 		if (!intersection){
 			target_node = nav_map_[global_path_[i]];
 			return target_node;
@@ -405,7 +499,15 @@ Node GlobalPlanner::getClosestPathNode(Eigen::Vector2f robot_loc, amrl_msgs::Vis
 
 bool GlobalPlanner::needsReplan(){return need_replan_;}
 
+void GlobalPlanner::getPathLocations(vector<Vector2f>* locs) const{
+	locs->clear();
+	// A failed plan leaves only the start node, which successful paths never include
+	if (global_path_.size() == 1 and global_path_.front() == "START") return;
+	for (const string &key : global_path_) locs->push_back(nav_map_.at(key).loc);
+}
+
 void GlobalPlanner::replan(Vector2f robot_loc, Vector2f failed_target_loc){
+	TRACE_FUNCTION();
 	
 	if ( (robot_loc - failed_target_loc).norm() > 1.41*map_resolution_)	// 1.41 for sqrt(2)
 		failed_locs_.push_back(failed_target_loc);
@@ -471,10 +573,9 @@ void GlobalPlanner::plotSocialCosts(amrl_msgs::VisualizationMsg &msg){
 }
 
 void GlobalPlanner::plotFrontier(amrl_msgs::VisualizationMsg &msg){
-	while(!frontier_.Empty()){
-		string frontier_key = frontier_.Pop();
-		Vector2f frontier_loc = nav_map_[frontier_key].loc;
-		visualization::DrawPoint(frontier_loc, 0x0000ff, msg);
+	for (const auto &entry : frontier_.Values()){
+		const auto node = nav_map_.find(entry.first);
+		if (node != nav_map_.end()) visualization::DrawPoint(node->second.loc, 0x0000ff, msg);
 	}
 }
 
@@ -500,7 +601,5 @@ void GlobalPlanner::plotNodeNeighbors(const Node &node, amrl_msgs::Visualization
 }
 
 void GlobalPlanner::plotInvalidNodes(amrl_msgs::VisualizationMsg &msg){
-	for (const Vector2f &loc : failed_locs_){
-		visualization::DrawCross(loc, 0.5, 0x000000, msg);
-	}
+	visualization::DrawCrosses(failed_locs_, 0.5, 0x000000, msg);
 }
@@ -1,6 +1,8 @@
 #ifndef GLOBAL_PLANNER_CS393R_HH
 #define GLOBAL_PLANNER_CS393R_HH
 
+#include <functional>
+
 #include "eigen3/Eigen/Dense"
 #include "amrl_msgs/VisualizationMsg.h"
 #include "glog/logging.h"
@@ -15,6 +17,8 @@
 #include "vector_map/vector_map.h"
 #include "navigation/simple_queue.h"
 #include "human.h"
+#include "human_index.h"
+#include "human_predictor.h"
 
 struct Neighbor{
   Eigen::Vector2i node_index;
@@ -38,10 +42,15 @@ struct Node{
 class GlobalPlanner{
 
 public:
-	// Default Constructor
-	GlobalPlanner();
+	// Source of the current time in seconds, used to extrapolate human motion between
+	// plans. Injected so the planner follows simulated or recorded time.
+	typedef std::function<double()> Clock;
+
+	explicit GlobalPlanner(Clock clock);
 	// Set the map resolution
 	void setResolution(float resolution);
+	// Set the speed used to estimate when the robot reaches each node
+	void setNominalSpeed(float speed);
 	// Initialize the navigation map at the start point and update the planner resolution
 	void initializeMap(Eigen::Vector2f start_loc);
 	// Instantiate a new node as a child of another node
@@ -52,7 +61,7 @@ public:
 	float edgeCost(const Node &node_A,const Node &node_B);
 	// Update valid neighbors and edge costs
 	void visitNode(Node &node);
-	// Get social cost of a particular node
+	// Get social cost of a particular node at the time the robot is predicted to reach it
 	float getSocialCost(Node &node);
 	// Get the best sequence of node keys to the nav_goal_ point
 	void getGlobalPath(Eigen::Vector2f nav_goal_loc);
@@ -62,10 +71,18 @@ public:
 	Node getClosestPathNode(Eigen::Vector2f robot_loc, amrl_msgs::VisualizationMsg &msg);
 	// Check if we need to replan
 	bool needsReplan();
+	// Locations of the current global path nodes, start first. Empty if the last plan failed.
+	void getPathLocations(std::vector<Eigen::Vector2f>* locs) const;
 	// Replan while avoiding failed nodes
 	void replan(Eigen::Vector2f robot_loc, Eigen::Vector2f failed_target_loc);
 	// Add a person to the human population
 	void addHuman(human::Human* Bob);
+	// Add a tracked person, only replanning if they are close to the current path
+	void insertHuman(human::Human* Bob);
+	// Refile a tracked person after their state changed
+	void updateHuman(human::Human* Bob);
+	// Forget a person
+	void removeHuman(human::Human* Bob);
 	// Clear the known population
 	void clearPopulation();
 	// Check if we need to replan around new/moved humans
@@ -84,6 +101,12 @@ private:
 	// Helper Functions
 	std::string getNewID(int xi, int yi);
 	std::vector<Neighbor> getNeighbors(const Node &node);
+	// Snapshot the population and predict its motion for the next plan
+	void predictHumans();
+	// Record the state of population_[i] that its motion is predicted from
+	void snapshotHuman(size_t i);
+	// Whether a location is within distance of the current global path
+	bool isNearPath(const Eigen::Vector2f &loc, float distance);
 	std::array<geometry::line2f,4> getCushionLines(geometry::line2f edge, float offset);
 
 	// Navigation map (key, Node)
@@ -93,7 +116,7 @@ private:
 	// Priority Queue (key, priority)
 	SimpleQueue<std::string, float> frontier_;
 	// Blueprint map of the environment
-	public: vector_map::VectorMap map_;	// Made this public so it can be accessed in Navigation
+	public: std::shared_ptr<const vector_map::VectorMap> map_;	// Made this public so it can be accessed in Navigation
 	// Current goal
 	Eigen::Vector2f nav_goal_;
 	// Global path variable
@@ -104,12 +127,25 @@ private:
 	std::vector<Eigen::Vector2f> failed_locs_;
 	// Vector of all known humans
 	std::vector<human::Human*> population_;
-	// Vector of original human locations (used for replanning)
+	// Spatial index of population_ so node costs only visit nearby humans
+	human::HumanIndex human_index_;
+	// Predicted humans over the planning horizon, refreshed for every plan
+	human::HumanPredictor predictor_;
+	// Speed used to convert path length into arrival time (m/s)
+	float nominal_speed_ = 1.0;
+	// Vector of human locations at prediction time (used for replanning)
 	std::vector<Eigen::Vector2f> population_locs_;
-	// Vector of original human angles (used for replanning)
+	// Vector of human angles at prediction time (used for replanning)
 	std::vector<float> population_angles_;
+	// Vectors of human velocities at prediction time (used for replanning)
+	std::vector<Eigen::Vector2f> population_vels_;
+	std::vector<float> population_angular_vels_;
+	// Vector of times the human states above were recorded
+	std::vector<double> population_times_;
 	// Check to see if we need to update the global plan due to human motion
 	bool need_social_replan_ = false;
+	// Time source for population_times_
+	Clock clock_;
 };
 
 #endif
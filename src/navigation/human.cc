@@ -2,6 +2,7 @@
 #include "shared/math/math_util.h"
 #include "visualization/visualization.h"
 #include "shared/math/line2d.h"
+#include <algorithm>
 #include <iostream>
 
 using Eigen::Vector2f;
@@ -16,10 +17,33 @@ using visualization::DrawLine;
 using visualization::DrawArc;
 
 
+namespace {
+// Half width of the cost stamp (m); the planner ignores humans further away than this
+const float kStampRadius = 10;
+// Cell size of the cost stamp (m)
+const float kStampResolution = 0.1;
+
+// |atan2(y, x)| in [0, pi] for every element, using a polynomial approximation
+// of atan on [0, 1] (max error ~1e-5 rad) so that the whole expression vectorizes
+Eigen::ArrayXf absAtan2(const Eigen::ArrayXf &y, const Eigen::ArrayXf &x){
+	const Eigen::ArrayXf abs_x = x.abs();
+	const Eigen::ArrayXf abs_y = y.abs();
+	const Eigen::ArrayXf ratio = abs_x.min(abs_y) / abs_x.max(abs_y).max(1e-30f);
+	const Eigen::ArrayXf ratio_sq = ratio.square();
+	Eigen::ArrayXf angle = ((((0.0208351f * ratio_sq - 0.085133f) * ratio_sq + 0.180141f) * ratio_sq
+	                         - 0.3302995f) * ratio_sq + 0.999866f) * ratio;
+	angle = (abs_y > abs_x).select(float(M_PI/2) - angle, angle);
+	angle = (x < 0).select(float(M_PI) - angle, angle);
+	return angle;
+}
+} // namespace
+
 namespace human{
 
 // Constructor
 Human::Human() :
+vel_(0, 0),
+angular_vel_(0),
 standing_(true),
 FOV_(3*M_PI/4),
 vision_range_(5),
@@ -27,7 +51,9 @@ safety_x_variance_(4),
 safety_y_variance_(4),
 visibility_r_variance_(10),
 visibility_t_variance_(2),
-hidden_decay_constant_(1)
+hidden_decay_constant_(1),
+stamp_valid_(false),
+stamp_builds_(0)
 {
 	setLoc({0,0});
 	setAngle(0);
@@ -47,10 +73,15 @@ bool Human::isMoving() const		{return vel_.norm() + abs(angular_vel_) > 0.005;}
 void Human::setLoc(Vector2f loc) 		{loc_   	  = loc;}
 void Human::setVel(Vector2f vel)		{vel_   	  = vel;}
 void Human::setAngularVel(float omega)	{angular_vel_ = omega;}
-void Human::setFOV(float phi)			{FOV_ 		  = phi;}
-void Human::setStanding(bool state)		{standing_    = state;}
+void Human::setFOV(float phi)			{FOV_ 		  = phi; stamp_valid_ = false;}
+void Human::setStanding(bool state) {
+	if (state != standing_) stamp_valid_ = false;
+	standing_ = state;
+}
 void Human::setAngle(float theta) {
 	angle_ 	    = theta; 
+	cos_angle_  = cos(angle_);
+	sin_angle_  = sin(angle_);
 	R_map2local = Eigen::Rotation2Df(-angle_);
 	R_local2map = Eigen::Rotation2Df(angle_);
 }
@@ -60,11 +91,13 @@ void Human::setAngle(float theta) {
 void Human::setSafetyStdDev(float sigma_x, float sigma_y) {
 	safety_x_variance_ = Sq(sigma_x); 
 	safety_y_variance_ = Sq(sigma_y);
+	stamp_valid_ = false;
 }
 
 void Human::setVisibilityStdDev(float sigma_r, float sigma_t){
 	visibility_r_variance_ = Sq(sigma_r);
 	visibility_t_variance_ = Sq(sigma_t);
+	stamp_valid_ = false;
 }
 
 void Human::setHiddenDecay(float k){
@@ -111,6 +144,122 @@ float Human::hiddenCost(Eigen::Vector2f robot_loc, Eigen::Vector2f obs_loc){
 
 
 
+// Batch Cost Methods
+void Human::toLocalFrame(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y,
+                         Eigen::ArrayXf *local_x, Eigen::ArrayXf *local_y) const{
+	const Eigen::ArrayXf dx = x - loc_.x();
+	const Eigen::ArrayXf dy = y - loc_.y();
+	*local_x = cos_angle_ * dx + sin_angle_ * dy;
+	*local_y = cos_angle_ * dy - sin_angle_ * dx;
+}
+
+void Human::safetyCosts(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y, Eigen::ArrayXf *costs) const{
+	Eigen::ArrayXf local_x, local_y;
+	toLocalFrame(x, y, &local_x, &local_y);
+	const float inv_x_var = 1.0 / (safety_x_variance_ + 1.25 * safety_x_variance_ * (!standing_));
+	const float inv_y_var = 1.0 / (safety_y_variance_ + 1.25 * safety_y_variance_ * (!standing_));
+	*costs = 20 * (-local_x.square() * inv_x_var - local_y.square() * inv_y_var).exp(); // weighted
+}
+
+void Human::visibilityCosts(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y, Eigen::ArrayXf *costs) const{
+	Eigen::ArrayXf abs_bearing;
+	visibilityField(x, y, costs, &abs_bearing);
+	*costs = (abs_bearing < FOV_/2).select(Eigen::ArrayXf::Zero(x.size()), *costs);
+}
+
+void Human::visibilityField(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y,
+                            Eigen::ArrayXf *costs, Eigen::ArrayXf *abs_bearing) const{
+	Eigen::ArrayXf local_x, local_y;
+	toLocalFrame(x, y, &local_x, &local_y);
+	const float inv_r_var = 1.0 / (visibility_r_variance_ + 1.25 * visibility_r_variance_ * (!standing_));
+	const float inv_t_var = 1.0 / (visibility_t_variance_ + 1.25 * visibility_t_variance_ * (!standing_));
+
+	// The bearing of a point from the human is the angle of its local frame coordinates
+	*abs_bearing = absAtan2(local_y, local_x);
+	const Eigen::ArrayXf rSq = local_x.square() + local_y.square();
+	*costs = 20 * (-rSq * inv_r_var - (float(M_PI) - *abs_bearing).square() * inv_t_var).exp(); // weighted
+}
+
+void Human::hiddenCosts(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y,
+                        const Eigen::ArrayXf &obs_x, const Eigen::ArrayXf &obs_y,
+                        Eigen::ArrayXf *costs) const{
+	Eigen::ArrayXf local_x, local_y;
+	toLocalFrame(x, y, &local_x, &local_y);
+	const Eigen::ArrayXf abs_bearing = absAtan2(local_y, local_x);
+	const Eigen::ArrayXf rSq = local_x.square() + local_y.square();
+	const Eigen::ArrayXf obs_dist = ((obs_x - x).square() + (obs_y - y).square()).sqrt();
+	const Eigen::ArrayXf cost = 1.0 / (1.0 + hidden_decay_constant_ * obs_dist); // weighted
+	*costs = (abs_bearing < FOV_/2 and rSq < Sq(vision_range_)).select(cost, Eigen::ArrayXf::Zero(x.size()));
+}
+
+
+
+// Cost Stamp
+unsigned int Human::getStampBuilds() const {return stamp_builds_;}
+void Human::prepareStamp() {if (not stamp_valid_) buildStamp();}
+
+void Human::buildStamp(){
+	const int n = 2 * int(kStampRadius / kStampResolution) + 1;
+	const Eigen::ArrayXf offsets = Eigen::ArrayXf::LinSpaced(n, -kStampRadius, kStampRadius);
+
+	// Cell (i, j) is at (offsets[i], offsets[j]) in the local frame; x varies fastest to
+	// match ArrayXXf
+	Eigen::ArrayXf xs(n*n);
+	Eigen::ArrayXf ys(n*n);
+	for (int j = 0; j < n; j++){
+		xs.segment(j*n, n) = offsets;
+		ys.segment(j*n, n).setConstant(offsets[j]);
+	}
+
+	// The fields of this human placed at the origin facing +x, where map frame = local frame
+	Human local(*this);
+	local.setLoc(Vector2f(0, 0));
+	local.setAngle(0);
+	std::shared_ptr<CostStamp> stamp(new CostStamp());
+	Eigen::ArrayXf costs;
+	local.safetyCosts(xs, ys, &costs);
+	stamp->safety = Eigen::Map<Eigen::ArrayXXf>(costs.data(), n, n);
+	// The field of view is applied at lookup so its sharp edge isn't blurred by interpolation
+	Eigen::ArrayXf abs_bearing;
+	local.visibilityField(xs, ys, &costs, &abs_bearing);
+	stamp->visibility = Eigen::Map<Eigen::ArrayXXf>(costs.data(), n, n);
+
+	// Replace rather than overwrite: predicted copies may still be using the old stamp
+	stamp_ = stamp;
+	stamp_valid_ = true;
+	stamp_builds_++;
+}
+
+// Bilinearly interpolates the stamp at the robot's location in the human's frame
+void Human::stampCosts(Vector2f robot_loc, float *safety_cost, float *visibility_cost){
+	*safety_cost = 0;
+	*visibility_cost = 0;
+	const Vector2f local = toLocalFrame(robot_loc);
+	if (abs(local.x()) >= kStampRadius or abs(local.y()) >= kStampRadius) return;
+
+	prepareStamp();
+
+	const float gx = (local.x() + kStampRadius) / kStampResolution;
+	const float gy = (local.y() + kStampRadius) / kStampResolution;
+	const int last = stamp_->safety.rows() - 2;
+	const int ix = std::min(int(gx), last);
+	const int iy = std::min(int(gy), last);
+	const float fx = gx - ix;
+	const float fy = gy - iy;
+
+	auto interpolate = [&](const Eigen::ArrayXXf &stamp){
+		return (1-fy) * ((1-fx) * stamp(ix, iy)   + fx * stamp(ix+1, iy))
+		     +    fy  * ((1-fx) * stamp(ix, iy+1) + fx * stamp(ix+1, iy+1));
+	};
+	*safety_cost = interpolate(stamp_->safety);
+
+	// Inside the field of view iff the bearing is within FOV/2 of the heading
+	if (local.x() > local.norm() * cos(FOV_/2)) return;
+	*visibility_cost = interpolate(stamp_->visibility);
+}
+
+
+
 // Visualization
 void Human::show(amrl_msgs::VisualizationMsg &msg){
 	Vector2f FOV_point1 = vision_range_*Vector2f(cos(FOV_/2), sin(FOV_/2));
@@ -164,11 +313,18 @@ bool Human::isVisible(Vector2f local_loc){
 	return(vision_angle > -FOV_/2 and vision_angle < FOV_/2);
 }
 // Check if the robot is hidden from view (robot_loc is in map frame)
-bool Human::isHidden(Vector2f robot_loc, vector_map::VectorMap &map) const{
+bool Human::isHidden(Vector2f robot_loc, const vector_map::VectorMap &map) const{
 	if (map.Intersects(loc_, robot_loc)) return true;
 	return false;
 }
 
+Human Human::predict(float t) const{
+	Human future(*this);
+	future.setLoc(loc_ + vel_*t);
+	future.setAngle(math_util::AngleMod(angle_ + angular_vel_*t));
+	return future;
+}
+
 // Update the human location according to it's velocity
 void Human::move(float dt){
 	if (dt < 0.01) return;
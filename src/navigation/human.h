@@ -1,6 +1,7 @@
 #ifndef HUMAN_SIM_HH
 #define HUMAN_SIM_HH
 
+#include <memory>
 #include <vector>
 #include "eigen3/Eigen/Dense"
 
@@ -40,8 +41,30 @@ public:
 	float visibilityCost(Eigen::Vector2f robot_loc);
 	float hiddenCost(Eigen::Vector2f robot_loc, Eigen::Vector2f obs_loc);
 
+	// Batch Cost Methods: evaluate many map frame points (x[i], y[i]) at once.
+	// These match the single point versions to within the accuracy of the
+	// vectorized exp and the polynomial atan2 approximation (~1e-5 rad).
+	void safetyCosts(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y, Eigen::ArrayXf *costs) const;
+	void visibilityCosts(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y, Eigen::ArrayXf *costs) const;
+	void hiddenCosts(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y,
+	                 const Eigen::ArrayXf &obs_x, const Eigen::ArrayXf &obs_y,
+	                 Eigen::ArrayXf *costs) const;
+
+	// Cost Stamp: safety and visibility costs precomputed on a grid in the human's own
+	// frame. The fields only depend on standing_ and the cost parameters, so a moved or
+	// turned human reuses its stamp. Points outside the stamp cost 0.
+	void stampCosts(Eigen::Vector2f robot_loc, float *safety_cost, float *visibility_cost);
+	// Builds the stamp now if it is out of date, so copies made afterwards share it
+	void prepareStamp();
+	// Number of times the stamp has been (re)built, for diagnostics
+	unsigned int getStampBuilds() const;
+
+	// Copy of this human advanced t seconds at its current velocity and angular velocity.
+	// The copy shares the cost stamp, if it was prepared before copying.
+	Human predict(float t) const;
+
 	// Utility
-	bool isHidden(Eigen::Vector2f robot_loc, vector_map::VectorMap &map) const;
+	bool isHidden(Eigen::Vector2f robot_loc, const vector_map::VectorMap &map) const;
 	void move(float dt);
 
 	// Visualization
@@ -67,8 +90,25 @@ private:
 	float visibility_t_variance_;
 	float hidden_decay_constant_;
 	bool isVisible(Eigen::Vector2f local_loc);
-
-	// Frame Transforms
+	// Cost Stamp (immutable once built, so copies of this human can share it)
+	struct CostStamp{
+		Eigen::ArrayXXf safety;
+		Eigen::ArrayXXf visibility;
+	};
+	std::shared_ptr<const CostStamp> stamp_;
+	bool stamp_valid_;
+	unsigned int stamp_builds_;
+	void buildStamp();
+	// Visibility cost ignoring the field of view, and the absolute bearing of each point
+	void visibilityField(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y,
+	                     Eigen::ArrayXf *costs, Eigen::ArrayXf *abs_bearing) const;
+	// Transform map frame points to the local frame for the batch methods
+	void toLocalFrame(const Eigen::ArrayXf &x, const Eigen::ArrayXf &y,
+	                  Eigen::ArrayXf *local_x, Eigen::ArrayXf *local_y) const;
+
+	// Frame Transforms (cos and sin of angle_ are cached for the batch methods)
+	float cos_angle_;
+	float sin_angle_;
 	Eigen::Matrix2f R_map2local;
 	Eigen::Matrix2f R_local2map;
 	Eigen::Vector2f toLocalFrame(Eigen::Vector2f);
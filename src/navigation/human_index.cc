@@ -0,0 +1,81 @@
+#include "human_index.h"
+
+#include <algorithm>
+
+using Eigen::Vector2f;
+using std::vector;
+
+namespace human{
+
+HumanIndex::HumanIndex(float cell_size) :
+cell_size_(cell_size)
+{
+}
+
+void HumanIndex::insert(Human* person){
+	if (contains(person)){
+		update(person);
+		return;
+	}
+	const uint64_t key = cellKey(person->getLoc());
+	cells_[key].push_back(person);
+	cell_of_[person] = key;
+}
+
+void HumanIndex::remove(Human* person){
+	const auto entry = cell_of_.find(person);
+	if (entry == cell_of_.end()) return;
+	removeFromCell(person, entry->second);
+	cell_of_.erase(entry);
+}
+
+void HumanIndex::clear(){
+	cells_.clear();
+	cell_of_.clear();
+}
+
+void HumanIndex::update(Human* person){
+	const auto entry = cell_of_.find(person);
+	if (entry == cell_of_.end()) return;
+	const uint64_t key = cellKey(person->getLoc());
+	if (key == entry->second) return;
+	removeFromCell(person, entry->second);
+	cells_[key].push_back(person);
+	entry->second = key;
+}
+
+void HumanIndex::updateAll(){
+	for (auto &entry : cell_of_){
+		Human* person = const_cast<Human*>(entry.first);
+		const uint64_t key = cellKey(person->getLoc());
+		if (key == entry.second) continue;
+		removeFromCell(person, entry.second);
+		cells_[key].push_back(person);
+		entry.second = key;
+	}
+}
+
+size_t HumanIndex::size() const {return cell_of_.size();}
+
+bool HumanIndex::contains(const Human* person) const {return cell_of_.count(person) > 0;}
+
+vector<Human*> HumanIndex::query(const Vector2f &loc, float radius) const{
+	vector<Human*> near;
+	forEachNear(loc, radius, [&near](Human* person){ near.push_back(person); });
+	return near;
+}
+
+void HumanIndex::removeFromCell(Human* person, uint64_t key){
+	const auto cell = cells_.find(key);
+	if (cell == cells_.end()) return;
+	vector<Human*> &members = cell->second;
+	const auto it = std::find(members.begin(), members.end(), person);
+	if (it != members.end()){
+		// Order within a cell doesn't matter
+		*it = members.back();
+		members.pop_back();
+	}
+	if (members.empty()) cells_.erase(cell);
+}
+
+} // end namespace human
@@ -0,0 +1,70 @@
+#ifndef HUMAN_INDEX_HH
+#define HUMAN_INDEX_HH
+
+#include <stdint.h>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+#include "eigen3/Eigen/Dense"
+
+#include "human.h"
+
+namespace human{
+
+// Grid hash of humans by location. Each human is filed under the square cell that
+// contains it, so a radius query only visits the cells overlapping the query circle
+// instead of the whole population. The index stores pointers and does not own them.
+class HumanIndex{
+public:
+	explicit HumanIndex(float cell_size);
+
+	// Start/stop tracking a human. Inserting a tracked human just updates it.
+	void insert(Human* person);
+	void remove(Human* person);
+	void clear();
+	// Refile a human after it moved (cheap when it stayed in the same cell)
+	void update(Human* person);
+	// Refile every tracked human
+	void updateAll();
+
+	size_t size() const;
+	bool contains(const Human* person) const;
+
+	// Call f(Human*) for every human within radius of loc
+	template <typename Function>
+	void forEachNear(const Eigen::Vector2f &loc, float radius, Function f) const{
+		const int x_min = cellCoord(loc.x() - radius);
+		const int x_max = cellCoord(loc.x() + radius);
+		const int y_min = cellCoord(loc.y() - radius);
+		const int y_max = cellCoord(loc.y() + radius);
+		const float radius_sq = radius * radius;
+		for (int xi = x_min; xi <= x_max; xi++){
+			for (int yi = y_min; yi <= y_max; yi++){
+				const auto cell = cells_.find(cellKey(xi, yi));
+				if (cell == cells_.end()) continue;
+				for (Human* person : cell->second){
+					if ((person->getLoc() - loc).squaredNorm() <= radius_sq) f(person);
+				}
+			}
+		}
+	}
+
+	// All humans within radius of loc
+	std::vector<Human*> query(const Eigen::Vector2f &loc, float radius) const;
+
+private:
+	int cellCoord(float x) const {return int(std::floor(x / cell_size_));}
+	static uint64_t cellKey(int xi, int yi) {return (uint64_t(uint32_t(xi)) << 32) | uint32_t(yi);}
+	uint64_t cellKey(const Eigen::Vector2f &loc) const {return cellKey(cellCoord(loc.x()), cellCoord(loc.y()));}
+	void removeFromCell(Human* person, uint64_t key);
+
+	const float cell_size_;
+	// Humans in each occupied cell
+	std::unordered_map<uint64_t, std::vector<Human*>> cells_;
+	// Cell each tracked human is currently filed under
+	std::unordered_map<const Human*, uint64_t> cell_of_;
+};
+
+} // end namespace human
+
+#endif
@@ -0,0 +1,51 @@
+#include "human_predictor.h"
+
+#include <algorithm>
+#include <cmath>
+
+using std::vector;
+
+namespace human{
+
+HumanPredictor::HumanPredictor(float horizon, float bucket_duration, float cell_size) :
+bucket_duration_(bucket_duration),
+num_layers_(int(std::ceil(horizon / bucket_duration)) + 1),
+humans_(num_layers_),
+layers_(num_layers_, HumanIndex(cell_size))
+{
+}
+
+void HumanPredictor::predict(const vector<Human*> &population){
+	// Build each stamp once here rather than once per layer in the copies
+	for (Human* person : population) person->prepareStamp();
+	for (int k = 1; k < num_layers_; k++){
+		const float t = k * bucket_duration_;
+		vector<Human> &predicted = humans_[k];
+		layers_[k].clear();
+
+		// Fill the vector completely before indexing it so the pointers stay valid
+		predicted.clear();
+		predicted.reserve(population.size());
+		for (const Human* person : population) predicted.push_back(person->predict(t));
+		for (Human &person : predicted) layers_[k].insert(&person);
+	}
+}
+
+void HumanPredictor::clear(){
+	for (int k = 1; k < num_layers_; k++){
+		layers_[k].clear();
+		humans_[k].clear();
+	}
+}
+
+int HumanPredictor::numLayers() const {return num_layers_;}
+float HumanPredictor::getBucketDuration() const {return bucket_duration_;}
+
+int HumanPredictor::layerAt(float t) const{
+	const int layer = int(std::round(t / bucket_duration_));
+	return std::max(0, std::min(layer, num_layers_ - 1));
+}
+
+const HumanIndex& HumanPredictor::getLayer(int layer) const {return layers_[layer];}
+
+} // end namespace human
@@ -0,0 +1,41 @@
+#ifndef HUMAN_PREDICTOR_HH
+#define HUMAN_PREDICTOR_HH
+
+#include <vector>
+
+#include "human.h"
+#include "human_index.h"
+
+namespace human{
+
+// Constant velocity prediction of a population over the planning horizon. Layer k
+// holds every human as it is expected to be k*bucket_duration seconds after predict(),
+// with its own spatial index, so social costs can be looked up at the time the robot is
+// expected to reach a place. Layer 0 is the present and is left to the caller's live index.
+class HumanPredictor{
+public:
+	HumanPredictor(float horizon, float bucket_duration, float cell_size);
+
+	// Extrapolate every human in the population over the horizon
+	void predict(const std::vector<Human*> &population);
+	void clear();
+
+	// Number of layers including the present
+	int numLayers() const;
+	float getBucketDuration() const;
+	// Layer closest to t seconds after predict(), clamped to the horizon
+	int layerAt(float t) const;
+	// Index of the predicted humans in a layer (1 <= layer < numLayers())
+	const HumanIndex& getLayer(int layer) const;
+
+private:
+	const float bucket_duration_;
+	const int num_layers_;
+	// Predicted humans and their index for each future layer (entry 0 is unused)
+	std::vector<std::vector<Human>> humans_;
+	std::vector<HumanIndex> layers_;
+};
+
+} // end namespace human
+
+#endif
@@ -0,0 +1,210 @@
+#include "human_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "shared/math/math_util.h"
+
+using Eigen::Vector2f;
+using std::vector;
+
+namespace {
+// Larger problems fall back to greedy nearest neighbor
+const size_t kMaxOptimalSize = 8;
+// Weight given to each new velocity measurement
+const float kVelocitySmoothing = 0.3;
+// Below this speed the heading of a track is left unchanged (m/s)
+const float kMinHeadingSpeed = 0.2;
+} // namespace
+
+namespace human{
+
+vector<int> solveAssignment(const vector<vector<double>> &cost){
+	const int n = cost.size();
+	const double kInf = std::numeric_limits<double>::infinity();
+	// Potentials and matching are 1-indexed; column 0 is a sentinel
+	vector<double> u(n + 1, 0), v(n + 1, 0);
+	vector<int> row_of(n + 1, 0), way(n + 1, 0);
+	for (int i = 1; i <= n; i++){
+		row_of[0] = i;
+		int j0 = 0;
+		vector<double> min_slack(n + 1, kInf);
+		vector<bool> used(n + 1, false);
+		do{
+			used[j0] = true;
+			const int i0 = row_of[j0];
+			double delta = kInf;
+			int j1 = 0;
+			for (int j = 1; j <= n; j++){
+				if (used[j]) continue;
+				const double slack = cost[i0-1][j-1] - u[i0] - v[j];
+				if (slack < min_slack[j]){
+					min_slack[j] = slack;
+					way[j] = j0;
+				}
+				if (min_slack[j] < delta){
+					delta = min_slack[j];
+					j1 = j;
+				}
+			}
+			for (int j = 0; j <= n; j++){
+				if (used[j]){
+					u[row_of[j]] += delta;
+					v[j] -= delta;
+				}else{
+					min_slack[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (row_of[j0] != 0);
+		do{
+			const int j1 = way[j0];
+			row_of[j0] = row_of[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+
+	vector<int> col_of(n, -1);
+	for (int j = 1; j <= n; j++) col_of[row_of[j]-1] = j - 1;
+	return col_of;
+}
+
+HumanTracker::HumanTracker() :
+gate_distance_(1.0),
+min_reliability_(0.5),
+max_missed_time_(1.0)
+{
+}
+
+void HumanTracker::setGateDistance(float distance)		{gate_distance_ = distance;}
+void HumanTracker::setMinReliability(float reliability)	{min_reliability_ = reliability;}
+void HumanTracker::setMaxMissedTime(float time)			{max_missed_time_ = time;}
+
+size_t HumanTracker::numTracks() const {return tracks_.size();}
+
+vector<Human*> HumanTracker::getHumans() const{
+	vector<Human*> humans;
+	humans.reserve(tracks_.size());
+	for (const Track &track : tracks_) humans.push_back(track.person.get());
+	return humans;
+}
+
+void HumanTracker::update(const vector<Detection> &detections, double time, TrackChanges *changes){
+	changes->clear();
+	retired_.clear();
+
+	vector<int> assignment;
+	associate(detections, time, &assignment);
+
+	vector<bool> detection_used(detections.size(), false);
+	for (size_t i = 0; i < tracks_.size(); i++){
+		if (assignment[i] < 0) continue;
+		updateTrack(tracks_[i], detections[assignment[i]], time);
+		detection_used[assignment[i]] = true;
+		changes->updated.push_back(tracks_[i].person.get());
+	}
+
+	// Drop tracks that have gone unseen for too long
+	size_t kept = 0;
+	for (size_t i = 0; i < tracks_.size(); i++){
+		if (time - tracks_[i].last_seen > max_missed_time_){
+			changes->removed.push_back(tracks_[i].person.get());
+			retired_.push_back(std::move(tracks_[i].person));
+		}else{
+			if (kept != i) tracks_[kept] = std::move(tracks_[i]);
+			kept++;
+		}
+	}
+	tracks_.resize(kept);
+
+	// Start tracks for reliable detections that matched nothing
+	for (size_t j = 0; j < detections.size(); j++){
+		if (detection_used[j] or detections[j].reliability < min_reliability_) continue;
+		Track track;
+		track.person.reset(new Human());
+		track.person->setLoc(detections[j].loc);
+		track.last_seen = time;
+		changes->added.push_back(track.person.get());
+		tracks_.push_back(std::move(track));
+	}
+}
+
+void HumanTracker::associate(const vector<Detection> &detections, double time, vector<int> *assignment) const{
+	assignment->assign(tracks_.size(), -1);
+	if (tracks_.empty() or detections.empty()) return;
+
+	// Gated distances from each track's predicted location to each detection
+	vector<vector<float>> distance(tracks_.size(), vector<float>(detections.size()));
+	for (size_t i = 0; i < tracks_.size(); i++){
+		const Human &person = *tracks_[i].person;
+		const Vector2f predicted = person.getLoc() + person.getVel() * float(time - tracks_[i].last_seen);
+		for (size_t j = 0; j < detections.size(); j++){
+			distance[i][j] = (detections[j].loc - predicted).norm();
+		}
+	}
+
+	const size_t n = std::max(tracks_.size(), detections.size());
+	if (n <= kMaxOptimalSize){
+		// Pad to square. Gated and padding pairs cost more than all real matches together, so
+		// the assignment makes as many matches as possible, then minimizes their distance.
+		const double unmatched_cost = double(gate_distance_) * n + 1;
+		vector<vector<double>> cost(n, vector<double>(n, unmatched_cost));
+		for (size_t i = 0; i < tracks_.size(); i++){
+			for (size_t j = 0; j < detections.size(); j++){
+				if (distance[i][j] <= gate_distance_) cost[i][j] = distance[i][j];
+			}
+		}
+		const vector<int> col_of = solveAssignment(cost);
+		for (size_t i = 0; i < tracks_.size(); i++){
+			const int j = col_of[i];
+			if (j < int(detections.size()) and distance[i][j] <= gate_distance_) (*assignment)[i] = j;
+		}
+		return;
+	}
+
+	// Greedy: repeatedly take the closest remaining gated pair
+	vector<std::pair<float, std::pair<int, int>>> pairs;
+	for (size_t i = 0; i < tracks_.size(); i++){
+		for (size_t j = 0; j < detections.size(); j++){
+			if (distance[i][j] <= gate_distance_) pairs.push_back({distance[i][j], {int(i), int(j)}});
+		}
+	}
+	std::sort(pairs.begin(), pairs.end());
+	vector<bool> detection_used(detections.size(), false);
+	for (const auto &pair : pairs){
+		const int i = pair.second.first;
+		const int j = pair.second.second;
+		if ((*assignment)[i] >= 0 or detection_used[j]) continue;
+		(*assignment)[i] = j;
+		detection_used[j] = true;
+	}
+}
+
+void HumanTracker::updateTrack(Track &track, const Detection &detection, double time){
+	Human &person = *track.person;
+	const float dt = time - track.last_seen;
+	track.last_seen = time;
+	if (dt <= 0){
+		person.setLoc(detection.loc);
+		return;
+	}
+
+	const Vector2f measured_vel = (detection.loc - person.getLoc()) / dt;
+	const Vector2f vel = person.getVel() + kVelocitySmoothing * (measured_vel - person.getVel());
+	person.setLoc(detection.loc);
+	person.setVel(vel);
+
+	// People face the way they walk; keep the last heading while they stand still
+	if (vel.norm() > kMinHeadingSpeed){
+		const float heading = atan2(vel.y(), vel.x());
+		const float measured_omega = math_util::AngleDiff(heading, person.getAngle()) / dt;
+		person.setAngularVel(person.getAngularVel() + kVelocitySmoothing * (measured_omega - person.getAngularVel()));
+		person.setAngle(heading);
+	}else{
+		person.setAngularVel(0);
+	}
+}
+
+} // end namespace human
@@ -0,0 +1,73 @@
+#ifndef HUMAN_TRACKER_HH
+#define HUMAN_TRACKER_HH
+
+#include <memory>
+#include <vector>
+#include "eigen3/Eigen/Dense"
+
+#include "human.h"
+
+namespace human{
+
+// A person reported by the leg detector, in the map frame
+struct Detection{
+	Eigen::Vector2f loc;
+	float reliability;
+};
+
+// Humans whose tracks changed during one update, so the planner can be updated incrementally
+struct TrackChanges{
+	std::vector<Human*> added;
+	std::vector<Human*> updated;
+	std::vector<Human*> removed;	// Stay allocated until the next update
+	void clear() {added.clear(); updated.clear(); removed.clear();}
+};
+
+// Minimum cost assignment of rows to columns for a square cost matrix (Hungarian algorithm,
+// O(n^3)). Returns the column assigned to each row. Costs are doubles, since the potentials
+// accumulate sums of costs that differ by much less than the unmatched cost.
+std::vector<int> solveAssignment(const std::vector<std::vector<double>> &cost);
+
+// Tracks people from batches of detections. Each batch is associated to the existing tracks
+// by gated distance from their constant velocity prediction, using an optimal assignment when
+// the sets are small and greedy nearest neighbor otherwise. Matched tracks update their
+// location, velocity and heading; unmatched reliable detections start new tracks; tracks
+// that go unseen for too long are dropped. The tracker owns the Human of every track.
+class HumanTracker{
+public:
+	HumanTracker();
+
+	// Associate a batch of detections made at time and report which tracks changed
+	void update(const std::vector<Detection> &detections, double time, TrackChanges *changes);
+
+	// Humans of all current tracks
+	std::vector<Human*> getHumans() const;
+	size_t numTracks() const;
+
+	// Tracker Parameters
+	void setGateDistance(float distance);		// Largest distance a track can be matched over (m)
+	void setMinReliability(float reliability);	// Detections less reliable than this don't start tracks
+	void setMaxMissedTime(float time);			// Tracks unseen for longer than this are dropped (s)
+
+private:
+	struct Track{
+		std::unique_ptr<Human> person;
+		double last_seen;
+	};
+
+	// Fill assignment[i] with the detection matched to track i, or -1
+	void associate(const std::vector<Detection> &detections, double time, std::vector<int> *assignment) const;
+	void updateTrack(Track &track, const Detection &detection, double time);
+
+	std::vector<Track> tracks_;
+	// Humans removed in the last update, kept alive until the caller has forgotten them
+	std::vector<std::unique_ptr<Human>> retired_;
+
+	float gate_distance_;
+	float min_reliability_;
+	float max_missed_time_;
+};
+
+} // end namespace human
+
+#endif
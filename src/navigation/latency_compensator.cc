@@ -1,89 +1,115 @@
 #include "latency_compensator.h"
 
-  /////////////////////////
- // Latency Compensator //
-/////////////////////////
-LatencyCompensator::LatencyCompensator(float actuation_delay, float observation_delay, float dt)
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Advance a state along a constant curvature arc for dt seconds
+void integrateArc(double curvature, double velocity, double dt, state2D &state)
 {
-	actuation_delay_   	= actuation_delay;
-	observation_delay_ 	= observation_delay;
-	delta_t_ 			= dt;
+	const double distance = velocity * dt;
+	const double dtheta = curvature * distance;
+	const double theta = state.theta;
 
-	last_observation_time_ = -1.0;
+	// Treat nearly straight arcs as lines to avoid dividing by a tiny curvature
+	if (std::abs(dtheta) < 1e-6) {
+		state.x += distance * cos(theta);
+		state.y += distance * sin(theta);
+	} else {
+		state.x += (sin(theta + dtheta) - sin(theta)) / curvature;
+		state.y += (cos(theta) - cos(theta + dtheta)) / curvature;
+	}
+	state.theta = theta + dtheta;
 }
+} // namespace
+
+  /////////////////////////
+ // Latency Compensator //
+/////////////////////////
+LatencyCompensator::LatencyCompensator(float actuation_delay, float observation_delay, Clock clock) :
+	actuation_delay_(actuation_delay),
+	observation_delay_(observation_delay),
+	last_observation_time_(-1.0),
+	clock_(clock),
+	state_({0, 0, 0, 0, 0, 0})
+{}
 
 // Actuation Delay Setter and Getter
-double LatencyCompensator::getActuationDelay() {return actuation_delay_;}
-void  LatencyCompensator::setActuationDelay(float delay) {actuation_delay_ = delay;} 
+double LatencyCompensator::getActuationDelay() const {return actuation_delay_;}
+void  LatencyCompensator::setActuationDelay(float delay) {actuation_delay_ = delay;}
 
 // Observation Delay Setter and Getter
-double LatencyCompensator::getObservationDelay() {return observation_delay_;}
+double LatencyCompensator::getObservationDelay() const {return observation_delay_;}
 void  LatencyCompensator::setObservationDelay(float delay) {observation_delay_ = delay;}
 
 // System Delay Getter
-double LatencyCompensator::getSystemDelay() {return actuation_delay_ + observation_delay_;}
+double LatencyCompensator::getSystemDelay() const {return actuation_delay_ + observation_delay_;}
 
 // Note when an observation is taken
-void LatencyCompensator::recordObservation(float x, float y, float theta){
+void LatencyCompensator::recordObservation(float x, float y, float theta, double arrival_time){
 	state_.x = x;
 	state_.y = y;
 	state_.theta = theta;
-	last_observation_time_ = ros::Time::now().toSec() - observation_delay_;
+	last_observation_time_ = arrival_time - observation_delay_;
+	pruneInputs();
 }
 
 // Note and record when a command was inputted
-void LatencyCompensator::recordNewInput(float x_dot, float y_dot, float omega) {
-	recordedInputs_.push_back(std::array<double,4>({double(x_dot), double(y_dot), double(omega), ros::Time::now().toSec()}));
-	state_.vx = x_dot;
-	state_.vy = y_dot;
-	state_.omega = omega;
+void LatencyCompensator::recordNewInput(float curvature, float velocity) {
+	recordedInputs_.PushBack(StampedInput {curvature, velocity, clock_()});
+	state_.vx = velocity * cos(state_.theta);
+	state_.vy = velocity * sin(state_.theta);
+	state_.omega = velocity * curvature;
 }
 
-state2D LatencyCompensator::predictedState()
+size_t LatencyCompensator::numInputs() const {return recordedInputs_.Size();}
+
+// Keep the input that was executing when the last observation was made, and everything after it
+void LatencyCompensator::pruneInputs()
+{
+	size_t stale_inputs = 0;
+	while (stale_inputs + 1 < recordedInputs_.Size() and
+	       recordedInputs_[stale_inputs + 1].timestamp + actuation_delay_ <= last_observation_time_)
+	{
+		stale_inputs++;
+	}
+	recordedInputs_.PopFront(stale_inputs);
+}
+
+state2D LatencyCompensator::predictedState() const
 {
 	// Do nothing if no observations have been made or if delays are exactly 0
-	if (last_observation_time_ < 0 or (actuation_delay_ == 0 && observation_delay_ == 0)) return state_; 
+	if (last_observation_time_ < 0 or (actuation_delay_ == 0 && observation_delay_ == 0)) return state_;
 
 	// Initialize the output
 	state2D predicted_state = state_;
+	const double now = clock_();
 
-	// Determine how long ago inputs went stale (i.e. they occured before the latest observation)
-	double cutoff_time = last_observation_time_ - actuation_delay_;
-	double input_cutoff_time = ros::Time::now().toSec() - actuation_delay_;
+	// Each input acts on the car from (timestamp + actuation delay) until the next input takes over.
+	// Integrate the portion of each of those intervals that lies between the observation and now.
+	const StampedInput *active_input = nullptr;
+	for (size_t i = 0; i < recordedInputs_.Size(); i++)
+	{
+		const StampedInput &input = recordedInputs_[i];
+		const double input_start = input.timestamp + actuation_delay_;
+		if (input_start > now) break;
+		active_input = &input;
+
+		double input_end = now;
+		if (i + 1 < recordedInputs_.Size())
+			input_end = std::min(now, recordedInputs_[i + 1].timestamp + actuation_delay_);
 
-	// Will become true when we find the input that is currently being executed on the car
-	bool found_input = false;
+		const double dt = input_end - std::max(input_start, last_observation_time_);
+		if (dt > 0) integrateArc(input.curvature, input.velocity, dt, predicted_state);
+	}
 
-	// Iterate through inputs and forward predict the current state
-	for (auto input_stamped = recordedInputs_.begin(); input_stamped != recordedInputs_.end();)
+	// The velocity is that of the command currently being executed on the car
+	if (active_input != nullptr)
 	{
-		// Erase any input that's too old to be important (this assumes that the list is sorted chronologically)
-		if (input_stamped->at(3) <= cutoff_time) 
-		{
-			input_stamped = recordedInputs_.erase(input_stamped); 
-			continue;
-		}
-
-		// Find the input currently being executed
-		if (not found_input and (input_stamped->at(3) >= input_cutoff_time) )
-		{
-			predicted_state.vx = input_stamped->at(0);
-			predicted_state.vy = input_stamped->at(1);
-			predicted_state.omega = input_stamped->at(2);
-
-			found_input = true;
-		}
-		
-		// Use recent inputs to forward predict state of the robot
-		else
-		{			
-			// Predict State
-			predicted_state.x 	  += input_stamped->at(0) * delta_t_;
-			predicted_state.y 	  += input_stamped->at(1) * delta_t_;
-			predicted_state.theta += input_stamped->at(2) * delta_t_;
-			input_stamped++;
-		}
+		predicted_state.vx = active_input->velocity * cos(predicted_state.theta);
+		predicted_state.vy = active_input->velocity * sin(predicted_state.theta);
+		predicted_state.omega = active_input->velocity * active_input->curvature;
 	}
 
 	return predicted_state;
-}
\ No newline at end of file
+}
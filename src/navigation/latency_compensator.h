@@ -1,37 +1,55 @@
 #ifndef LATENCY_COMPENSATOR_HH
 #define LATENCY_COMPENSATOR_HH
 
-#include <list>
-#include "ros/ros.h"
-#include "eigen3/Eigen/Dense"
-#include "geometry_msgs/Pose2D.h"
+#include <functional>
+#include "shared/util/ring_buffer.h"
 
 struct state2D{
   float x, y, theta;
   float vx, vy, omega;
 };
 
+// A drive command as it was sent to the car
+struct StampedInput{
+  double curvature;
+  double velocity;
+  double timestamp;   // Time at which the command was sent (seconds)
+};
+
 class LatencyCompensator {
 public:
-  LatencyCompensator(float actuation_delay, float observation_delay, float delta_t);
+  // Source of the current time in seconds. Injected so the compensator can be run
+  // against recorded or simulated time without ROS.
+  typedef std::function<double()> Clock;
+
+  LatencyCompensator(float actuation_delay, float observation_delay, Clock clock);
 
   // Setters and Getters
-  double getActuationDelay();
+  double getActuationDelay() const;
   void  setActuationDelay(float delay);
-  double getObservationDelay();
+  double getObservationDelay() const;
   void  setObservationDelay(float delay);
-  double getSystemDelay();
+  double getSystemDelay() const;
 
-  void recordNewInput(float x_dot, float y_dot, float omega);
-  void recordObservation(float x, float y, float theta);
-  state2D predictedState();
+  void recordNewInput(float curvature, float velocity);
+  // Note an observation received at arrival_time, on the same clock as the inputs
+  void recordObservation(float x, float y, float theta, double arrival_time);
+  state2D predictedState() const;
+  // Number of commands kept, i.e. that may still act on the car
+  size_t numInputs() const;
+
+  // Maximum number of commands kept in flight (3.2s of history at 20Hz)
+  static constexpr size_t kMaxInputs = 64;
 
 private:
-  std::list< std::array<double,4> > recordedInputs_; // Record of past inputs in the form (curvature, speed, timestamp)
+  // Drop inputs that stopped acting on the car before the last observation
+  void pruneInputs();
+
+  util::RingBuffer<StampedInput, kMaxInputs> recordedInputs_; // Commands that may still affect the car, oldest first
   double actuation_delay_;                           // Robot actuation delay (seconds)
   double observation_delay_;                         // Sensor observation delay (seconds)
-  double last_observation_time_;                     // Timestamp for when the last sensor state came in 
-  double delta_t_;                                   // Duration of a control loop for the system being compensated
+  double last_observation_time_;                     // Timestamp of when the last observed state was true
+  Clock clock_;                                      // Time source shared by inputs and observations
 
   state2D state_;                     // Last recorded state of the robot
 };
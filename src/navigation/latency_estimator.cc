@@ -0,0 +1,175 @@
+#include "latency_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Minimum variance of each signal over the window before the correlation is trusted
+const double kMinVariance = 1e-3;
+// Minimum correlation at the best lag before the estimate is updated
+const double kMinCorrelation = 0.6;
+// Weight given to each new delay measurement in the exponential moving averages
+const double kSmoothing = 0.05;
+// Observation delays larger than this indicate bad stamps and are ignored (seconds)
+const double kMaxObservationDelay = 1.0;
+// Number of samples between full recomputations of the running sums
+const unsigned long kRecomputeInterval = 4096;
+} // namespace
+
+  ////////////////////////
+ // Latency Estimator  //
+////////////////////////
+LatencyEstimator::LatencyEstimator(double sample_period) :
+	sample_period_(sample_period),
+	next_sample_time_(-1.0),
+	held_command_(0),
+	held_odom_(0),
+	samples_since_recompute_(0),
+	sum_o_(0),
+	sum_oo_(0),
+	system_delay_(kSmoothing),
+	observation_delay_(kSmoothing),
+	correlation_(0)
+{
+	sum_c_.fill(0);
+	sum_cc_.fill(0);
+	sum_co_.fill(0);
+}
+
+bool LatencyEstimator::hasEstimate() const {return system_delay_.Initialized();}
+double LatencyEstimator::getSystemDelay() const {return system_delay_.Mean();}
+double LatencyEstimator::getObservationDelay() const {return observation_delay_.Mean();}
+double LatencyEstimator::getObservationJitter() const {return observation_delay_.StdDev();}
+double LatencyEstimator::getActuationDelay() const {return std::max(0.0, getSystemDelay() - getObservationDelay());}
+double LatencyEstimator::getCorrelation() const {return correlation_;}
+
+void LatencyEstimator::recordCommand(double velocity, double time)
+{
+	advanceTo(time);
+	held_command_ = velocity;
+}
+
+void LatencyEstimator::recordOdometry(double velocity, double stamp, double arrival_time)
+{
+	advanceTo(arrival_time);
+	held_odom_ = velocity;
+
+	// Observation delay is measured directly from the message stamps
+	const double observation_delay = arrival_time - stamp;
+	if (observation_delay >= 0 and observation_delay < kMaxObservationDelay)
+		observation_delay_.Add(observation_delay);
+}
+
+void LatencyEstimator::advanceTo(double time)
+{
+	if (next_sample_time_ < 0) next_sample_time_ = time;
+
+	// Restart the grid after a long gap rather than filling it with stale values
+	if (time - next_sample_time_ > kWindow * sample_period_) next_sample_time_ = time;
+
+	while (next_sample_time_ <= time)
+	{
+		addSample(held_command_, held_odom_);
+		next_sample_time_ += sample_period_;
+	}
+}
+
+void LatencyEstimator::addSample(double command, double odom)
+{
+	commands_.PushBack(command);
+
+	// Wait until every lag has a command sample to pair with
+	if (commands_.Size() < size_t(kMaxLag + 1)) return;
+
+	odom_.PushBack(odom);
+	const size_t newest = commands_.Size() - 1;
+	for (int k = 0; k <= kMaxLag; k++)
+	{
+		const double c = commands_[newest - k];
+		sum_c_[k]  += c;
+		sum_cc_[k] += c * c;
+		sum_co_[k] += c * odom;
+	}
+	sum_o_  += odom;
+	sum_oo_ += odom * odom;
+
+	// Remove the sample that just left the window
+	if (odom_.Size() > size_t(kWindow))
+	{
+		const double old_odom = odom_.Front();
+		for (int k = 0; k <= kMaxLag; k++)
+		{
+			const double c = commands_[newest - kWindow - k];
+			sum_c_[k]  -= c;
+			sum_cc_[k] -= c * c;
+			sum_co_[k] -= c * old_odom;
+		}
+		sum_o_  -= old_odom;
+		sum_oo_ -= old_odom * old_odom;
+		odom_.PopFront();
+	}
+
+	if (++samples_since_recompute_ >= kRecomputeInterval) recomputeSums();
+
+	if (odom_.Size() == size_t(kWindow)) updateEstimate();
+}
+
+void LatencyEstimator::recomputeSums()
+{
+	sum_c_.fill(0);
+	sum_cc_.fill(0);
+	sum_co_.fill(0);
+	sum_o_ = 0;
+	sum_oo_ = 0;
+
+	// odom_[i] lines up with commands_[i + offset] at lag 0
+	const size_t offset = commands_.Size() - odom_.Size();
+	for (size_t i = 0; i < odom_.Size(); i++)
+	{
+		const double o = odom_[i];
+		for (int k = 0; k <= kMaxLag; k++)
+		{
+			const double c = commands_[i + offset - k];
+			sum_c_[k]  += c;
+			sum_cc_[k] += c * c;
+			sum_co_[k] += c * o;
+		}
+		sum_o_  += o;
+		sum_oo_ += o * o;
+	}
+	samples_since_recompute_ = 0;
+}
+
+void LatencyEstimator::updateEstimate()
+{
+	const double n = kWindow;
+	const double var_o = sum_oo_ - sum_o_ * sum_o_ / n;
+	if (var_o < kMinVariance * n) return;
+
+	// Normalized cross-correlation at every lag
+	std::array<double, kMaxLag + 1> correlation;
+	int best_lag = -1;
+	for (int k = 0; k <= kMaxLag; k++)
+	{
+		const double var_c = sum_cc_[k] - sum_c_[k] * sum_c_[k] / n;
+		const double cov = sum_co_[k] - sum_c_[k] * sum_o_ / n;
+		correlation[k] = (var_c < kMinVariance * n) ? 0.0 : cov / sqrt(var_c * var_o);
+		if (best_lag < 0 or correlation[k] > correlation[best_lag]) best_lag = k;
+	}
+	if (correlation[best_lag] < kMinCorrelation) return;
+
+	// Refine the peak to sub-sample accuracy with a parabola through its neighbors
+	double lag = best_lag;
+	if (best_lag > 0 and best_lag < kMaxLag)
+	{
+		const double left = correlation[best_lag - 1];
+		const double center = correlation[best_lag];
+		const double right = correlation[best_lag + 1];
+		const double curvature = left - 2 * center + right;
+		if (curvature < 0) lag += 0.5 * (left - right) / curvature;
+	}
+
+	const double delay = lag * sample_period_;
+	system_delay_.Add(delay);
+	correlation_ = correlation[best_lag];
+}
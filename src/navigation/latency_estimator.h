@@ -0,0 +1,71 @@
+#ifndef LATENCY_ESTIMATOR_HH
+#define LATENCY_ESTIMATOR_HH
+
+#include <array>
+#include "shared/math/statistics.h"
+#include "shared/util/ring_buffer.h"
+
+// Estimates the system latency online by cross-correlating the commanded velocity
+// with the velocity reported by odometry over a sliding window. Both signals are
+// held and resampled onto a fixed time grid, and the correlation at every candidate
+// lag is maintained incrementally as samples enter and leave the window.
+class LatencyEstimator {
+public:
+  explicit LatencyEstimator(double sample_period);
+
+  // Record a velocity command at the time it was sent
+  void recordCommand(double velocity, double time);
+  // Record an odometry velocity with its sensor stamp and the time it was received
+  void recordOdometry(double velocity, double stamp, double arrival_time);
+
+  // Whether enough excitation has been seen to produce a delay estimate
+  bool hasEstimate() const;
+  // Delay between sending a command and seeing its effect in odometry (seconds)
+  double getSystemDelay() const;
+  // Delay between an odometry measurement and its arrival (seconds)
+  double getObservationDelay() const;
+  // Standard deviation of the observation delay (seconds)
+  double getObservationJitter() const;
+  // Delay between sending a command and the car executing it (seconds)
+  double getActuationDelay() const;
+  // Normalized cross-correlation at the selected lag, in [-1, 1]
+  double getCorrelation() const;
+
+  static constexpr int kWindow = 256;   // Samples in the correlation window
+  static constexpr int kMaxLag = 32;    // Largest lag tested, in samples
+
+private:
+  // Emit grid samples up to the given time using the currently held values
+  void advanceTo(double time);
+  // Push one resampled (command, odometry) pair into the window
+  void addSample(double command, double odom);
+  // Rebuild the running sums from the histories to shed accumulated rounding error
+  void recomputeSums();
+  // Pick the lag with the highest correlation and fold it into the estimate
+  void updateEstimate();
+
+  const double sample_period_;
+  double next_sample_time_;
+  double held_command_;
+  double held_odom_;
+
+  // Histories of resampled signals, oldest first. Commands run kMaxLag samples ahead of odometry.
+  util::RingBuffer<double, kWindow + kMaxLag + 1> commands_;
+  util::RingBuffer<double, kWindow + 1> odom_;
+  unsigned long samples_since_recompute_;
+
+  // Running sums over the window for each lag k of: c[t-k], c[t-k]^2, c[t-k]*o[t]
+  std::array<double, kMaxLag + 1> sum_c_;
+  std::array<double, kMaxLag + 1> sum_cc_;
+  std::array<double, kMaxLag + 1> sum_co_;
+  // Running sums over the window of: o[t], o[t]^2
+  double sum_o_;
+  double sum_oo_;
+
+  // Outputs, smoothed with exponential moving averages
+  statistics::ExponentialStats<double> system_delay_;
+  statistics::ExponentialStats<double> observation_delay_;
+  double correlation_;
+};
+
+#endif
@@ -1,6 +1,11 @@
 #include "local_planner.h"
 
+#include "shared/math/geometry.h"
 #include "shared/math/math_util.h"
+#include "shared/util/arena.h"
+#include "shared/util/thread_pool.h"
+#include "shared/util/timer.h"
+#include "shared/util/trace.h"
 
 using std::vector;
 using std::list;
@@ -13,30 +18,6 @@ using namespace math_util;
 
 //====================== HELPER FUNCTIONS ============================//
 
-bool isBetween(const Vector2f p0, const Vector2f p1, const Vector2f p2, const Vector2f p)
-{
-	/* Determine if p is inside the cone defined by p0, p1, and p2 
-	    p2
-	   /
-	  /
-	p0
-	  \      p
-	   \
-	    p1
-	*/
-
-	float angle_p1 = atan2(p1[1] - p0[1], p1[0] - p0[0]);
-	float angle_p2 = atan2(p2[1] - p0[1], p2[0] - p0[0]);
-	float angle_p  = atan2( p[1] - p0[1],  p[0] - p0[0]);
-
-	if (angle_p1 > 0 and angle_p2 < 0){
-		return (angle_p > angle_p1 or angle_p < angle_p2);
-	}
-	else{
-		return (angle_p > angle_p1 and angle_p < angle_p2);
-	}
-}
-
 float getAngleBetween(const Vector2f point_A, const Vector2f point_B, const Vector2f point_C){
 	/* returns absolute value of angle between AC and BC
 	        C
@@ -75,9 +56,7 @@ LocalPlanner::LocalPlanner() :
 	curvature_max_(1/1.0),	// can take turns as tight as 1m
 	clearance_limit_(1.0)
 {
-	pmin_ = Vector2f(0, car_width_/2+padding_);
 	pdif_ = Vector2f((wheelbase_+car_length_)/2 + padding_,  car_width_/2+padding_);
-	pmax_ = Vector2f((wheelbase_+car_length_)/2 + padding_, -car_width_/2-padding_);
 	// Set some default values for anything with a non-zero default
 }
 
@@ -128,58 +107,23 @@ void LocalPlanner::trimPathLength(PathOption &path, Vector2f goal)
 }
 
 // Calculate free path length for a given path
-void LocalPlanner::predictCollisions(PathOption& path, const Vector2f goal_loc, const list<Obstacle> &obstacle_list){
+void LocalPlanner::predictCollisions(PathOption& path, const ObstacleArray &obstacles){
 	float radius = 1/path.curvature; // can be negative
 
-	Vector2f turning_center(0,radius); // point of rotation
-	
-	// Get radii to specific points based on curvature
-	float rmin = (Sign(radius)*turning_center - pmin_).norm();	// radius from center of rotation to innermost point on the rear axle
-	float rdif = (Sign(radius)*turning_center - pdif_).norm();	// radius from center of rotation to the turning corner of the robot
-	float rmax = (Sign(radius)*turning_center - pmax_).norm();	// radius from center of rotation to the outermost point on the robot
-
 	// Default obstruction point is full simecircle of rotation
 	float fpl_min = abs(M_PI*radius);
 	Vector2f p_obstruction(0, 2*radius);
 
-	// Iterate through points in point cloud
-	for (const auto &obs : obstacle_list)
-	{
-		Vector2f obs_loc = obs.loc; 				// put obstacle location in base_link frame
-		float obs_radius = (turning_center - obs_loc).norm();	// distance to obstacle from turning center
-
-		// Ignore point if it's further away than the most direct path to current goal (approximately)
-		if (obs_loc.norm() > goal_loc[0] + car_length_) continue;
-
-		// Check if point will obstruct car
-		if (obs_radius > rmin && obs_radius < rmax) {
-			Vector2f p_current;
-			
-			// Inner side collision
-			if (obs_radius < rdif) {
-				float phi = acos(( Sign(radius)*radius-car_width_/2-padding_)/obs_radius );
-				float x = obs_radius*sin(phi);
-				p_current = {x, Sign(radius)*(car_width_/2+padding_)};
-			
-			// Front collision
-			}else if (obs_radius > rdif) {
-				float phi = asin(((wheelbase_+car_length_)/2+padding_)/obs_radius);
-				float y = radius - Sign(radius)*obs_radius*cos(phi);
-				p_current = {(wheelbase_+car_length_)/2+padding_, y};
-			}
-			
-			// Use law of cosines to compute free path length
-			float side_length = (obs_loc-p_current).norm();
-			float theta = acos((side_length*side_length-2*obs_radius*obs_radius)/(-2*obs_radius*obs_radius));
-			
-			// Solve for free path length of the current point
-			float fpl_current = Sign(radius)*theta*radius;
-
-			// If this is the first loop or this is the smallest fpl so far, record this value
-			if (fpl_current < fpl_min){
-				fpl_min = fpl_current;
-				p_obstruction = obs_loc;
-			}
+	// Free path length to every point in the point cloud, infinite if the car misses it
+	util::Arena::Scope scope(&util::ThreadArena());
+	util::ArenaVector<float> fpl(util::ArenaAllocator<float>(scope.arena()));
+	geometry::FreePathLengthsArc(obstacles, path.curvature, pdif_.y(), pdif_.x(), &fpl);
+
+	// Record the point with the smallest fpl
+	for (size_t i = 0; i < fpl.size(); i++){
+		if (fpl[i] < fpl_min){
+			fpl_min = fpl[i];
+			p_obstruction = obstacles[i];
 		}
 	}
 
@@ -189,7 +133,7 @@ void LocalPlanner::predictCollisions(PathOption& path, const Vector2f goal_loc,
 }
 
 // New base_link frame clearance calc
-void LocalPlanner::calculateClearance(PathOption &path, const list<Obstacle> &obstacle_list){
+void LocalPlanner::calculateClearance(PathOption &path, const ObstacleArray &obstacles){
 	// Warning: These can be negative
 	float radius = 1/path.curvature;
 	float theta = path.free_path_length/radius;
@@ -204,28 +148,25 @@ void LocalPlanner::calculateClearance(PathOption &path, const list<Obstacle> &ob
 	end_point.x() = radius*sin(theta) + look_ahead_dist*cos(theta);
 	end_point.y() = radius*(1-cos(theta)) + look_ahead_dist*sin(theta);
 
-	// Flip points for isBetween turning direction dependency
+	// Flip points so the sector always goes counterclockwise from point_1 to point_2
 	Vector2f point_1 = (radius > 0 ? start_point : end_point);
 	Vector2f point_2 = (radius > 0 ? end_point : start_point);
 
 	// Initialize clearance at its maximum allowed value
 	float min_clearance = clearance_limit_;
 
-	// Get angle between start and end
+	// Clearance of every point in the sector, infinite outside of it
+	util::Arena::Scope scope(&util::ThreadArena());
+	util::ArenaVector<float> clearances(util::ArenaAllocator<float>(scope.arena()));
+	geometry::ArcClearances(obstacles, center, abs(radius),
+	                        geometry::Angle<float>(point_1 - center),
+	                        geometry::Angle<float>(point_2 - center), 1, &clearances);
+
 	Vector2f closest_point(0,0);
-	for (const auto &obs : obstacle_list)
-	{
-		Vector2f obs_point = obs.loc;
-
-		if (isBetween(center, point_1, point_2, obs_point))
-		{
-			float radius_to_point = (center-obs_point).norm();
-			float clearance = abs(radius_to_point - abs(radius));
-			if (clearance < min_clearance)
-			{
-				min_clearance = clearance;
-				closest_point = obs_point;
-			}
+	for (size_t i = 0; i < clearances.size(); i++){
+		if (clearances[i] < min_clearance){
+			min_clearance = clearances[i];
+			closest_point = obstacles[i];
 		}
 	}
 	path.clearance = min_clearance;
@@ -241,31 +182,58 @@ void LocalPlanner::setWeights(float w_FPL, float w_C, float w_DTG)
 
 PathOption LocalPlanner::getGreedyPath(Vector2f goal_loc, const std::list<Obstacle> &obstacle_list)
 {
+	static CumulativeFunctionTimer function_timer_(__FUNCTION__);
+	CumulativeFunctionTimer::Invocation invoke(&function_timer_);
+	TRACE_FUNCTION();
+
 	int num_paths = 20;
 
 	// Clear out possible paths and reinitialize
 	createPossiblePaths(num_paths);
 
-	// Initialize output and cost
-	PathOption BestPath;
+	// Initialize output and cost. The output stays a stop if no path has a finite cost,
+	// e.g. when the goal is at the car.
+	PathOption BestPath = PathOption();
 	float min_cost = 1e10;
 
-	// Vectors to store results
-	vector<double> free_path_length_vec;
-	vector<double> clearance_padded_vec;
-	vector<double> distance_to_goal_vec;
+	// Vectors to store results, from the arena of this thread
+	util::Arena::Scope scope(&util::ThreadArena());
+	const util::ArenaAllocator<double> allocator(scope.arena());
+	util::ArenaVector<double> free_path_length_vec(allocator);
+	util::ArenaVector<double> clearance_padded_vec(allocator);
+	util::ArenaVector<double> distance_to_goal_vec(allocator);
+	free_path_length_vec.reserve(PossiblePaths_.size());
+	clearance_padded_vec.reserve(PossiblePaths_.size());
+	distance_to_goal_vec.reserve(PossiblePaths_.size());
+
+	// Copy the obstacles into arrays for the batch kernels. Collisions ignore points further
+	// away than the most direct path to the current goal (approximately).
+	const util::ArenaAllocator<float> float_allocator(scope.arena());
+	ObstacleArray obstacles(float_allocator);
+	ObstacleArray near_obstacles(float_allocator);
+	obstacles.Reserve(obstacle_list.size());
+	near_obstacles.Reserve(obstacle_list.size());
+	for (const auto &obs : obstacle_list){
+		obstacles.PushBack(obs.loc);
+		if (obs.loc.norm() <= goal_loc[0] + car_length_) near_obstacles.PushBack(obs.loc);
+	}
 
 	// Get best parameter from all possible paths for normalization
 	float max_free_path_length = 1e-5;
 	float max_clearance_padded = 1e-5;
 	float min_distance_to_goal = 1e5;
 
+	// Update FLP, Clearance, Closest Point, Obstruction, End Point of every path in parallel
+	util::ThreadPool::Shared().ParallelFor(0, PossiblePaths_.size(), 1, [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; i++){
+			predictCollisions(PossiblePaths_[i], near_obstacles);
+			trimPathLength(PossiblePaths_[i], goal_loc);
+			calculateClearance(PossiblePaths_[i], obstacles);
+		}
+	});
+
 	for (auto &path : PossiblePaths_)
 	{
-		// Update FLP, Clearance, Closest Point, Obstruction, End Point
-		predictCollisions(path, goal_loc, obstacle_list);
-		trimPathLength(path, goal_loc);
-		calculateClearance(path, obstacle_list);
 		float clearance_padded = path.clearance - (car_width_/2+padding_*2);
 		if (clearance_padded < 0) clearance_padded = 1e-5;
 
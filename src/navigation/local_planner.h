@@ -11,9 +11,14 @@
 #include "amrl_msgs/AckermannCurvatureDriveMsg.h"
 #include "geometry_msgs/Twist.h"
 #include "nav_types.h"
+#include "shared/math/geometry_batch.h"
+#include "shared/util/arena.h"
 
 namespace navigation{
 
+// Obstacle points in the base_link frame, for the batch geometry kernels
+typedef geometry::PointArray<float, util::ArenaAllocator<float>> ObstacleArray;
+
 class LocalPlanner{
 public:
 	// Constructor
@@ -36,8 +41,8 @@ private:
 
 	// Called by getGreedyPath
 	void createPossiblePaths(int num);
-	void predictCollisions(PathOption& path, const Eigen::Vector2f goal_loc, const std::list<Obstacle> &obstacle_list);
-	void calculateClearance(PathOption& path, const std::list<Obstacle> &obstacle_list);
+	void predictCollisions(PathOption& path, const ObstacleArray &obstacles);
+	void calculateClearance(PathOption& path, const ObstacleArray &obstacles);
 	void trimPathLength(PathOption &path, Eigen::Vector2f goal);
 
 
@@ -48,9 +53,7 @@ private:
 	float car_length_;
 	float padding_;	
 	float wheelbase_;	
-	Eigen::Vector2f pmin_;
-	Eigen::Vector2f pdif_;
-	Eigen::Vector2f pmax_;
+	Eigen::Vector2f pdif_;		// turning corner of the robot: front and half width
 
 	// Planner Parameters
 	float observation_delay_;
@@ -1,64 +1,130 @@
 #include "ros/ros.h"
 #include "nav_msgs/Odometry.h"
 #include "amrl_msgs/AckermannCurvatureDriveMsg.h"
+#include "gflags/gflags.h"
 
+#include <atomic>
+#include <thread>
 #include <vector>
-#include <fstream>
+#include <algorithm>
+#include <stdio.h>
+
+#include "shared/util/spsc_queue.h"
+#include "shared/util/timer.h"
+#include "latency_estimator.h"
+
+DEFINE_string(output, "calibration_readings.csv", "File to stream the latency recording to");
+DEFINE_string(analyze, "", "Estimate delays from an existing recording instead of recording");
+DEFINE_double(flush_period, 1.0, "Seconds between flushes of the recording to disk");
+
+// One line of the recording. Commands have stamp == time.
+struct Sample {
+	char source;	// 'c' for command, 'o' for odometry
+	double time;	// Time the command was sent or the odometry arrived (relative to start)
+	double stamp;	// Time the odometry was measured (relative to start)
+	double velocity;
+};
 
 namespace {
-	std::vector<double> x_dot_command_;
-	std::vector<double> x_dot_odom_;
-	std::vector<double> command_time_;
-	std::vector<double> odom_time_;
+	// Samples are produced by the ROS thread and written to disk by the writer thread
+	util::SpscQueue<Sample, 4096> samples_;
+	std::atomic<bool> recording_(true);
+	unsigned long dropped_samples_ = 0;
 	ros::Time start_time_;
+	const double kSamplePeriod = 0.02;	// Resampling period for the analysis
 }
 
-void writeData()
+void recordSample(const Sample &sample)
 {
-	std::ofstream OutFile("calibration_readings.csv");
-
-	OutFile << "Vx (Odom), Time (Odom), Vx (Command), Time (Command)\n";
+	if (not samples_.Push(sample)) dropped_samples_++;
+}
 
-	unsigned int max_size = std::max({x_dot_odom_.size(), x_dot_command_.size(), command_time_.size(), odom_time_.size()});
-	for (unsigned int i = 0; i < max_size; i++)
+// Drain the queue to disk until recording stops, flushing periodically so a crash loses little
+void writeData(FILE* out_file)
+{
+	fprintf(out_file, "source,time,stamp,velocity\n");
+	double t_last_flush = GetMonotonicTime();
+	Sample sample;
+	while (true)
 	{
-		// Record Odometry Velocity Readings
-		if (i < x_dot_odom_.size()){
-			OutFile << x_dot_odom_.at(i);
-		}else{
-			OutFile << "\t";
+		// Read the flag before draining so nothing pushed before shutdown is lost
+		const bool recording = recording_;
+		while (samples_.Pop(&sample))
+		{
+			fprintf(out_file, "%c,%.6f,%.6f,%.6f\n", sample.source, sample.time, sample.stamp, sample.velocity);
 		}
+		if (not recording) break;
 
-		if (i < odom_time_.size()){
-			OutFile << ",\t" << odom_time_.at(i);
-		}else{
-			OutFile << ",\t";
+		if (GetMonotonicTime() - t_last_flush > FLAGS_flush_period)
+		{
+			fflush(out_file);
+			t_last_flush = GetMonotonicTime();
 		}
+		Sleep(0.01);
+	}
+	fflush(out_file);
+}
 
-		if (i < x_dot_command_.size()){
-			OutFile << ",\t" << x_dot_command_.at(i);
-		}else{
-			OutFile << ",\t";
-		}
+// Replay a recording through the online estimator and report the delays it converges to
+int analyzeData(const std::string &file_name)
+{
+	FILE* in_file = fopen(file_name.c_str(), "r");
+	if (in_file == nullptr)
+	{
+		fprintf(stderr, "ERROR: Unable to open %s\n", file_name.c_str());
+		return 1;
+	}
 
-		if (i < command_time_.size()){
-			OutFile << ",\t" << command_time_.at(i);
-		}else{
-			OutFile << ",\t";
-		}
+	std::vector<Sample> samples;
+	Sample sample;
+	char header[256];
+	if (fgets(header, sizeof(header), in_file) == nullptr)
+	{
+		fprintf(stderr, "ERROR: %s is empty\n", file_name.c_str());
+		fclose(in_file);
+		return 1;
+	}
+	while (fscanf(in_file, " %c,%lf,%lf,%lf", &sample.source, &sample.time, &sample.stamp, &sample.velocity) == 4)
+	{
+		samples.push_back(sample);
+	}
+	fclose(in_file);
+
+	// Samples are written in arrival order per source; merge them by time
+	std::stable_sort(samples.begin(), samples.end(),
+	                 [](const Sample &a, const Sample &b) { return a.time < b.time; });
 
-		OutFile << "\n";
+	LatencyEstimator estimator(kSamplePeriod);
+	for (const Sample &s : samples)
+	{
+		if (s.source == 'c') estimator.recordCommand(s.velocity, s.time);
+		else if (s.source == 'o') estimator.recordOdometry(s.velocity, s.stamp, s.time);
 	}
+
+	printf("Read %lu samples from %s\n", samples.size(), file_name.c_str());
+	if (not estimator.hasEstimate())
+	{
+		printf("Not enough excitation in the recording to estimate the delays.\n");
+		return 1;
+	}
+	printf("System delay:      %.3f s\n", estimator.getSystemDelay());
+	printf("Observation delay: %.3f s\n", estimator.getObservationDelay());
+	printf("Actuation delay:   %.3f s\n", estimator.getActuationDelay());
+	printf("Correlation:       %.3f\n", estimator.getCorrelation());
+	return 0;
 }
 
 void recordOdom(const nav_msgs::OdometryConstPtr &msg)
 {
-	x_dot_odom_.push_back(msg->twist.twist.linear.x);
-	odom_time_.push_back((msg->header.stamp - start_time_).toSec());
+	const double now_sec = (ros::Time::now() - start_time_).toSec();
+	recordSample(Sample {'o', now_sec, (msg->header.stamp - start_time_).toSec(), msg->twist.twist.linear.x});
 }
 
 int main(int argc, char** argv)
 {
+	google::ParseCommandLineFlags(&argc, &argv, false);
+	if (not FLAGS_analyze.empty()) return analyzeData(FLAGS_analyze);
+
 	ros::init(argc, argv, "latency_measurement_node");
 	ros::NodeHandle nh;
 	ros::Rate r(100);
@@ -68,10 +134,13 @@ int main(int argc, char** argv)
 
 	amrl_msgs::AckermannCurvatureDriveMsg command_msg;
 
-	x_dot_odom_.reserve(1000000000);
-	x_dot_command_.reserve(1000000000);
-	command_time_.reserve(1000000000);
-	odom_time_.reserve(1000000000);
+	FILE* out_file = fopen(FLAGS_output.c_str(), "w");
+	if (out_file == nullptr)
+	{
+		fprintf(stderr, "ERROR: Unable to open %s for writing\n", FLAGS_output.c_str());
+		return 1;
+	}
+	std::thread writer(writeData, out_file);
 
 	start_time_ = ros::Time::now();
 	while (ros::ok())
@@ -79,20 +148,24 @@ int main(int argc, char** argv)
 		ros::Time now = ros::Time::now();
 		double now_sec = (now - start_time_).toSec();
 
-		command_msg.header.seq++; 
+		command_msg.header.seq++;
 		command_msg.header.stamp = now;
 
 		command_msg.velocity = 0.5*sin(now_sec); 	// 50 cm movement at 1 rad/s
 		command_pub.publish(command_msg);
 
-		command_time_.push_back(now_sec);
-		x_dot_command_.push_back(command_msg.velocity);
+		recordSample(Sample {'c', now_sec, now_sec, command_msg.velocity});
 
 		ros::spinOnce();
 		r.sleep();
 	}
 
-	writeData();
+	recording_ = false;
+	writer.join();
+	fclose(out_file);
+	if (dropped_samples_ > 0) printf("Dropped %lu samples\n", dropped_samples_);
+	printf("Recording saved to %s. Run with --analyze=%s to estimate the delays.\n",
+	       FLAGS_output.c_str(), FLAGS_output.c_str());
 
 	return 0;
-}
\ No newline at end of file
+}
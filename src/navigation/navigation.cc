@@ -31,10 +31,15 @@
 #include "shared/math/geometry.h"
 #include "shared/math/line2d.h"
 #include "shared/math/math_util.h"
+#include "shared/util/allocation_counter.h"
+#include "shared/util/arena.h"
+#include "shared/util/metrics.h"
 #include "shared/util/timer.h"
+#include "shared/util/trace.h"
 #include "shared/ros/ros_helpers.h"
 #include "navigation.h"
 #include "visualization/visualization.h"
+#include "visualization/viz_channel.h"
 
 using Eigen::Vector2f;
 using Eigen::Vector2i;
@@ -53,8 +58,13 @@ using namespace ros_helpers;
 namespace {
 ros::Publisher drive_pub_;
 ros::Publisher viz_pub_;
-VisualizationMsg local_viz_msg_;
-VisualizationMsg global_viz_msg_;
+// Visualization layers: frame, namespace, minimum redraw period (s), element budget
+visualization::VizChannel local_viz_("base_link", "navigation_local", 0.1, 2000);
+visualization::VizChannel global_viz_("map", "navigation_global", 0.1, 2000);
+visualization::VizChannel path_viz_("map", "navigation_path", 0.5, 2000);
+visualization::VizChannel invalid_viz_("map", "navigation_invalid_nodes", 1.0, 500);
+visualization::VizChannel frontier_viz_("map", "navigation_frontier", 1.0, 2000);
+visualization::VizChannel social_viz_("map", "navigation_social_costs", 2.0, 5000);
 AckermannCurvatureDriveMsg drive_msg_;
 
 // Epsilon value for handling limited numerical precision.
@@ -63,6 +73,12 @@ const float kEpsilon = 1e-5;
 // Delta t of the control loop
 float dt_ = 1/20.0;	// made not constant to adapt for variance/lag
 
+// Fraction of the cycle budget after which optional work is skipped
+const double optional_work_fraction_ = 0.5;
+
+// Resampling period of the online latency estimator
+const double latency_sample_period_ = 0.02;
+
 // // Robot Parameters
 const float observation_delay_ 	= 0.0;
 const float actuation_delay_ 	= 0.0;
@@ -80,6 +96,38 @@ Eigen::Vector2f local_goal_vector_;
 bool init_ = true;
 bool init_vel_ = true;
 ros::Time time_prev_;
+
+// Metrics
+util::metrics::Counter scans_received_("navigation_scans_received_total", "Laser scans received");
+util::metrics::Counter scans_processed_("navigation_scans_processed_total", "Laser scans added to the obstacles");
+util::metrics::Counter odometry_dropped_("navigation_odometry_dropped_total", "Odometry messages dropped on a full queue");
+util::metrics::Counter legs_dropped_("navigation_leg_detections_dropped_total", "Leg detections dropped on a full queue");
+util::metrics::Gauge obstacles_("navigation_obstacles", "Obstacle points in memory");
+util::metrics::Counter cycles_("navigation_control_cycles_total", "Control loop cycles");
+util::metrics::Counter overruns_("navigation_control_overruns_total", "Control loop cycles over budget");
+util::metrics::Gauge cycle_allocations_("navigation_cycle_allocations", "Heap allocations made by the control thread in the last cycle");
+util::metrics::Histogram loop_period_("navigation_loop_period_seconds", "Measured period of the control loop", util::metrics::LatencyBounds());
+util::metrics::Gauge loop_jitter_("navigation_loop_jitter_seconds", "Standard deviation of the control loop period");
+util::metrics::Counter shed_("navigation_shed_cycles_total", "Control loop cycles that skipped optional work");
+util::metrics::Counter plans_("navigation_plans_total", "Global plans for new goals");
+util::metrics::Counter replans_("navigation_replans_total", "Global replans");
+util::metrics::Histogram plan_time_("navigation_plan_seconds", "Time to plan or replan", util::metrics::LatencyBounds());
+util::metrics::Counter viz_published_("navigation_viz_published_total", "Visualization layers published");
+util::metrics::Gauge actuation_delay_metric_("navigation_actuation_delay_seconds", "Estimated delay from a drive command to the car moving");
+util::metrics::Gauge observation_delay_metric_("navigation_observation_delay_seconds", "Estimated delay from the car moving to odometry reporting it");
+util::metrics::Gauge observation_jitter_metric_("navigation_observation_jitter_seconds", "Standard deviation of the observation delay");
+util::metrics::Gauge latency_correlation_metric_("navigation_latency_correlation", "Correlation of commanded and observed speed at the estimated system delay");
+util::metrics::Counter viz_unchanged_("navigation_viz_unchanged_total", "Visualization layers redrawn but not published because they were unchanged");
+
+// Publish a redrawn layer, unless it is unchanged
+void publishLayer(visualization::VizChannel& channel, double now){
+	if (not channel.Finish(now)){
+		viz_unchanged_.Increment();
+		return;
+	}
+	viz_published_.Increment();
+	visualization::PublishVisualizationMsg(viz_pub_, channel.Message());
+}
 } //namespace
 
 namespace navigation {
@@ -109,7 +157,9 @@ bool isBetween(const Vector2f p0, const Vector2f p1, const Vector2f p2, const Ve
 }
 
 Navigation::Navigation(const string& map_file, ros::NodeHandle* n) :
-		LC_(actuation_delay_, observation_delay_, dt_),
+		LC_(actuation_delay_, observation_delay_, []() { return ros::Time::now().toSec(); }),
+		latency_estimator_(latency_sample_period_),
+		global_planner_([]() { return ros::Time::now().toSec(); }),
 		robot_loc_(0, 0),
 		robot_angle_(0),
 		robot_vel_(0, 0),
@@ -117,21 +167,38 @@ Navigation::Navigation(const string& map_file, ros::NodeHandle* n) :
 		nav_complete_(true),
 		nav_goal_loc_(0, 0),
 		// nav_goal_angle_(0),
-		obstacle_memory_(0)
+		obstacle_memory_(0),
+		cycle_budget_(dt_),
+		cycle_start_(0),
+		last_cycle_overrun_(false),
+		shed_cycles_(0),
+		load_shedding_(true),
+		planning_pending_(false),
+		planner_running_(false),
+		plan_requested_(false),
+		pending_new_goal_(false)
 {
 	global_planner_.setResolution(0.25);
+	global_planner_.setNominalSpeed(max_vel_);
 	setLocalPlannerWeights(1,100,1); //fpl, clearance, dtg
 
-	drive_pub_ = n->advertise<AckermannCurvatureDriveMsg>("ackermann_curvature_drive", 1);
-	viz_pub_ = n->advertise<VisualizationMsg>("visualization", 1);
-	local_viz_msg_ = visualization::NewVisualizationMessage("base_link", "navigation_local");
-	global_viz_msg_ = visualization::NewVisualizationMessage("map", "navigation_global");
+	if (n != nullptr){
+		drive_pub_ = n->advertise<AckermannCurvatureDriveMsg>("ackermann_curvature_drive", 1);
+		viz_pub_ = n->advertise<VisualizationMsg>("visualization", 1);
+	}
 	InitRosHeader("base_link", &drive_msg_.header);
 
 	// Set up the humans in the room
 	loadScenario(Scene1);
 }
 
+Navigation::~Navigation() {
+	if (planner_thread_.joinable()){
+		planner_running_ = false;
+		planner_thread_.join();
+	}
+}
+
 void Navigation::SetNavGoal(const Vector2f& loc, float angle) {
 	nav_goal_loc_ = loc;
 	nav_goal_angle_ = angle;
@@ -152,8 +219,20 @@ void Navigation::UpdateLocation(const Eigen::Vector2f& loc, float angle) {
 }
 
 void Navigation::UpdateOdometry(const Vector2f& loc, float angle,
-								const Vector2f& vel, float ang_vel) {
-	LC_.recordObservation(loc[0], loc[1], angle);
+								const Vector2f& vel, float ang_vel, double time,
+								double arrival_time) {
+	// Feed the latest delay estimates to the compensator before using them
+	latency_estimator_.recordOdometry(vel.x(), time, arrival_time);
+	if (latency_estimator_.hasEstimate()){
+		LC_.setActuationDelay(latency_estimator_.getActuationDelay());
+		LC_.setObservationDelay(latency_estimator_.getObservationDelay());
+		actuation_delay_metric_.Set(latency_estimator_.getActuationDelay());
+		observation_delay_metric_.Set(latency_estimator_.getObservationDelay());
+		observation_jitter_metric_.Set(latency_estimator_.getObservationJitter());
+		latency_correlation_metric_.Set(latency_estimator_.getCorrelation());
+	}
+
+	LC_.recordObservation(loc[0], loc[1], angle, arrival_time);
 	state2D current_state = LC_.predictedState();
 
 	odom_loc_ 	 = {current_state.x, current_state.y};
@@ -206,6 +285,8 @@ void Navigation::ObservePointCloud(const vector<Vector2f>& cloud, double time) {
 		BaseLinkObstacleList_.push_back(Obstacle {obs_loc, time});
 	}
 
+	obstacles_.Set(ObstacleList_.size());
+
 	// False Obstacles in the hallway
 	// BaseLinkObstacleList_.push_back(Obstacle{Map2BaseLink({-27.5, 13.1}), time});
 	// BaseLinkObstacleList_.push_back(Obstacle{Map2BaseLink({-27.2, 13.1}), time});
@@ -219,6 +300,22 @@ void Navigation::ObservePointCloud(const vector<Vector2f>& cloud, double time) {
 	// BaseLinkObstacleList_.push_back(Obstacle{Map2BaseLink({-25.0, 13.1}), time});
 }
 
+void Navigation::ObserveLegDetections(const vector<human::Detection>& detections, double time) {
+	// The leg detector reports in the odom frame; the planner works in the map frame
+	vector<human::Detection> map_detections;
+	map_detections.reserve(detections.size());
+	for (const auto &detection : detections){
+		const Vector2f map_loc = robot_loc_ + R_map2base_ * Odom2BaseLink(detection.loc);
+		map_detections.push_back(human::Detection {map_loc, detection.reliability});
+	}
+
+	// Apply only what changed, so the planner keeps its plan unless a change matters
+	human_tracker_.update(map_detections, time, &track_changes_);
+	for (human::Human* H : track_changes_.removed) global_planner_.removeHuman(H);
+	for (human::Human* H : track_changes_.updated) global_planner_.updateHuman(H);
+	for (human::Human* H : track_changes_.added)   global_planner_.insertHuman(H);
+}
+
 void Navigation::showObstacles()
 {
 	int i = 0;
@@ -226,7 +323,7 @@ void Navigation::showObstacles()
 	for (const auto &obs : BaseLinkObstacleList_)
 	{
 		if (i != cutoff_count) {i++; continue;} // ensure that no more than 1000 obstacles are displayed
-		visualization::DrawCross(obs.loc, 0.05, 0x000000, local_viz_msg_);
+		visualization::DrawCross(obs.loc, 0.05, 0x000000, local_viz_.Message());
 		i = 0;
 	}
 }
@@ -264,17 +361,16 @@ void Navigation::printVector(Vector2f print_vector, string vector_name){
 }
 
 void Navigation::driveCar(float curvature, float velocity){
+	TRACE_FUNCTION();
 	drive_msg_.header.seq++;
 	drive_msg_.header.stamp = ros::Time::now();
 	drive_msg_.curvature = curvature;
 	drive_msg_.velocity = velocity;
-	drive_pub_.publish(drive_msg_);
+	if (drive_pub_) drive_pub_.publish(drive_msg_);
 
-	// Record input in the latency compensator
-	geometry_msgs::Twist cartesian_velocity = AckermannIK(curvature, velocity);
-	LC_.recordNewInput(cartesian_velocity.linear.x, 
-					   cartesian_velocity.linear.y, 
-					   cartesian_velocity.angular.z);
+	// Record input in the latency compensator and estimator
+	LC_.recordNewInput(curvature, velocity);
+	latency_estimator_.recordCommand(velocity, drive_msg_.header.stamp.toSec());
 }
 
 // Ackerman Forward/Inverse Kinematics
@@ -332,6 +428,51 @@ bool Navigation::isRobotStuck(){
 	return false;
 }
 
+void Navigation::followPreviousPath(){
+	// A new goal has no path yet, and a lost robot shouldn't guess; stop and wait
+	Vector2f target;
+	if (pending_new_goal_ or not getPreviousPathTarget(&target)){
+		driveCar(drive_msg_.curvature, limitVelocity(0));
+		return;
+	}
+	local_goal_vector_ = Map2BaseLink(target);
+	PathOption BestPath = local_planner_.getGreedyPath(local_goal_vector_, BaseLinkObstacleList_);
+	moveAlongPath(BestPath);
+	checkReached();
+}
+
+bool Navigation::getPreviousPathTarget(Vector2f* target) const{
+	const float circle_rad_min = 2.0;
+	if (previous_path_.empty()) return false;
+
+	// Find the closest node to the robot
+	size_t closest_index = 0;
+	for (size_t i = 1; i < previous_path_.size(); i++){
+		if ((robot_loc_ - previous_path_[i]).norm() < (robot_loc_ - previous_path_[closest_index]).norm())
+			closest_index = i;
+	}
+	if ((robot_loc_ - previous_path_[closest_index]).norm() > circle_rad_min) return false;
+
+	// The first node after it outside the circle, or the goal
+	size_t target_index = closest_index;
+	while (target_index + 1 < previous_path_.size() and
+	       (robot_loc_ - previous_path_[target_index]).norm() <= circle_rad_min) target_index++;
+	if (target_index == closest_index){
+		*target = previous_path_[target_index];
+		return true;
+	}
+
+	// Step back to a node with a clear line from the robot. The map is never modified,
+	// so it is safe to read while the planner runs.
+	for (size_t i = target_index; i > closest_index; i--){
+		if (not global_planner_.map_->Intersects(robot_loc_, previous_path_[i])){
+			*target = previous_path_[i];
+			return true;
+		}
+	}
+	return false;
+}
+
 void Navigation::loadScenario(Scenario S){
 	cout << "Loading Scenario " << S.identifier << ": " << S.description << endl;
 	current_scenario_ = S;
@@ -340,9 +481,10 @@ void Navigation::loadScenario(Scenario S){
 		S.population[i]->setLoc(S.human_locs[i]);
 		S.population[i]->setAngle(S.human_angles[i]);
 
-		if (not S.standing[i]){
-			S.population[i]->setStanding(false);
-		}
+		S.population[i]->setStanding(S.standing[i]);
+		// Scenario motion starts from rest, even if the humans moved in an earlier run
+		S.population[i]->setVel({0,0});
+		S.population[i]->setAngularVel(0);
 
 		if (S.seen[i]){
 			global_planner_.addHuman(S.population[i]);
@@ -350,16 +492,257 @@ void Navigation::loadScenario(Scenario S){
 	}
 }
 
+const LatencyEstimator& Navigation::getLatencyEstimator() const {return latency_estimator_;}
+
+bool Navigation::SetScenario(int identifier){
+	const Scenario* scenarios[] = {&Scene1, &Scene2, &Scene3, &Scene4, &Scene5, &Scene6};
+	for (const Scenario* S : scenarios){
+		if (S->identifier != identifier) continue;
+		global_planner_.clearPopulation();
+		loadScenario(*S);
+		return true;
+	}
+	return false;
+}
+
+bool Navigation::isNavComplete() const {return nav_complete_;}
+
+void Navigation::getDriveCommand(float* curvature, float* velocity) const {
+	*curvature = drive_msg_.curvature;
+	*velocity = drive_msg_.velocity;
+}
+
+PlanStats Navigation::getPlanStats() const {return plan_stats_.Get();}
+bool Navigation::isPlanPending() const {return planning_pending_.load(std::memory_order_acquire);}
+
+// Loop Timing
+void Navigation::setLoopTiming(double period, double budget, bool overrun,
+                              double jitter) {
+	loop_period_.Observe(period);
+	loop_jitter_.Set(jitter);
+	// Clamp so that a single long stall doesn't produce a huge velocity or human step
+	dt_ = std::max(0.5*budget, std::min(2.0*budget, period));
+	cycle_budget_ = budget;
+	last_cycle_overrun_ = overrun;
+	if (overrun) overruns_.Increment();
+}
+
+uint64_t Navigation::getShedCycles() const {return shed_cycles_;}
+void Navigation::setLoadShedding(bool enabled) {load_shedding_ = enabled;}
+
+bool Navigation::overBudget() {
+	if (not load_shedding_) return false;
+	return last_cycle_overrun_ or GetMonotonicTime() - cycle_start_ > optional_work_fraction_ * cycle_budget_;
+}
+
+// Threaded Interface
+void Navigation::PostOdometry(const Vector2f& loc, float angle,
+							  const Vector2f& vel, float ang_vel, double time) {
+	const double arrival_time = ros::Time::now().toSec();
+	if (not odometry_inputs_.Push(OdometryInput {loc, angle, vel, ang_vel, time, arrival_time})){
+		odometry_dropped_.Increment();
+		ROS_WARN_THROTTLE(1.0, "Odometry queue full, dropping message");
+	}
+}
+
+void Navigation::PostLocalization(const Vector2f& loc, float angle) {
+	localization_input_.Set(LocalizationInput {loc, angle});
+}
+
+void Navigation::PostPointCloud(const vector<Vector2f>& cloud, double time) {
+	// Fill the back buffer in place so its capacity is reused between scans
+	PointCloudInput& input = cloud_input_.Back();
+	input.cloud = cloud;
+	input.time = time;
+	cloud_input_.Publish();
+	scans_received_.Increment();
+}
+
+void Navigation::PostNavGoal(const Vector2f& loc, float angle) {
+	goal_input_.Set(GoalInput {loc, angle});
+}
+
+void Navigation::PostLegDetections(const vector<human::Detection>& detections, double time) {
+	if (not leg_inputs_.Push(LegDetectionInput {detections, time})){
+		legs_dropped_.Increment();
+		ROS_WARN_THROTTLE(1.0, "Leg detection queue full, dropping message");
+	}
+}
+
+void Navigation::StartPlannerThread() {
+	if (planner_thread_.joinable()) return;
+	planner_running_ = true;
+	planner_thread_ = std::thread(&Navigation::plannerLoop, this);
+}
+
+void Navigation::processInputs() {
+	TRACE_FUNCTION();
+	OdometryInput odom;
+	while (odometry_inputs_.Pop(&odom)){
+		UpdateOdometry(odom.loc, odom.angle, odom.vel, odom.ang_vel, odom.time, odom.arrival_time);
+	}
+
+	if (localization_input_.Update()){
+		const LocalizationInput& localization = localization_input_.Front();
+		UpdateLocation(localization.loc, localization.angle);
+	}
+
+	if (cloud_input_.Update()){
+		const PointCloudInput& cloud = cloud_input_.Front();
+		ObservePointCloud(cloud.cloud, cloud.time);
+		scans_processed_.Increment();
+	}
+
+	// Tracked humans are shared with the planner, so they also wait until it is free
+	if (not planning_pending_){
+		LegDetectionInput legs;
+		while (leg_inputs_.Pop(&legs)){
+			ObserveLegDetections(legs.detections, legs.time);
+		}
+	}
+
+	// A new goal waits until the planner is free
+	if (not planning_pending_ and goal_input_.Update()){
+		const GoalInput& goal = goal_input_.Front();
+		nav_goal_loc_ = goal.loc;
+		nav_goal_angle_ = goal.angle;
+		nav_complete_ = false;
+		requestPlan(PlanRequest {true, robot_loc_, robot_loc_});
+	}
+}
+
+void Navigation::requestPlan(const PlanRequest& request) {
+	// Fresh goals take priority over replans requested in the same cycle
+	if (plan_requested_ and plan_request_.new_goal) return;
+	plan_request_ = request;
+	plan_requested_ = true;
+}
+
+void Navigation::dispatchPlan() {
+	if (not plan_requested_) return;
+	plan_requested_ = false;
+
+	if (not planner_thread_.joinable()){
+		plan(plan_request_);
+		return;
+	}
+	// Keep what the control loop needs to drive on while the plan runs
+	global_planner_.getPathLocations(&previous_path_);
+	pending_new_goal_ = plan_request_.new_goal;
+	// Ownership of the planner and humans passes to the planner thread until it clears the flag
+	planning_pending_.store(true, std::memory_order_release);
+	if (not plan_requests_.Push(plan_request_)){
+		planning_pending_.store(false, std::memory_order_release);
+	}
+}
+
+void Navigation::plan(const PlanRequest& request) {
+	TRACE_FUNCTION();
+	const double t_start = GetMonotonicTime();
+	PlanStats stats = plan_stats_.Get();
+	if (request.new_goal){
+		global_planner_.initializeMap(request.robot_loc);
+		global_planner_.getGlobalPath(nav_goal_loc_);
+		stats.plans++;
+		plans_.Increment();
+	}else{
+		global_planner_.replan(request.robot_loc, request.failed_loc);
+		stats.replans++;
+		replans_.Increment();
+	}
+	const double duration = GetMonotonicTime() - t_start;
+	stats.total_time += duration;
+	stats.max_time = std::max(stats.max_time, duration);
+	plan_stats_.Set(stats);
+	plan_time_.Observe(duration);
+}
+
+void Navigation::plannerLoop() {
+	util::trace::SetThreadName("planner");
+	PlanRequest request;
+	while (planner_running_){
+		if (plan_requests_.Pop(&request)){
+			plan(request);
+			planning_pending_.store(false, std::memory_order_release);
+		}else{
+			Sleep(0.002);
+		}
+	}
+}
+
 // Frame Transformations
 Eigen::Vector2f Navigation::BaseLink2Odom(Eigen::Vector2f p) {return odom_loc_ + R_odom2base_*p;}
 Eigen::Vector2f Navigation::Odom2BaseLink(Eigen::Vector2f p) {return R_odom2base_.transpose()*(p - odom_loc_);}
 Eigen::Vector2f Navigation::Map2BaseLink(Eigen::Vector2f p) {return R_map2base_.transpose()*(p - robot_loc_);}
 
 
+// Redraw and publish the visualization layers that are due. Planner layers are drawn
+// stalest first, and only while the cycle is within its optional work budget.
+void Navigation::publishVisualization() {
+	if (not visualization::kVisualizationEnabled) return;
+	TRACE_FUNCTION();
+	const double now = GetMonotonicTime();
+	// Drawn during the cycle only if they were due at its start
+	if (local_viz_.Due(cycle_start_)){
+		// showObstacles();
+		publishLayer(local_viz_, now);
+	}
+	if (global_viz_.Due(cycle_start_)){
+		for (human::Human* H : current_scenario_.population){
+			H->show(global_viz_.Message());
+			// H->visualizeFields(global_viz_.Message());
+		}
+		for (human::Human* H : human_tracker_.getHumans()){
+			H->show(global_viz_.Message());
+		}
+		publishLayer(global_viz_, now);
+	}
+
+	struct PlannerLayer {
+		visualization::VizChannel* channel;
+		void (GlobalPlanner::*plot)(VisualizationMsg&);
+	};
+	PlannerLayer layers[] = {
+		{&path_viz_, &GlobalPlanner::plotGlobalPath},
+		{&invalid_viz_, &GlobalPlanner::plotInvalidNodes},
+		{&frontier_viz_, &GlobalPlanner::plotFrontier},
+		{&social_viz_, &GlobalPlanner::plotSocialCosts},
+	};
+	std::sort(std::begin(layers), std::end(layers), [now](const PlannerLayer& a, const PlannerLayer& b){
+		return a.channel->Staleness(now) > b.channel->Staleness(now);
+	});
+	for (const PlannerLayer& layer : layers){
+		if (overBudget()) break;
+		if (not layer.channel->Due(now)) continue;
+		(global_planner_.*layer.plot)(layer.channel->Begin());
+		publishLayer(*layer.channel, now);
+	}
+}
+
 // Main Loop
 void Navigation::Run() {
-	visualization::ClearVisualizationMsg(local_viz_msg_);
-	visualization::ClearVisualizationMsg(global_viz_msg_);
+	TRACE_FUNCTION();
+	util::Arena::Scope scope(&util::ThreadArena());
+	const util::AllocationCounter allocations;
+	runCycle();
+	cycle_allocations_.Set(allocations.Thread());
+}
+
+void Navigation::runCycle() {
+	cycles_.Increment();
+	cycle_start_ = GetMonotonicTime();
+	processInputs();
+	dispatchPlan();
+
+	// The planner thread owns the global planner and humans until it finishes
+	if (planning_pending_.load(std::memory_order_acquire)){
+		if (not nav_complete_) followPreviousPath();
+		return;
+	}
+
+	// The local and global layers are drawn as a side effect of the control logic
+	local_viz_.Begin();
+	global_viz_.Begin();
 
 	if (current_scenario_.identifier == 5){
 		// Have Andrew move down the hallway
@@ -390,12 +773,11 @@ void Navigation::Run() {
 
 	if (nav_complete_){
 		// Do nothing if navigation is not active
-		ros::Duration(0.01).sleep();
 
 	}else{
 		// Detect any new humans if applicable
 		for (size_t i = 0; i < current_scenario_.seen.size(); i++){
-			if (not current_scenario_.seen[i] and not current_scenario_.population[i]->isHidden(robot_loc_, global_planner_.map_)){
+			if (not current_scenario_.seen[i] and not current_scenario_.population[i]->isHidden(robot_loc_, *global_planner_.map_)){
 				current_scenario_.seen[i] = true;
 				global_planner_.addHuman(current_scenario_.population[i]);
 				cout << "New human discovered!" << endl;
@@ -403,7 +785,7 @@ void Navigation::Run() {
 		}
 
 		// Extract the next node to aim for by the local planner
-		Node target_node = global_planner_.getClosestPathNode(robot_loc_, global_viz_msg_);
+		Node target_node = global_planner_.getClosestPathNode(robot_loc_, global_viz_.Message());
 		local_goal_vector_ = Map2BaseLink(target_node.loc);
 		
 
@@ -414,36 +796,32 @@ void Navigation::Run() {
 
 		checkStalled();
 		if (global_planner_.needsReplan() or isRobotStuck()){
-			global_planner_.replan(robot_loc_, target_node.loc);
+			requestPlan(PlanRequest {false, robot_loc_, target_node.loc});
 			cout << "Replan!" << endl;
 			stalled_ = false;
-			ros::Duration(0.5).sleep();
 		}
-
-		if (global_planner_.needSocialReplan(robot_loc_)){
-			global_planner_.replan(robot_loc_, robot_loc_);		// by passing in robot_loc_ as the failed location, we prevent an "impassable node" from being added
+		else if (not overBudget() and global_planner_.needSocialReplan(robot_loc_)){
+			requestPlan(PlanRequest {false, robot_loc_, robot_loc_});		// by passing in robot_loc_ as the failed location, we prevent an "impassable node" from being added
 		}
 
 		// Visualization/Diagnostics
 		// local_planner_.printPathDetails(BestPath, local_goal_vector_);
-		local_planner_.plotPathDetails(BestPath, local_goal_vector_, local_viz_msg_);
+		if (visualization::kVisualizationEnabled and local_viz_.Due(cycle_start_) and not overBudget()){
+			local_planner_.plotPathDetails(BestPath, local_goal_vector_, local_viz_.Message());
+		}
 	}
 
-	// Visualization
-	global_planner_.plotGlobalPath(global_viz_msg_);
-	global_planner_.plotFrontier(global_viz_msg_);
-	global_planner_.plotInvalidNodes(global_viz_msg_);
-	global_planner_.plotSocialCosts(global_viz_msg_);
-	
-	for (human::Human* H : current_scenario_.population){
-		H->show(global_viz_msg_);
-		// H->visualizeFields(global_viz_msg_);
+	// Visualization is optional: skip it when the control loop is short on time
+	if (overBudget()){
+		shed_cycles_++;
+		shed_.Increment();
+		dispatchPlan();
+		return;
 	}
+	publishVisualization();
 
-	// showObstacles();
-
-	viz_pub_.publish(local_viz_msg_);
-	viz_pub_.publish(global_viz_msg_);
+	// Replans start only after this cycle is done with the planner
+	dispatchPlan();
 }
 
 }  // namespace navigation
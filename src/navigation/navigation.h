@@ -19,21 +19,29 @@
 */
 //========================================================================
 
+#include <stdint.h>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <map>
+#include <thread>
 
 #include "eigen3/Eigen/Dense"
 #include "geometry_msgs/Pose2D.h"
 #include "geometry_msgs/Twist.h"
 #include "latency_compensator.h"
+#include "latency_estimator.h"
 #include "amrl_msgs/AckermannCurvatureDriveMsg.h"
 #include "vector_map/vector_map.h"
 #include "global_planner.h"
 #include "local_planner.h"
 #include "nav_types.h"  // contains obstacle and path definitions
 #include "human.h"
+#include "human_tracker.h"
 #include "scenarios.h"
+#include "shared/util/latest_value.h"
+#include "shared/util/pthread_utils.h"
+#include "shared/util/spsc_queue.h"
 
 #ifndef NAVIGATION_H
 #define NAVIGATION_H
@@ -44,27 +52,123 @@ namespace ros {
 
 namespace navigation {
 
+// Inputs handed from the ROS callback thread to the control loop
+struct OdometryInput {
+  Eigen::Vector2f loc;
+  float angle;
+  Eigen::Vector2f vel;
+  float ang_vel;
+  double time;
+  double arrival_time;  // When the callback received the message
+};
+
+struct LocalizationInput {
+  Eigen::Vector2f loc;
+  float angle;
+};
+
+struct PointCloudInput {
+  std::vector<Eigen::Vector2f> cloud;
+  double time;
+};
+
+struct GoalInput {
+  Eigen::Vector2f loc;
+  float angle;
+};
+
+struct LegDetectionInput {
+  std::vector<human::Detection> detections;  // In the odom frame
+  double time;
+};
+
+// Timing of the global plans computed so far
+struct PlanStats {
+  uint64_t plans = 0;       // Plans to a new goal
+  uint64_t replans = 0;     // Replans around failures or moved humans
+  double total_time = 0;    // Seconds spent planning
+  double max_time = 0;      // Longest single plan (seconds)
+};
+
+// Work handed from the control loop to the planner
+struct PlanRequest {
+  bool new_goal;                // Plan to nav_goal_loc_ from scratch, otherwise replan
+  Eigen::Vector2f robot_loc;
+  Eigen::Vector2f failed_loc;   // Location to avoid when replanning
+};
 
 class Navigation {
  public:
 
   /* -------- General Navigation Functions ---------- */
-   // Constructor
+   // Constructor. With a null node handle nothing is published, so navigation
+   // can run without a ROS master (e.g. in the headless simulator).
   explicit Navigation(const std::string& map_file, ros::NodeHandle* n);
+  // Destructor, stops the planner thread if it was started
+  ~Navigation();
   // Used in callback from localization to update position.
   void UpdateLocation(const Eigen::Vector2f& loc, float angle);
-  // Used in callback for odometry messages to update based on odometry.
+  // Used in callback for odometry messages to update based on odometry. time is
+  // the message stamp and arrival_time when the message was received.
   void UpdateOdometry(const Eigen::Vector2f& loc,
                       float angle,
                       const Eigen::Vector2f& vel,
-                      float ang_vel);
+                      float ang_vel,
+                      double time,
+                      double arrival_time);
   // Updates based on an observed laser scan
   void ObservePointCloud(const std::vector<Eigen::Vector2f>& cloud,
                          double time);
+  // Updates the tracked humans from a batch of leg detections in the odom frame
+  void ObserveLegDetections(const std::vector<human::Detection>& detections,
+                            double time);
   // Used to set the next target pose.
   void SetNavGoal(const Eigen::Vector2f& loc, float angle);
    // Main function called continously from main
   void Run();
+  // Report the measured timing of the control loop before each Run(). The
+  // measured period replaces the nominal dt, and optional work (visualization,
+  // social replans) is skipped after an overrun or once a cycle runs long.
+  // The period and the loop's jitter are also exported as metrics.
+  void setLoopTiming(double period, double budget, bool overrun,
+                     double jitter);
+  // Number of cycles in which optional work was skipped to meet the deadline
+  uint64_t getShedCycles() const;
+  // Whether optional work may be skipped at all (default true). Disable to make
+  // runs independent of how fast the host is, e.g. in simulation.
+  void setLoadShedding(bool enabled);
+  // Replace the humans with those of the scenario with this identifier.
+  // Returns false if there is no such scenario.
+  bool SetScenario(int identifier);
+  // Whether the robot has reached the current goal
+  bool isNavComplete() const;
+  // Most recent drive command
+  void getDriveCommand(float* curvature, float* velocity) const;
+  // Plans computed so far. Only consistent while no plan is pending on the
+  // planner thread.
+  PlanStats getPlanStats() const;
+  // Whether a plan is running on the planner thread
+  bool isPlanPending() const;
+
+  /* -------- Threaded Interface ---------- */
+  // These may be called from a single callback thread (e.g. a ros::AsyncSpinner
+  // with one thread) concurrently with Run(). Inputs are consumed at the start of
+  // the next Run(): every odometry message and leg detection batch in order,
+  // and only the newest localization, point cloud and goal. Odometry is stamped
+  // with its arrival time here, so time spent queued counts as latency.
+  void PostOdometry(const Eigen::Vector2f& loc,
+                    float angle,
+                    const Eigen::Vector2f& vel,
+                    float ang_vel,
+                    double time);
+  void PostLocalization(const Eigen::Vector2f& loc, float angle);
+  void PostPointCloud(const std::vector<Eigen::Vector2f>& cloud, double time);
+  void PostNavGoal(const Eigen::Vector2f& loc, float angle);
+  void PostLegDetections(const std::vector<human::Detection>& detections,
+                         double time);
+  // Run global planning on a dedicated thread instead of inside Run(). While a
+  // plan is being computed, Run() brings the car to a stop.
+  void StartPlannerThread();
 
 
   /* -------- Local Planner Functions ---------- */
@@ -89,6 +193,15 @@ class Navigation {
   void checkStalled();
   // Check if the robot is stuck
   bool isRobotStuck();
+  // Keep following the last global path while a replan runs on the planner thread
+  void followPreviousPath();
+  // Node of the last global path to aim for, picked like GlobalPlanner::getClosestPathNode.
+  // False if the robot is off the path or no node ahead is in sight.
+  bool getPreviousPathTarget(Eigen::Vector2f* target) const;
+
+  /* -------- Latency Functions ---------- */
+  // Online estimate of the actuation and observation delays
+  const LatencyEstimator& getLatencyEstimator() const;
 
   /* -------- Helper Functions ---------- */
   Eigen::Vector2f BaseLink2Odom(Eigen::Vector2f p);
@@ -105,6 +218,7 @@ class Navigation {
   /* -------- Navigation Objects -------- */
  
   LatencyCompensator LC_;
+  LatencyEstimator latency_estimator_;
   LocalPlanner local_planner_;
   GlobalPlanner global_planner_;
 
@@ -148,10 +262,61 @@ class Navigation {
   std::list<Obstacle> BaseLinkObstacleList_;
   float obstacle_memory_;  
 
+  /* ------ Loop Timing ------ */
+  double cycle_budget_;
+  double cycle_start_;
+  bool last_cycle_overrun_;
+  uint64_t shed_cycles_;
+  // Whether overBudget() may skip optional work
+  bool load_shedding_;
+  // Whether optional work should be skipped for the rest of this cycle
+  bool overBudget();
+  // Redraw and publish the visualization layers that are due
+  void publishVisualization();
+  // One control cycle, with its temporaries in the control thread's arena
+  void runCycle();
+
+  /* ------ Threading ------ */
+  util::SpscQueue<OdometryInput, 64> odometry_inputs_;
+  util::LatestValue<LocalizationInput> localization_input_;
+  util::LatestValue<PointCloudInput> cloud_input_;
+  util::LatestValue<GoalInput> goal_input_;
+  util::SpscQueue<LegDetectionInput, 16> leg_inputs_;
+  util::SpscQueue<PlanRequest, 4> plan_requests_;
+  // True while the planner thread owns global_planner_ and the humans
+  std::atomic<bool> planning_pending_;
+  std::atomic<bool> planner_running_;
+  std::thread planner_thread_;
+  // Plan requested during this cycle, dispatched once Run() is done with the planner
+  bool plan_requested_;
+  PlanRequest plan_request_;
+  // Locations of the global path when the pending plan was dispatched, so the control
+  // loop can keep following it without touching the planner
+  std::vector<Eigen::Vector2f> previous_path_;
+  // Whether the pending plan is for a new goal, in which case the car waits for it
+  bool pending_new_goal_;
+  // Written by whichever thread runs plan(), read from any thread
+  SeqLockThreadSafe<PlanStats> plan_stats_;
+
+  // Apply all inputs posted since the last cycle
+  void processInputs();
+  // Queue a plan to be dispatched at the end of the cycle
+  void requestPlan(const PlanRequest& request);
+  // Hand the queued plan to the planner thread, or run it inline if there is none
+  void dispatchPlan();
+  // Run a plan request on the global planner
+  void plan(const PlanRequest& request);
+  // Body of the planner thread
+  void plannerLoop();
+
   /* --- Social Planner Scenarios --- */
   Scenario current_scenario_; 
   void loadScenario(Scenario S);
 
+  /* --- Human Tracking --- */
+  human::HumanTracker human_tracker_;
+  human::TrackChanges track_changes_;
+
   // Remove from memory any old or deprecated obstacles - called by ObservePointCloud
   void trimObstacles(double now);
 
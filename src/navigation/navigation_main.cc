@@ -40,12 +40,17 @@
 #include "visualization_msgs/Marker.h"
 #include "visualization_msgs/MarkerArray.h"
 #include "nav_msgs/Odometry.h"
+#include "people_msgs/PositionMeasurementArray.h"
 #include "ros/ros.h"
 #include "shared/math/math_util.h"
+#include "shared/ros/metrics_publisher.h"
 #include "shared/util/timer.h"
+#include "shared/util/thread_pool.h"
+#include "shared/util/trace.h"
 #include "shared/ros/ros_helpers.h"
 
 #include "navigation.h"
+#include "navigation_node.h"
 #include "amrl_msgs/Localization2DMsg.h" // put this line at the top with other include lines
 
 using math_util::DegToRad;
@@ -69,58 +74,21 @@ DEFINE_string(init_topic,
               "initialpose",
               "Name of ROS topic for initialization");
 DEFINE_string(map, "maps/GDC1.txt", "Name of vector map file");
+DEFINE_bool(track_humans, false, "Track humans reported by the leg detector");
+DEFINE_string(legs_topic,
+              "leg_tracker_measurements",
+              "Name of ROS topic for leg detector measurements");
+DEFINE_string(trace, "", "Write a Chrome trace of the node to this file at exit");
+DEFINE_int32(threads, 0,
+             "Worker threads for parallel loops, 0 for one less than the "
+             "number of cores");
+DEFINE_int32(thread_nice, 0, "Niceness of the worker threads");
+DEFINE_double(metrics_period, 1.0,
+              "Seconds between metrics updates on /diagnostics, 0 to disable");
+DEFINE_string(metrics_file, "",
+              "Also write metrics to this file in Prometheus text format");
 
 bool run_ = true;
-sensor_msgs::LaserScan last_laser_msg_;
-Navigation* navigation_ = nullptr;
-
-void LaserCallback(const sensor_msgs::LaserScan& msg) {
-  if (FLAGS_v > 0) {
-    printf("Laser t=%f, dt=%f\n",
-           msg.header.stamp.toSec(),
-           GetWallTime() - msg.header.stamp.toSec());
-  }
-  // Location of the laser on the robot. Assumes the laser is forward-facing.
-  const Vector2f kLaserLoc(0.2, 0);
-
-  static vector<Vector2f> point_cloud_;
-  point_cloud_.clear();
-
-  // Convert the LaserScan to a point cloud in the base_link frame
-  int iter = 0;
-  for (float theta = msg.angle_min; theta <= msg.angle_max; theta += msg.angle_increment)
-  {
-    float range = msg.ranges.at(iter);
-    if (range <= msg.range_min or range >= 0.95*msg.range_max) {iter++; continue;} // Factor of 0.95 keeps max range from registering as an obstacle
-
-    point_cloud_.push_back(Vector2f {kLaserLoc[0] + range*cos(theta),
-                                     kLaserLoc[1] + range*sin(theta)});
-
-    iter++;
-  }
-
-  navigation_->ObservePointCloud(point_cloud_, msg.header.stamp.toSec());
-  last_laser_msg_ = msg;
-}
-
-void OdometryCallback(const nav_msgs::Odometry& msg) {
-  if (FLAGS_v > 0) {
-    printf("Odometry t=%f\n", msg.header.stamp.toSec());
-  }
-  navigation_->UpdateOdometry(
-      Vector2f(msg.pose.pose.position.x, msg.pose.pose.position.y),
-      2.0 * atan2(msg.pose.pose.orientation.z, msg.pose.pose.orientation.w),
-      Vector2f(msg.twist.twist.linear.x, msg.twist.twist.linear.y),
-      msg.twist.twist.angular.z);
-}
-
-void GoToCallback(const geometry_msgs::PoseStamped& msg) {
-  const Vector2f loc(msg.pose.position.x, msg.pose.position.y);
-  const float angle =
-      2.0 * atan2(msg.pose.orientation.z, msg.pose.orientation.w);
-  printf("Goal: (%f,%f) %f\u00b0\n", loc.x(), loc.y(), angle);
-  navigation_->SetNavGoal(loc, angle);
-}
 
 void SignalHandler(int) {
   if (!run_) {
@@ -131,39 +99,51 @@ void SignalHandler(int) {
   run_ = false;
 }
 
-void LocalizationCallback(const amrl_msgs::Localization2DMsg msg) {
-  if (FLAGS_v > 0) {
-    printf("Localization t=%f\n", GetWallTime());
-  }
-  navigation_->UpdateLocation(Vector2f(msg.pose.x, msg.pose.y), msg.pose.theta);
-}
-
 int main(int argc, char** argv) {
   google::ParseCommandLineFlags(&argc, &argv, false);
   signal(SIGINT, SignalHandler);
+  if (!FLAGS_trace.empty()) util::trace::Start(FLAGS_trace);
+  util::ThreadPool::Options pool_options;
+  pool_options.num_threads = FLAGS_threads;
+  pool_options.nice = FLAGS_thread_nice;
+  util::ThreadPool::ConfigureShared(pool_options);
+  util::trace::SetThreadName("control");
   // Initialize ROS.
   ros::init(argc, argv, "navigation", ros::init_options::NoSigintHandler);
   ros::NodeHandle n;
-  navigation_ = new Navigation(FLAGS_map, &n);
-
-  ros::Subscriber velocity_sub =
-      n.subscribe(FLAGS_odom_topic, 1, &OdometryCallback);
-  ros::Subscriber localization_sub =
-      n.subscribe(FLAGS_loc_topic, 1, &LocalizationCallback);
-  ros::Subscriber laser_sub =
-      n.subscribe(FLAGS_laser_topic, 1, &LaserCallback);
-  ros::Subscriber goto_sub =
-      n.subscribe("/move_base_simple/goal", 1, &GoToCallback);
-
-  navigation_->setLocalPlannerWeights(0,0,10);
-
+  navigation::NavigationTopics topics;
+  topics.laser = FLAGS_laser_topic;
+  topics.odom = FLAGS_odom_topic;
+  topics.localization = FLAGS_loc_topic;
+  topics.goal = "/move_base_simple/goal";
+  if (FLAGS_track_humans) topics.legs = FLAGS_legs_topic;
+  navigation::NavigationNode node(&n, FLAGS_map, topics);
+  Navigation* navigation = node.navigation();
+
+  navigation->setLocalPlannerWeights(0,0,10);
+  navigation->StartPlannerThread();
+
+  // Callbacks run on a single spinner thread and hand their data to the
+  // control loop through lock-free queues, so slow callbacks never stall it.
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  ros_helpers::MetricsPublisher metrics_publisher(
+      &n, "navigation", FLAGS_metrics_period, FLAGS_metrics_file);
   RateLoop loop(20.0);
   while (run_ && ros::ok()) {
-    ros::spinOnce();
-    navigation_->Run();
+    navigation->setLoopTiming(loop.LastPeriod(), loop.Budget(), loop.Overrun(),
+                              loop.Jitter());
+    navigation->Run();
+    metrics_publisher.Update();
+    if (FLAGS_v > 0) {
+      node.PrintLatencyEstimate();
+      node.PrintLoopStats(loop);
+    }
     loop.Sleep();
   }
-  delete navigation_;
+  spinner.stop();
+  loop.PrintStats(stdout, "navigation");
   return 0;
 }
 
@@ -0,0 +1,166 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+\file    navigation_node.cc
+\brief   ROS interface of Navigation
+\author  Joydeep Biswas, (C) 2019
+*/
+//========================================================================
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "amrl_msgs/Localization2DMsg.h"
+#include "geometry_msgs/PoseStamped.h"
+#include "nav_msgs/Odometry.h"
+#include "people_msgs/PositionMeasurementArray.h"
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+#include "shared/util/timer.h"
+#include "shared/util/trace.h"
+
+#include "navigation_node.h"
+
+using std::string;
+using std::vector;
+using Eigen::Vector2f;
+
+DECLARE_int32(v);
+
+namespace navigation {
+
+NavigationNode::NavigationNode(ros::NodeHandle* n,
+                               const string& map_file,
+                               const NavigationTopics& topics) :
+    navigation_(map_file, n),
+    t_last_latency_print_(0),
+    t_last_loop_print_(0) {
+  odom_sub_ = n->subscribe(
+      topics.odom, 1, &NavigationNode::OdometryCallback, this);
+  localization_sub_ = n->subscribe(
+      topics.localization, 1, &NavigationNode::LocalizationCallback, this);
+  laser_sub_ = n->subscribe(
+      topics.laser, 1, &NavigationNode::LaserCallback, this);
+  goto_sub_ = n->subscribe(
+      topics.goal, 1, &NavigationNode::GoToCallback, this);
+  if (!topics.legs.empty()) {
+    legs_sub_ = n->subscribe(
+        topics.legs, 10, &NavigationNode::LegsCallback, this);
+  }
+}
+
+void NavigationNode::LaserCallback(
+    const sensor_msgs::LaserScan::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  if (FLAGS_v > 0) {
+    printf("Laser t=%f, dt=%f\n",
+           msg->header.stamp.toSec(),
+           GetWallTime() - msg->header.stamp.toSec());
+  }
+  // Location of the laser on the robot. Assumes the laser is forward-facing.
+  const Vector2f kLaserLoc(0.2, 0);
+
+  point_cloud_.clear();
+
+  // Convert the LaserScan to a point cloud in the base_link frame
+  int iter = 0;
+  for (float theta = msg->angle_min; theta <= msg->angle_max; theta += msg->angle_increment)
+  {
+    float range = msg->ranges.at(iter);
+    if (range <= msg->range_min or range >= 0.95*msg->range_max) {iter++; continue;} // Factor of 0.95 keeps max range from registering as an obstacle
+
+    point_cloud_.push_back(Vector2f {kLaserLoc[0] + range*cos(theta),
+                                     kLaserLoc[1] + range*sin(theta)});
+
+    iter++;
+  }
+
+  navigation_.PostPointCloud(point_cloud_, msg->header.stamp.toSec());
+}
+
+void NavigationNode::OdometryCallback(
+    const nav_msgs::Odometry::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  if (FLAGS_v > 0) {
+    printf("Odometry t=%f\n", msg->header.stamp.toSec());
+  }
+  navigation_.PostOdometry(
+      Vector2f(msg->pose.pose.position.x, msg->pose.pose.position.y),
+      2.0 * atan2(msg->pose.pose.orientation.z, msg->pose.pose.orientation.w),
+      Vector2f(msg->twist.twist.linear.x, msg->twist.twist.linear.y),
+      msg->twist.twist.angular.z,
+      msg->header.stamp.toSec());
+}
+
+void NavigationNode::LocalizationCallback(
+    const amrl_msgs::Localization2DMsg::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  if (FLAGS_v > 0) {
+    printf("Localization t=%f\n", GetWallTime());
+  }
+  navigation_.PostLocalization(
+      Vector2f(msg->pose.x, msg->pose.y), msg->pose.theta);
+}
+
+void NavigationNode::GoToCallback(
+    const geometry_msgs::PoseStamped::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  const Vector2f loc(msg->pose.position.x, msg->pose.position.y);
+  const float angle =
+      2.0 * atan2(msg->pose.orientation.z, msg->pose.orientation.w);
+  printf("Goal: (%f,%f) %f\u00b0\n", loc.x(), loc.y(), angle);
+  navigation_.PostNavGoal(loc, angle);
+}
+
+void NavigationNode::LegsCallback(
+    const people_msgs::PositionMeasurementArray::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  detections_.clear();
+  for (const people_msgs::PositionMeasurement& person : msg->people) {
+    detections_.push_back(human::Detection {
+        Vector2f(person.pos.x, person.pos.y), float(person.reliability)});
+  }
+  navigation_.PostLegDetections(detections_, msg->header.stamp.toSec());
+}
+
+void NavigationNode::PrintLatencyEstimate() {
+  if (GetMonotonicTime() - t_last_latency_print_ < 1.0) return;
+  t_last_latency_print_ = GetMonotonicTime();
+  const LatencyEstimator& estimator = navigation_.getLatencyEstimator();
+  if (!estimator.hasEstimate()) return;
+  printf("Latency: actuation=%.3fs observation=%.3fs (jitter %.3fs) "
+         "correlation=%.2f\n",
+         estimator.getActuationDelay(),
+         estimator.getObservationDelay(),
+         estimator.getObservationJitter(),
+         estimator.getCorrelation());
+}
+
+void NavigationNode::PrintLoopStats(const RateLoop& loop) {
+  if (GetMonotonicTime() - t_last_loop_print_ < 5.0) return;
+  t_last_loop_print_ = GetMonotonicTime();
+  loop.PrintStats(stdout, "navigation");
+  printf("Cycles with optional work skipped: %" PRIu64 "\n",
+         navigation_.getShedCycles());
+  CumulativeFunctionTimer::PrintAllStats(stdout);
+}
+
+}  // namespace navigation
@@ -0,0 +1,94 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+\file    navigation_node.h
+\brief   ROS interface of Navigation, used by the navigation node and by
+         the single-process robot node
+\author  Joydeep Biswas, (C) 2019
+*/
+//========================================================================
+
+#include <string>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "amrl_msgs/Localization2DMsg.h"
+#include "geometry_msgs/PoseStamped.h"
+#include "nav_msgs/Odometry.h"
+#include "people_msgs/PositionMeasurementArray.h"
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+
+#include "shared/util/timer.h"
+
+#include "human.h"
+#include "navigation.h"
+
+#ifndef NAVIGATION_NODE_H
+#define NAVIGATION_NODE_H
+
+namespace navigation {
+
+// Topics that Navigation subscribes to. An empty legs_topic disables human
+// tracking.
+struct NavigationTopics {
+  std::string laser;
+  std::string odom;
+  std::string localization;
+  std::string goal;
+  std::string legs;
+};
+
+class NavigationNode {
+ public:
+  // Subscribes through @n, so the callbacks run on the callback queue of @n.
+  // Navigation expects a single callback thread, so that queue must be
+  // served by one thread only. Messages are received as shared pointers, so
+  // localization published by a component of the same process is handed
+  // over without serialization.
+  NavigationNode(ros::NodeHandle* n,
+                 const std::string& map_file,
+                 const NavigationTopics& topics);
+
+  Navigation* navigation() { return &navigation_; }
+
+  // Print the latency estimate, at most once a second.
+  void PrintLatencyEstimate();
+  // Print the timing of the control loop, at most every 5 seconds.
+  void PrintLoopStats(const RateLoop& loop);
+
+ private:
+  void LaserCallback(const sensor_msgs::LaserScan::ConstPtr& msg);
+  void OdometryCallback(const nav_msgs::Odometry::ConstPtr& msg);
+  void LocalizationCallback(const amrl_msgs::Localization2DMsg::ConstPtr& msg);
+  void GoToCallback(const geometry_msgs::PoseStamped::ConstPtr& msg);
+  void LegsCallback(const people_msgs::PositionMeasurementArray::ConstPtr& msg);
+
+  Navigation navigation_;
+  ros::Subscriber laser_sub_;
+  ros::Subscriber odom_sub_;
+  ros::Subscriber localization_sub_;
+  ros::Subscriber goto_sub_;
+  ros::Subscriber legs_sub_;
+  // Reused across callbacks, so that steady-state callbacks do not allocate
+  std::vector<Eigen::Vector2f> point_cloud_;
+  std::vector<human::Detection> detections_;
+  double t_last_latency_print_;
+  double t_last_loop_print_;
+};
+
+}  // namespace navigation
+
+#endif  // NAVIGATION_NODE_H
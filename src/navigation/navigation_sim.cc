@@ -0,0 +1,300 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+\file    navigation_sim.cc
+\brief   Headless simulator that runs the navigation scenarios without ROS
+         communication, for performance regression runs
+*/
+//========================================================================
+
+#include <inttypes.h>
+#include <math.h>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "gflags/gflags.h"
+#include "ros/time.h"
+#include "shared/math/math_util.h"
+#include "shared/util/timer.h"
+#include "shared/util/thread_pool.h"
+#include "shared/util/trace.h"
+#include "vector_map/vector_map.h"
+
+#include "navigation.h"
+
+using Eigen::Vector2f;
+using math_util::AngleMod;
+using math_util::DegToRad;
+using navigation::Navigation;
+using navigation::PlanStats;
+using std::vector;
+
+DEFINE_string(map, "maps/GDC1.txt", "Name of vector map file");
+DEFINE_string(scenarios, "1,2,3,4,5,6", "Comma separated scenarios to run");
+DEFINE_double(dt, 0.05, "Control loop period (s)");
+DEFINE_double(timeout, 120, "Simulated time before a scenario is failed (s)");
+DEFINE_double(realtime_factor, 0,
+              "Simulated seconds per wall clock second, 0 to run flat out");
+DEFINE_int32(scan_decimation, 2, "Control cycles per laser scan");
+DEFINE_string(trace, "", "Write a Chrome trace of the runs to this file at exit");
+DEFINE_int32(threads, 0,
+             "Worker threads for parallel loops, 0 for one less than the "
+             "number of cores");
+DEFINE_int32(thread_nice, 0, "Niceness of the worker threads");
+// Runs are reproducible unless shed_load is set: every plan finishes before
+// simulated time moves on, and nothing else depends on the wall clock.
+DEFINE_bool(planner_thread, false,
+            "Plan on a separate thread as on the car. Simulated time stops "
+            "until each plan is done");
+DEFINE_bool(shed_load, false,
+            "Skip optional work after wall clock overruns as on the car, which "
+            "makes the run depend on the speed of the host");
+// Override the default start and goal of the scenarios
+DEFINE_double(start_x, NAN, "Robot start x (m)");
+DEFINE_double(start_y, NAN, "Robot start y (m)");
+DEFINE_double(start_angle, NAN, "Robot start angle (rad)");
+DEFINE_double(goal_x, NAN, "Navigation goal x (m)");
+DEFINE_double(goal_y, NAN, "Navigation goal y (m)");
+
+namespace {
+// Laser model, matching the simulated Hokuyo
+const Vector2f kLaserLoc(0.2, 0);
+const float kRangeMin = 0.02;
+const float kRangeMax = 10.0;
+const float kFieldOfView = DegToRad(270.0f);
+const int kNumRays = 1081;
+// Actuation limit of the simulated car
+const float kMaxAccel = 6.0;
+// Simulated time starts here; ros::Time treats zero as unset
+const double kStartTime = 1000;
+
+struct ScenarioRun {
+  int identifier;
+  Vector2f start;
+  float start_angle;
+  Vector2f goal;
+};
+
+// Start and goal for each scenario, chosen so the path passes the humans
+const ScenarioRun kScenarioRuns[] = {
+  {1, {-0.3, 18.6}, M_PI, {-15.2, 19.0}},
+  {2, {-29.0, 9.0}, M_PI, {-41.2, 13.2}},
+  {3, {-17.8, 20.2}, -M_PI / 2, {-19.9, 8.3}},
+  {4, {-17.8, 14.0}, M_PI, {-26.8, 19.2}},
+  {5, {22.0, 9.0}, M_PI, {3.0, 9.0}},
+  {6, {-18.0, 16.0}, M_PI, {-32.7, 21.0}},
+};
+
+struct ScenarioResult {
+  int identifier;
+  bool reached_goal;
+  double sim_time;
+  double wall_time;
+  uint64_t cycles;
+  uint64_t overruns;
+  double max_cycle_time;
+  double total_cycle_time;
+  uint64_t shed_cycles;
+  PlanStats plan_stats;
+};
+
+// Robot pose and speed, integrated along the commanded arc
+struct CarState {
+  Vector2f loc;
+  float angle;
+  float speed;
+};
+
+void StepCar(float curvature, float velocity, float dt, CarState* car) {
+  const float max_change = kMaxAccel * dt;
+  car->speed += std::max(-max_change, std::min(max_change, velocity - car->speed));
+  const float distance = car->speed * dt;
+  const float dtheta = distance * curvature;
+  if (fabs(dtheta) < 1e-6) {
+    car->loc += distance * Vector2f(cos(car->angle), sin(car->angle));
+  } else {
+    const float radius = 1.0 / curvature;
+    car->loc += radius * Vector2f(sin(car->angle + dtheta) - sin(car->angle),
+                                  cos(car->angle) - cos(car->angle + dtheta));
+  }
+  car->angle = AngleMod(car->angle + dtheta);
+}
+
+// Render a scan at the car's pose and convert it to a base_link point cloud,
+// the same way navigation_main converts real scans
+void SimulateScan(vector_map::VectorMap* map, const CarState& car,
+                  vector<float>* ranges, vector<Vector2f>* cloud) {
+  const Vector2f laser_loc =
+      car.loc + Eigen::Rotation2Df(car.angle) * kLaserLoc;
+  map->GetPredictedScan(laser_loc, kRangeMin, kRangeMax,
+                        car.angle - kFieldOfView / 2,
+                        car.angle + kFieldOfView / 2, kNumRays, ranges);
+  cloud->clear();
+  const float da = kFieldOfView / kNumRays;
+  for (int i = 0; i < kNumRays; ++i) {
+    const float range = (*ranges)[i];
+    if (range <= kRangeMin || range >= 0.95 * kRangeMax) continue;
+    const float theta = -kFieldOfView / 2 + i * da;
+    cloud->push_back(kLaserLoc + range * Vector2f(cos(theta), sin(theta)));
+  }
+}
+
+bool RunScenario(ScenarioRun run, vector_map::VectorMap* map,
+                 ScenarioResult* result) {
+  if (!std::isnan(FLAGS_start_x)) run.start.x() = FLAGS_start_x;
+  if (!std::isnan(FLAGS_start_y)) run.start.y() = FLAGS_start_y;
+  if (!std::isnan(FLAGS_start_angle)) run.start_angle = FLAGS_start_angle;
+  if (!std::isnan(FLAGS_goal_x)) run.goal.x() = FLAGS_goal_x;
+  if (!std::isnan(FLAGS_goal_y)) run.goal.y() = FLAGS_goal_y;
+
+  double sim_time = kStartTime;
+  ros::Time::setNow(ros::Time(sim_time));
+  Navigation nav(FLAGS_map, nullptr);
+  nav.setLoadShedding(FLAGS_shed_load);
+  if (FLAGS_planner_thread) nav.StartPlannerThread();
+  if (!nav.SetScenario(run.identifier)) {
+    fprintf(stderr, "ERROR: Unknown scenario %d\n", run.identifier);
+    return false;
+  }
+
+  *result = ScenarioResult();
+  result->identifier = run.identifier;
+  CarState car = {run.start, run.start_angle, 0};
+  vector<float> ranges;
+  vector<Vector2f> cloud;
+  bool overrun = false;
+  bool goal_sent = false;
+  const double wall_start = GetMonotonicTime();
+
+  while (sim_time - kStartTime < FLAGS_timeout) {
+    ros::Time::setNow(ros::Time(sim_time));
+
+    // Perfect odometry and localization; odom coincides with the map frame
+    float curvature = 0, velocity = 0;
+    nav.getDriveCommand(&curvature, &velocity);
+    nav.UpdateOdometry(car.loc, car.angle, Vector2f(car.speed, 0),
+                       car.speed * curvature, sim_time, sim_time);
+    nav.UpdateLocation(car.loc, car.angle);
+    if (result->cycles % FLAGS_scan_decimation == 0) {
+      SimulateScan(map, car, &ranges, &cloud);
+      nav.ObservePointCloud(cloud, sim_time);
+    }
+    if (!goal_sent) {
+      nav.PostNavGoal(run.goal, 0);
+      goal_sent = true;
+    }
+
+    // Time the cycle against the real-time budget it would have on the car
+    nav.setLoopTiming(FLAGS_dt, FLAGS_dt, overrun, 0.0);
+    const double t_cycle = GetMonotonicTime();
+    nav.Run();
+    const double cycle_time = GetMonotonicTime() - t_cycle;
+    overrun = cycle_time > FLAGS_dt;
+    // Hold simulated time until the plan dispatched by this cycle is done, as
+    // if it had been computed inline
+    while (nav.isPlanPending()) Sleep(0.001);
+    result->cycles++;
+    result->overruns += overrun;
+    result->total_cycle_time += cycle_time;
+    result->max_cycle_time = std::max(result->max_cycle_time, cycle_time);
+
+    if (nav.isNavComplete()) {
+      result->reached_goal = true;
+      break;
+    }
+
+    nav.getDriveCommand(&curvature, &velocity);
+    StepCar(curvature, velocity, FLAGS_dt, &car);
+    sim_time += FLAGS_dt;
+
+    if (FLAGS_realtime_factor > 0) {
+      const double wall_target =
+          wall_start + (sim_time - kStartTime) / FLAGS_realtime_factor;
+      const double wait = wall_target - GetMonotonicTime();
+      if (wait > 0) Sleep(wait);
+    }
+  }
+
+  result->sim_time = sim_time - kStartTime;
+  result->wall_time = GetMonotonicTime() - wall_start;
+  result->shed_cycles = nav.getShedCycles();
+  result->plan_stats = nav.getPlanStats();
+  return true;
+}
+
+void PrintResult(const ScenarioResult& r) {
+  const PlanStats& p = r.plan_stats;
+  const uint64_t num_plans = p.plans + p.replans;
+  printf("Scenario %d: %s after %.1fs simulated (%.2fs wall, %.1fx real time)\n",
+         r.identifier, r.reached_goal ? "reached goal" : "TIMED OUT",
+         r.sim_time, r.wall_time, r.sim_time / std::max(r.wall_time, 1e-9));
+  printf("  planning: %" PRIu64 " plans, %" PRIu64 " replans, "
+         "mean %.2fms, max %.2fms\n",
+         p.plans, p.replans,
+         (num_plans > 0) ? 1000.0 * p.total_time / num_plans : 0.0,
+         1000.0 * p.max_time);
+  printf("  control loop: %" PRIu64 " cycles, %" PRIu64 " overruns, "
+         "%" PRIu64 " shed, mean %.2fms, max %.2fms\n",
+         r.cycles, r.overruns, r.shed_cycles,
+         (r.cycles > 0) ? 1000.0 * r.total_cycle_time / r.cycles : 0.0,
+         1000.0 * r.max_cycle_time);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Must come before setNow(), which it would otherwise undo
+  ros::Time::init();
+  google::ParseCommandLineFlags(&argc, &argv, false);
+  if (!FLAGS_trace.empty()) util::trace::Start(FLAGS_trace);
+  util::ThreadPool::Options pool_options;
+  pool_options.num_threads = FLAGS_threads;
+  pool_options.nice = FLAGS_thread_nice;
+  util::ThreadPool::ConfigureShared(pool_options);
+
+  vector_map::VectorMap map(FLAGS_map);
+
+  vector<int> identifiers;
+  for (const char* p = FLAGS_scenarios.c_str(); *p != '\0';) {
+    char* end = nullptr;
+    identifiers.push_back(strtol(p, &end, 10));
+    if (end == p) {
+      fprintf(stderr, "ERROR: Bad --scenarios list '%s'\n",
+              FLAGS_scenarios.c_str());
+      return 1;
+    }
+    p = (*end == ',') ? end + 1 : end;
+  }
+
+  int failures = 0;
+  for (int identifier : identifiers) {
+    const ScenarioRun* run = nullptr;
+    for (const ScenarioRun& r : kScenarioRuns) {
+      if (r.identifier == identifier) run = &r;
+    }
+    ScenarioResult result;
+    if (run == nullptr || !RunScenario(*run, &map, &result)) {
+      fprintf(stderr, "ERROR: No scenario %d\n", identifier);
+      failures++;
+      continue;
+    }
+    PrintResult(result);
+    if (!result.reached_goal) failures++;
+  }
+  return (failures == 0) ? 0 : 1;
+}
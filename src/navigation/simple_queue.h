@@ -90,9 +90,12 @@ class SimpleQueue {
   }
 
   void Clear(){
-    while (!values_.empty()){
-      Pop();
-    }
+    values_.clear();
+  }
+
+  // All values with their priorities, in no particular order.
+  const deque<pair<Value, Priority> >& Values() const {
+    return values_;
   }
 
   private:
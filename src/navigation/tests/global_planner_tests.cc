@@ -0,0 +1,74 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+#include "eigen3/Eigen/Dense"
+#include "navigation/global_planner.h"
+#include "navigation/human.h"
+
+using Eigen::Vector2f;
+using human::Human;
+
+namespace {
+
+// In the open part of the GDC1 hallway, in view of each other.
+const Vector2f kRobotLoc(-18, 16);
+const Vector2f kHumanLoc(-22, 16);
+
+// Advance the planner's clock and the human together, as the simulator does.
+void Step(double dt, double* now, Human* person) {
+  *now += dt;
+  person->move(dt);
+}
+
+TEST(GlobalPlanner, ConstantVelocityHumanDoesNotReplan) {
+  double now = 100.0;
+  GlobalPlanner planner([&now]() { return now; });
+  Human person;
+  person.setLoc(kHumanLoc);
+  person.setAngle(0.0);
+  person.setVel(Vector2f(1.0, 0.0));
+  person.setAngularVel(0.1);
+  planner.addHuman(&person);
+  ASSERT_FALSE(person.isHidden(kRobotLoc, *planner.map_));
+
+  // Simulated time runs far slower than wall time here, so any use of the
+  // wall clock would extrapolate the human past where it is.
+  for (int i = 0; i < 30; ++i) {
+    Step(0.1, &now, &person);
+    EXPECT_FALSE(planner.needSocialReplan(kRobotLoc)) << "at step " << i;
+  }
+}
+
+TEST(GlobalPlanner, HumanLeavingPredictionReplans) {
+  double now = 100.0;
+  GlobalPlanner planner([&now]() { return now; });
+  Human person;
+  person.setLoc(kHumanLoc);
+  person.setVel(Vector2f(1.0, 0.0));
+  planner.addHuman(&person);
+  ASSERT_FALSE(person.isHidden(kRobotLoc, *planner.map_));
+
+  Step(0.5, &now, &person);
+  EXPECT_FALSE(planner.needSocialReplan(kRobotLoc));
+  // Stopping puts the human behind the prediction; it takes 0.5 m to notice.
+  person.setVel(Vector2f(0.0, 0.0));
+  Step(0.4, &now, &person);
+  EXPECT_FALSE(planner.needSocialReplan(kRobotLoc));
+  Step(0.2, &now, &person);
+  EXPECT_TRUE(planner.needSocialReplan(kRobotLoc));
+}
+
+}  // namespace
@@ -0,0 +1,166 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "navigation/human.h"
+#include "navigation/human_index.h"
+#include "shared/util/random.h"
+
+using Eigen::Vector2f;
+using human::Human;
+using human::HumanIndex;
+using std::vector;
+
+namespace {
+
+const float kCellSize = 2.0;
+
+vector<Human*> BruteForceQuery(const vector<Human*> &humans, const Vector2f &loc, float radius){
+	vector<Human*> near;
+	for (Human* person : humans){
+		if ((person->getLoc() - loc).squaredNorm() <= radius * radius) near.push_back(person);
+	}
+	std::sort(near.begin(), near.end());
+	return near;
+}
+
+vector<Human*> SortedQuery(const HumanIndex &index, const Vector2f &loc, float radius){
+	vector<Human*> near = index.query(loc, radius);
+	std::sort(near.begin(), near.end());
+	return near;
+}
+
+Vector2f RandomLoc(util_random::Random *rng){
+	// Around the origin, so that cells have negative coordinates too
+	return Vector2f(rng->UniformRandom(-10, 10), rng->UniformRandom(-10, 10));
+}
+
+TEST(HumanIndex, QueryMatchesBruteForce){
+	util_random::Random rng(11);
+	vector<Human> people(300);
+	vector<Human*> humans;
+	HumanIndex index(kCellSize);
+	for (Human &person : people){
+		person.setLoc(RandomLoc(&rng));
+		humans.push_back(&person);
+		index.insert(&person);
+	}
+	ASSERT_EQ(people.size(), index.size());
+	for (int q = 0; q < 500; q++){
+		const Vector2f loc = RandomLoc(&rng);
+		// Radii from a fraction of a cell to several cells
+		const float radius = rng.UniformRandom(0.1, 3 * kCellSize);
+		ASSERT_EQ(BruteForceQuery(humans, loc, radius), SortedQuery(index, loc, radius))
+				<< "query " << q << " at (" << loc.x() << ", " << loc.y() << ") r = " << radius;
+	}
+}
+
+TEST(HumanIndex, QueriesStraddlingNegativeCells){
+	// Humans just either side of the cell boundaries through the origin
+	const float e = 1e-3;
+	const vector<Vector2f> locs = {
+			Vector2f(-e, -e), Vector2f(e, -e), Vector2f(-e, e), Vector2f(e, e),
+			Vector2f(-kCellSize - e, 0.5), Vector2f(-kCellSize + e, 0.5),
+			Vector2f(0.5, -kCellSize - e), Vector2f(-3 * kCellSize, -3 * kCellSize)};
+	vector<Human> people(locs.size());
+	vector<Human*> humans;
+	HumanIndex index(kCellSize);
+	for (size_t i = 0; i < locs.size(); i++){
+		people[i].setLoc(locs[i]);
+		humans.push_back(&people[i]);
+		index.insert(&people[i]);
+	}
+	const vector<Vector2f> centers = {
+			Vector2f(0, 0), Vector2f(-kCellSize, 0), Vector2f(-0.1, -kCellSize),
+			Vector2f(-2.5 * kCellSize, -2.5 * kCellSize)};
+	for (const Vector2f &center : centers){
+		for (float radius : {0.01f, 0.5f, 1.0f, 2.5f, 5.0f}){
+			EXPECT_EQ(BruteForceQuery(humans, center, radius), SortedQuery(index, center, radius))
+					<< "at (" << center.x() << ", " << center.y() << ") r = " << radius;
+		}
+	}
+	// All four humans around the origin, each in a different cell
+	EXPECT_EQ(4u, index.query(Vector2f(0, 0), 2 * e).size());
+}
+
+TEST(HumanIndex, UpdateRefilesMovedHumans){
+	util_random::Random rng(13);
+	vector<Human> people(100);
+	vector<Human*> humans;
+	HumanIndex index(kCellSize);
+	for (Human &person : people){
+		person.setLoc(RandomLoc(&rng));
+		humans.push_back(&person);
+		index.insert(&person);
+	}
+	for (int step = 0; step < 20; step++){
+		// Moves of up to a few cells, across the origin too; refile half of the humans one by
+		// one and the rest all at once
+		for (size_t i = 0; i < people.size(); i++){
+			people[i].setLoc(people[i].getLoc() + Vector2f(rng.UniformRandom(-5, 5), rng.UniformRandom(-5, 5)));
+			if (i % 2 == 0) index.update(&people[i]);
+		}
+		if (step % 2 == 0){
+			index.updateAll();
+		}else{
+			for (size_t i = 1; i < people.size(); i += 2) index.update(&people[i]);
+		}
+		for (int q = 0; q < 20; q++){
+			const Vector2f loc = RandomLoc(&rng);
+			const float radius = rng.UniformRandom(0.1, 2 * kCellSize);
+			ASSERT_EQ(BruteForceQuery(humans, loc, radius), SortedQuery(index, loc, radius))
+					<< "step " << step << " query " << q;
+		}
+	}
+}
+
+TEST(HumanIndex, RemoveAfterMove){
+	HumanIndex index(kCellSize);
+	Human a, b;
+	a.setLoc(Vector2f(-0.5, -0.5));
+	b.setLoc(Vector2f(-0.6, -0.6));
+	index.insert(&a);
+	index.insert(&b);
+	// Inserting again doesn't duplicate
+	index.insert(&a);
+	EXPECT_EQ(2u, index.size());
+	EXPECT_EQ(2u, index.query(Vector2f(-0.5, -0.5), 0.5).size());
+
+	// Move a into the next cell, then remove it: nothing is left under either cell
+	a.setLoc(Vector2f(0.5, 0.5));
+	index.update(&a);
+	EXPECT_EQ(vector<Human*>{&a}, index.query(Vector2f(0.5, 0.5), 0.1));
+	index.remove(&a);
+	EXPECT_FALSE(index.contains(&a));
+	EXPECT_EQ(1u, index.size());
+	EXPECT_TRUE(index.query(Vector2f(0.5, 0.5), 0.5).empty());
+	EXPECT_EQ(vector<Human*>{&b}, index.query(Vector2f(-0.5, -0.5), 0.5));
+	// Removing an unknown human is a no-op
+	index.remove(&a);
+	EXPECT_EQ(1u, index.size());
+
+	index.clear();
+	EXPECT_EQ(0u, index.size());
+	EXPECT_TRUE(index.query(Vector2f(-0.5, -0.5), 5).empty());
+}
+
+}  // namespace
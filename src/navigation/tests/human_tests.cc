@@ -0,0 +1,264 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "navigation/human.h"
+#include "navigation/human_predictor.h"
+#include "shared/math/math_util.h"
+#include "shared/util/random.h"
+
+using Eigen::ArrayXf;
+using Eigen::Vector2f;
+using human::Human;
+
+namespace {
+
+// The batch methods replace atan2 by a polynomial approximation, which must
+// stay within this many radians of the exact bearing.
+const float kMaxBearingError = 1e-4;
+// Tolerance for the terms that don't involve a bearing.
+const float kCostTolerance = 1e-4;
+// Smallest visibility angular variance of the humans below.
+const float kMinAngularVariance = 1.2 * 1.2;
+// Bilinear interpolation on the 0.1 m stamp grid is within (0.1^2 / 8) (|f_xx| + |f_yy|)
+// of a field. For 20 exp(-x^2/a - y^2/b) that is at most 40/a + 40/b, and the smallest
+// safety variance below is 0.8^2, times 2.25 while walking.
+const float kStampTolerance = 0.1 * 0.1 / 8 * 2 * 40 / (2.25 * 0.8 * 0.8);
+// The bearing term's second derivative across the grid scales as 1 / r^2.
+const float kStampBearingError = 0.05;
+
+const int kNumPoints = 2000;
+
+// Humans at assorted poses, standing and walking, with non-default fields.
+std::vector<Human> MakeHumans() {
+  std::vector<Human> humans;
+  const float angles[] = {0.0, 0.7, -2.5, 3.1};
+  for (int i = 0; i < 4; ++i) {
+    Human h;
+    h.setLoc(Vector2f(-3.0 + 2.0 * i, 1.5 - i));
+    h.setAngle(angles[i]);
+    h.setStanding(i % 2 == 0);
+    if (i == 3) {
+      h.setSafetyStdDev(1.5, 0.8);
+      h.setVisibilityStdDev(2.0, 1.2);
+      h.setFOV(M_PI / 2);
+      h.setHiddenDecay(0.5);
+    }
+    humans.push_back(h);
+  }
+  return humans;
+}
+
+// Random points in a box around the human, plus points at radius 5 (the
+// vision range) and points on both sides of the field of view boundary.
+void MakePoints(const Human& h, ArrayXf* x, ArrayXf* y) {
+  util_random::Random rng(3);
+  const int kEdgePoints = 200;
+  x->resize(kNumPoints + kEdgePoints);
+  y->resize(kNumPoints + kEdgePoints);
+  for (int i = 0; i < kNumPoints; ++i) {
+    (*x)[i] = h.getLoc().x() + rng.UniformRandom(-8, 8);
+    (*y)[i] = h.getLoc().y() + rng.UniformRandom(-8, 8);
+  }
+  for (int i = 0; i < kEdgePoints; ++i) {
+    // Ten times the allowed bearing error from the boundary, so a conforming
+    // approximation can't put these on the wrong side.
+    const float margin = (i % 2 == 0 ? 1e-3 : -1e-3);
+    const float side = (i % 4 < 2 ? 1 : -1);
+    const float bearing = h.getAngle() + side * (h.getFOV() / 2 + margin);
+    const float r = (i % 8 < 4 ? 4.99 : 5.01);
+    (*x)[kNumPoints + i] = h.getLoc().x() + r * cos(bearing);
+    (*y)[kNumPoints + i] = h.getLoc().y() + r * sin(bearing);
+  }
+}
+
+TEST(HumanCosts, SafetyBatchMatchesScalar) {
+  for (Human& h : MakeHumans()) {
+    ArrayXf x, y, costs;
+    MakePoints(h, &x, &y);
+    h.safetyCosts(x, y, &costs);
+    for (int i = 0; i < x.size(); ++i) {
+      ASSERT_NEAR(h.safetyCost(Vector2f(x[i], y[i])), costs[i], kCostTolerance)
+          << "point " << i << " = (" << x[i] << ", " << y[i] << ")";
+    }
+  }
+}
+
+TEST(HumanCosts, VisibilityBatchMatchesScalar) {
+  for (Human& h : MakeHumans()) {
+    ArrayXf x, y, costs;
+    MakePoints(h, &x, &y);
+    h.visibilityCosts(x, y, &costs);
+    int num_hidden_from_view = 0;
+    for (int i = 0; i < x.size(); ++i) {
+      const float scalar = h.visibilityCost(Vector2f(x[i], y[i]));
+      // cost = 20 exp(-r^2/r_var - (pi - |theta|)^2/t_var), so a bearing
+      // error e changes it by at most cost * 2 pi e / t_var.
+      const float bearing_slope = scalar * 2 * M_PI / kMinAngularVariance;
+      ASSERT_NEAR(scalar, costs[i],
+                  kCostTolerance + bearing_slope * kMaxBearingError)
+          << "point " << i << " = (" << x[i] << ", " << y[i] << ")";
+      // Both must agree on which side of the field of view the point is.
+      ASSERT_EQ(scalar == 0, costs[i] == 0) << "point " << i;
+      if (scalar > 0) ++num_hidden_from_view;
+    }
+    // The points must actually exercise both branches.
+    EXPECT_GT(num_hidden_from_view, 0);
+    EXPECT_LT(num_hidden_from_view, x.size());
+  }
+}
+
+TEST(HumanCosts, HiddenBatchMatchesScalar) {
+  util_random::Random rng(5);
+  for (Human& h : MakeHumans()) {
+    ArrayXf x, y, costs;
+    MakePoints(h, &x, &y);
+    ArrayXf obs_x(x.size());
+    ArrayXf obs_y(x.size());
+    for (int i = 0; i < x.size(); ++i) {
+      obs_x[i] = x[i] + rng.UniformRandom(-2, 2);
+      obs_y[i] = y[i] + rng.UniformRandom(-2, 2);
+    }
+    h.hiddenCosts(x, y, obs_x, obs_y, &costs);
+    int num_in_view = 0;
+    for (int i = 0; i < x.size(); ++i) {
+      const float scalar = h.hiddenCost(Vector2f(x[i], y[i]),
+                                        Vector2f(obs_x[i], obs_y[i]));
+      ASSERT_NEAR(scalar, costs[i], kCostTolerance)
+          << "point " << i << " = (" << x[i] << ", " << y[i] << ")";
+      if (scalar > 0) ++num_in_view;
+    }
+    EXPECT_GT(num_in_view, 0);
+    EXPECT_LT(num_in_view, x.size());
+  }
+}
+
+// Compare the stamp with the scalar costs at random points around the human, and return
+// the number of points that were checked.
+int ExpectStampMatchesScalar(Human* h, util_random::Random* rng){
+  int checked = 0;
+  for (int i = 0; i < 5000; ++i) {
+    // The stamp's bilinear interpolation can't follow the bearing term close to the human,
+    // where the safety cost dominates anyway, so start half a meter out.
+    const float r = rng->UniformRandom(0.5, 9.5);
+    const float bearing = rng->UniformRandom(-M_PI, M_PI);
+    const Vector2f p = h->getLoc() + r * Vector2f(cos(bearing), sin(bearing));
+    // Float rounding may put points right on the field of view edge on either side.
+    const float off_heading = fabs(math_util::AngleDiff(bearing, h->getAngle()));
+    if (fabs(off_heading - h->getFOV() / 2) < 1e-3) continue;
+    float safety = 0;
+    float visibility = 0;
+    h->stampCosts(p, &safety, &visibility);
+    ++checked;
+    EXPECT_NEAR(h->safetyCost(p), safety, kStampTolerance)
+        << "at r = " << r << ", bearing = " << bearing;
+    // The interpolation error of the bearing term grows as 1 / r^2.
+    EXPECT_NEAR(h->visibilityCost(p), visibility,
+                kStampTolerance + kStampBearingError / math_util::Sq(r))
+        << "at r = " << r << ", bearing = " << bearing;
+    if (::testing::Test::HasFailure()) break;
+  }
+  return checked;
+}
+
+TEST(HumanStamp, MatchesScalarAfterTranslationAndRotation) {
+  util_random::Random rng(9);
+  for (Human& h : MakeHumans()) {
+    EXPECT_GT(ExpectStampMatchesScalar(&h, &rng), 0);
+    const unsigned int builds = h.getStampBuilds();
+    EXPECT_EQ(1u, builds);
+    // A translated human reuses its stamp.
+    h.setLoc(h.getLoc() + Vector2f(12.5, -7.25));
+    ExpectStampMatchesScalar(&h, &rng);
+    EXPECT_EQ(builds, h.getStampBuilds());
+    // So does a rotated one; the stamp is in the human's frame.
+    h.setAngle(h.getAngle() + 1.3);
+    ExpectStampMatchesScalar(&h, &rng);
+    EXPECT_EQ(builds, h.getStampBuilds());
+  }
+}
+
+TEST(HumanStamp, RebuildsOnlyForNewFields) {
+  Human h;
+  h.setStanding(true);
+  float safety = 0;
+  float visibility = 0;
+  // Built lazily, on the first lookup.
+  EXPECT_EQ(0u, h.getStampBuilds());
+  h.stampCosts(Vector2f(1, 1), &safety, &visibility);
+  EXPECT_EQ(1u, h.getStampBuilds());
+  // Lookups outside the stamp don't build it.
+  h.setStanding(false);
+  h.stampCosts(Vector2f(50, 0), &safety, &visibility);
+  EXPECT_EQ(0, safety);
+  EXPECT_EQ(1u, h.getStampBuilds());
+  h.stampCosts(Vector2f(1, 1), &safety, &visibility);
+  EXPECT_EQ(2u, h.getStampBuilds());
+
+  // Nor do moves, turns, or setting the same state again.
+  h.setLoc(Vector2f(-3, 4));
+  h.setStanding(false);
+  const float angles[] = {0.0, 0.012, 1.3, M_PI - 0.003, -M_PI + 0.003};
+  for (float angle : angles) {
+    h.setAngle(angle);
+    h.stampCosts(Vector2f(-2, 4), &safety, &visibility);
+    EXPECT_EQ(2u, h.getStampBuilds());
+    EXPECT_NEAR(h.safetyCost(Vector2f(-2, 4)), safety, kStampTolerance);
+  }
+
+  h.setStanding(true);
+  h.stampCosts(Vector2f(-2, 4), &safety, &visibility);
+  EXPECT_EQ(3u, h.getStampBuilds());
+  h.setSafetyStdDev(1.5, 1.0);
+  h.stampCosts(Vector2f(-2, 4), &safety, &visibility);
+  EXPECT_EQ(4u, h.getStampBuilds());
+  EXPECT_NEAR(h.safetyCost(Vector2f(-2, 4)), safety, kStampTolerance);
+}
+
+TEST(HumanStamp, PredictionLayersShareTheStamp) {
+  // Turning at 0.5 rad/s, so every 0.5 s layer has a different heading.
+  Human h;
+  h.setLoc(Vector2f(1, 2));
+  h.setVel(Vector2f(0.5, 0));
+  h.setAngularVel(0.5);
+  human::HumanPredictor predictor(8.0, 0.5, 2.0);
+  const std::vector<Human*> population = {&h};
+  float safety = 0;
+  float visibility = 0;
+  int lookups = 0;
+  for (int update = 0; update < 10; ++update) {
+    predictor.predict(population);
+    for (int k = 1; k < predictor.numLayers(); ++k) {
+      predictor.getLayer(k).forEachNear(h.getLoc(), 100, [&](Human* future) {
+        const Vector2f robot_loc = future->getLoc() + Vector2f(1, 0.5);
+        future->stampCosts(robot_loc, &safety, &visibility);
+        EXPECT_NEAR(future->safetyCost(robot_loc), safety, kStampTolerance);
+        // The copy looked up the stamp predict() built for the human.
+        EXPECT_EQ(1u, future->getStampBuilds());
+        ++lookups;
+      });
+    }
+    // The next update predicts from where the human got to meanwhile, 20 ms later.
+    h.move(0.02);
+  }
+  EXPECT_EQ(10 * (predictor.numLayers() - 1), lookups);
+  EXPECT_EQ(1u, h.getStampBuilds());
+}
+
+}  // namespace
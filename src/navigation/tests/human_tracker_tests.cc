@@ -0,0 +1,161 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "navigation/human_tracker.h"
+#include "shared/util/random.h"
+
+using Eigen::Vector2f;
+using human::Detection;
+using human::HumanTracker;
+using human::TrackChanges;
+using std::vector;
+
+namespace {
+
+const float kGateDistance = 1.0;
+
+double AssignmentCost(const vector<vector<double>> &cost, const vector<int> &col_of){
+	double total = 0;
+	for (size_t i = 0; i < cost.size(); i++) total += cost[i][col_of[i]];
+	return total;
+}
+
+// Cheapest total cost over every permutation
+double BruteForceCost(const vector<vector<double>> &cost){
+	vector<int> col_of(cost.size());
+	std::iota(col_of.begin(), col_of.end(), 0);
+	double best = AssignmentCost(cost, col_of);
+	while (std::next_permutation(col_of.begin(), col_of.end())){
+		best = std::min(best, AssignmentCost(cost, col_of));
+	}
+	return best;
+}
+
+Detection MakeDetection(float x, float y, float reliability = 1.0){
+	Detection detection;
+	detection.loc = Vector2f(x, y);
+	detection.reliability = reliability;
+	return detection;
+}
+
+TEST(SolveAssignment, MatchesBruteForce){
+	util_random::Random rng(7);
+	for (int trial = 0; trial < 3000; trial++){
+		// Gated tracker problems: distances within the gate, with gated and padding cells at the
+		// unmatched cost the tracker uses
+		const int n = 1 + trial % 8;
+		const double unmatched_cost = kGateDistance * n + 1;
+		vector<vector<double>> cost(n, vector<double>(n));
+		for (int i = 0; i < n; i++){
+			for (int j = 0; j < n; j++){
+				const bool gated = rng.UniformRandom(0, 1) < 0.4;
+				cost[i][j] = gated ? unmatched_cost : rng.UniformRandom(0, kGateDistance);
+			}
+		}
+		const vector<int> col_of = human::solveAssignment(cost);
+		// A permutation
+		vector<int> sorted = col_of;
+		std::sort(sorted.begin(), sorted.end());
+		for (int j = 0; j < n; j++) ASSERT_EQ(j, sorted[j]) << "trial " << trial;
+		ASSERT_NEAR(BruteForceCost(cost), AssignmentCost(cost, col_of), 1e-9) << "trial " << trial;
+	}
+}
+
+TEST(HumanTracker, BirthNeedsReliableDetection){
+	HumanTracker tracker;
+	TrackChanges changes;
+	tracker.update({MakeDetection(0, 0, 0.9), MakeDetection(5, 0, 0.1)}, 1.0, &changes);
+	ASSERT_EQ(1u, tracker.numTracks());
+	ASSERT_EQ(1u, changes.added.size());
+	EXPECT_TRUE(changes.updated.empty());
+	EXPECT_TRUE(changes.removed.empty());
+	EXPECT_EQ(Vector2f(0, 0), changes.added[0]->getLoc());
+	EXPECT_EQ(tracker.getHumans()[0], changes.added[0]);
+}
+
+TEST(HumanTracker, MatchedTrackFollowsDetection){
+	HumanTracker tracker;
+	TrackChanges changes;
+	tracker.update({MakeDetection(0, 0)}, 1.0, &changes);
+	human::Human *person = changes.added[0];
+	tracker.update({MakeDetection(0.5, 0)}, 1.5, &changes);
+	ASSERT_EQ(1u, tracker.numTracks());
+	EXPECT_TRUE(changes.added.empty());
+	ASSERT_EQ(1u, changes.updated.size());
+	EXPECT_EQ(person, changes.updated[0]);
+	EXPECT_TRUE(person->getLoc().isApprox(Vector2f(0.5, 0)));
+	// Smoothed towards the measured 1 m/s
+	EXPECT_NEAR(0.3, person->getVel().x(), 1e-5);
+	EXPECT_NEAR(0.0, person->getVel().y(), 1e-5);
+}
+
+TEST(HumanTracker, GatedDetectionStartsNewTrack){
+	HumanTracker tracker;
+	tracker.setGateDistance(kGateDistance);
+	TrackChanges changes;
+	tracker.update({MakeDetection(0, 0)}, 1.0, &changes);
+	tracker.update({MakeDetection(kGateDistance + 0.1, 0)}, 1.1, &changes);
+	EXPECT_EQ(2u, tracker.numTracks());
+	EXPECT_EQ(1u, changes.added.size());
+	EXPECT_TRUE(changes.updated.empty());
+}
+
+TEST(HumanTracker, OptimalAssignmentBeatsNearestNeighbor){
+	// Matching the closest pair first would take the left detection for the right track and
+	// leave the left track unmatched
+	HumanTracker tracker;
+	tracker.setGateDistance(kGateDistance);
+	TrackChanges changes;
+	tracker.update({MakeDetection(0, 0), MakeDetection(1, 0)}, 1.0, &changes);
+	const vector<human::Human*> humans = tracker.getHumans();
+	tracker.update({MakeDetection(0.6, 0), MakeDetection(1.7, 0)}, 1.0, &changes);
+	EXPECT_EQ(2u, tracker.numTracks());
+	EXPECT_TRUE(changes.added.empty());
+	EXPECT_EQ(2u, changes.updated.size());
+	EXPECT_TRUE(humans[0]->getLoc().isApprox(Vector2f(0.6, 0)));
+	EXPECT_TRUE(humans[1]->getLoc().isApprox(Vector2f(1.7, 0)));
+}
+
+TEST(HumanTracker, UnseenTrackRetires){
+	HumanTracker tracker;
+	tracker.setMaxMissedTime(1.0);
+	TrackChanges changes;
+	tracker.update({MakeDetection(0, 0), MakeDetection(5, 0)}, 1.0, &changes);
+	const vector<human::Human*> humans = tracker.getHumans();
+	// The second person is seen throughout, the first one is not seen again
+	tracker.update({MakeDetection(5, 0)}, 1.5, &changes);
+	EXPECT_EQ(2u, tracker.numTracks());
+	EXPECT_TRUE(changes.removed.empty());
+	tracker.update({MakeDetection(5, 0)}, 2.2, &changes);
+	ASSERT_EQ(1u, tracker.numTracks());
+	ASSERT_EQ(1u, changes.removed.size());
+	EXPECT_EQ(humans[0], changes.removed[0]);
+	EXPECT_EQ(humans[1], tracker.getHumans()[0]);
+	// Removed humans stay valid until the next update
+	EXPECT_EQ(Vector2f(0, 0), changes.removed[0]->getLoc());
+	tracker.update({}, 2.3, &changes);
+	EXPECT_TRUE(changes.removed.empty());
+}
+
+}  // namespace
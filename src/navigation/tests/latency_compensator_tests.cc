@@ -0,0 +1,142 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "navigation/latency_compensator.h"
+
+namespace {
+
+// Integrate a constant curvature command with small Euler steps, as an
+// independent check of the closed-form arcs.
+void Integrate(double curvature, double velocity, double dt, state2D* state) {
+  const int kSteps = 100000;
+  const double step = dt / kSteps;
+  double x = state->x;
+  double y = state->y;
+  double theta = state->theta;
+  for (int i = 0; i < kSteps; ++i) {
+    // Midpoint heading keeps the error at O(step^2).
+    const double mid_theta = theta + 0.5 * curvature * velocity * step;
+    x += velocity * step * std::cos(mid_theta);
+    y += velocity * step * std::sin(mid_theta);
+    theta += curvature * velocity * step;
+  }
+  state->x = x;
+  state->y = y;
+  state->theta = theta;
+}
+
+}  // namespace
+
+TEST(LatencyCompensator, NoObservation) {
+  double now = 0;
+  LatencyCompensator compensator(0.2, 0.1, [&now]() { return now; });
+  compensator.recordNewInput(0.5, 1);
+  now = 1;
+  const state2D state = compensator.predictedState();
+  EXPECT_EQ(0, state.x);
+  EXPECT_EQ(0, state.y);
+  EXPECT_EQ(0, state.theta);
+}
+
+TEST(LatencyCompensator, IntegratesArcsBetweenUnevenInputs) {
+  double now = 0;
+  LatencyCompensator compensator(0.2, 0.1, [&now]() { return now; });
+  // Acts from 0.2 to 0.57, entirely before the observation.
+  compensator.recordNewInput(0.5, 1);
+  now = 0.37;
+  // Acts from 0.57 to 1.25.
+  compensator.recordNewInput(-1, 2);
+  now = 1.0;
+  // True at 0.9.
+  compensator.recordObservation(1, 2, 0.3, now);
+  // The first input stopped acting before the observation.
+  EXPECT_EQ(1, compensator.numInputs());
+  now = 1.05;
+  // Acts from 1.25 on, a straight line.
+  compensator.recordNewInput(0, 1.5);
+  now = 1.4;
+
+  state2D expected = {1, 2, 0.3, 0, 0, 0};
+  Integrate(-1, 2, 1.25 - 0.9, &expected);
+  Integrate(0, 1.5, 1.4 - 1.25, &expected);
+  const state2D predicted = compensator.predictedState();
+  EXPECT_NEAR(expected.x, predicted.x, 1e-5);
+  EXPECT_NEAR(expected.y, predicted.y, 1e-5);
+  EXPECT_NEAR(expected.theta, predicted.theta, 1e-5);
+  // The velocity is that of the command acting on the car now.
+  EXPECT_NEAR(1.5 * std::cos(predicted.theta), predicted.vx, 1e-6);
+  EXPECT_NEAR(1.5 * std::sin(predicted.theta), predicted.vy, 1e-6);
+  EXPECT_EQ(0, predicted.omega);
+}
+
+TEST(LatencyCompensator, CommandNotActingYet) {
+  double now = 0;
+  LatencyCompensator compensator(0.2, 0.1, [&now]() { return now; });
+  compensator.recordNewInput(1, 1);
+  now = 0.5;
+  compensator.recordObservation(0, 0, 0, now);
+  now = 0.6;
+  // Only acts from 0.8, after now.
+  compensator.recordNewInput(-1, 3);
+  state2D expected = {0, 0, 0, 0, 0, 0};
+  Integrate(1, 1, 0.6 - 0.4, &expected);
+  const state2D predicted = compensator.predictedState();
+  EXPECT_NEAR(expected.x, predicted.x, 1e-5);
+  EXPECT_NEAR(expected.y, predicted.y, 1e-5);
+  EXPECT_NEAR(expected.theta, predicted.theta, 1e-5);
+  EXPECT_NEAR(1, predicted.omega, 1e-6);
+}
+
+TEST(LatencyCompensator, ObservationAgesFromArrival) {
+  double now = 0;
+  LatencyCompensator compensator(0.2, 0.1, [&now]() { return now; });
+  compensator.recordNewInput(1, 1);
+  // Received at 0.5 but only processed at 0.7, so it was true at 0.4.
+  now = 0.7;
+  compensator.recordObservation(0, 0, 0, 0.5);
+  state2D expected = {0, 0, 0, 0, 0, 0};
+  Integrate(1, 1, 0.7 - 0.4, &expected);
+  const state2D predicted = compensator.predictedState();
+  EXPECT_NEAR(expected.x, predicted.x, 1e-5);
+  EXPECT_NEAR(expected.y, predicted.y, 1e-5);
+  EXPECT_NEAR(expected.theta, predicted.theta, 1e-5);
+}
+
+TEST(LatencyCompensator, PrunesStaleInputs) {
+  double now = 0;
+  LatencyCompensator compensator(0.2, 0.1, [&now]() { return now; });
+  // Much longer than the capacity of the input buffer, at 20Hz with an
+  // observation after every command.
+  for (int i = 0; i < 1000; ++i) {
+    now = 0.05 * i;
+    compensator.recordNewInput(0.1, 1);
+    now += 0.01;
+    compensator.recordObservation(0, 0, 0, now);
+    // Inputs sent in the last 0.31s may still act after the observation,
+    // and one more is acting when it was made.
+    ASSERT_LE(compensator.numInputs(), 8u);
+  }
+  // Prediction from the last observation only integrates the recent
+  // inputs.
+  state2D expected = {0, 0, 0, 0, 0, 0};
+  Integrate(0.1, 1, 0.1, &expected);
+  const state2D predicted = compensator.predictedState();
+  EXPECT_NEAR(expected.x, predicted.x, 1e-5);
+  EXPECT_NEAR(expected.y, predicted.y, 1e-5);
+  EXPECT_NEAR(expected.theta, predicted.theta, 1e-5);
+}
@@ -30,7 +30,13 @@
 #include "shared/math/geometry.h"
 #include "shared/math/line2d.h"
 #include "shared/math/math_util.h"
+#include "shared/math/statistics.h"
+#include "shared/util/allocation_counter.h"
+#include "shared/util/arena.h"
+#include "shared/util/metrics.h"
+#include "shared/util/thread_pool.h"
 #include "shared/util/timer.h"
+#include "shared/util/trace.h"
 
 #include "config_reader/config_reader.h"
 #include "particle_filter.h"
@@ -56,13 +62,40 @@ namespace {
   int updates_since_last_resample_ = 0;
   Vector2f last_update_loc_(0,0);
   Vector2f last_resample_loc_(0,0);
+
+  util::metrics::Counter scans_processed_(
+      "particle_filter_scans_processed_total",
+      "Laser scans used to update the particle weights");
+  util::metrics::Counter scans_skipped_(
+      "particle_filter_scans_skipped_total",
+      "Laser scans skipped because the robot had not moved enough");
+  util::metrics::Counter resamples_(
+      "particle_filter_resamples_total", "Particle resampling steps");
+  util::metrics::Gauge num_particles_(
+      "particle_filter_particles", "Number of particles");
+  util::metrics::Gauge log_weight_spread_(
+      "particle_filter_log_weight_stddev",
+      "Standard deviation of the particle log weights after the last update");
+  util::metrics::Gauge update_allocations_(
+      "particle_filter_update_allocations",
+      "Heap allocations made by the last particle weight update, which "
+      "should be 0 once warmed up");
+  util::metrics::Histogram update_time_(
+      "particle_filter_update_seconds",
+      "Time to update the particle weights with a laser scan",
+      util::metrics::LatencyBounds());
 } // namespace
 
 namespace particle_filter {
 
+// Observation likelihood model
+CONFIG_FLOAT(obs_variance_, "obs_variance");
+CONFIG_FLOAT(obs_d_short_, "obs_d_short");
+CONFIG_FLOAT(obs_d_long_, "obs_d_long");
 config_reader::ConfigReader config_reader_({"config/particle_filter.lua"});
 
 ParticleFilter::ParticleFilter() :
+    map_(std::make_shared<VectorMap>()),
     prev_odom_loc_(0, 0),
     prev_odom_angle_(0),
     odom_initialized_(false),
@@ -75,15 +108,17 @@ void ParticleFilter::GetParticles(vector<Particle>* particles) const {
 }
 
 // Return intersection points in a known map with a given pose
-void ParticleFilter::GetPredictedPointCloud(const Vector2f& loc,
-                                            const float angle,
-                                            int num_ranges,
-                                            float range_min,
-                                            float range_max,
-                                            float angle_min,
-                                            float angle_max,
-                                            vector<Vector2f>* scan_ptr) {
-  vector<Vector2f>& scan = *scan_ptr;
+template <typename Allocator>
+void ParticleFilter::GetPredictedPointCloud(
+    const Vector2f& loc,
+    const float angle,
+    int num_ranges,
+    float range_min,
+    float range_max,
+    float angle_min,
+    float angle_max,
+    vector<Vector2f, Allocator>* scan_ptr) {
+  vector<Vector2f, Allocator>& scan = *scan_ptr;
 
   // Note: The returned values must be set using the `scan` variable:
   scan.resize(num_ranges/10);
@@ -105,7 +140,7 @@ void ParticleFilter::GetPredictedPointCloud(const Vector2f& loc,
     Vector2f intersection_min = lidar_loc + range_max * Vector2f( cos(ray_angle), sin(ray_angle) );
     float dist_to_intersection_min = range_max;
     // Sweep through lines in map to get the closest intersection with laser ray
-    for (const line2f map_line : map_.lines)
+    for (const line2f& map_line : map_->lines)
     {
       Vector2f intersection_point;
       bool intersects = map_line.Intersection(ray_line, &intersection_point);
@@ -127,6 +162,13 @@ void ParticleFilter::GetPredictedPointCloud(const Vector2f& loc,
   }
 }
 
+template void ParticleFilter::GetPredictedPointCloud(
+    const Vector2f&, const float, int, float, float, float, float,
+    vector<Vector2f>*);
+template void ParticleFilter::GetPredictedPointCloud(
+    const Vector2f&, const float, int, float, float, float, float,
+    util::ArenaVector<Vector2f>*);
+
 // Update weight of a given particle based on how well it fits map
 void ParticleFilter::Update(const vector<float>& ranges,
                             float range_min,
@@ -138,8 +180,12 @@ void ParticleFilter::Update(const vector<float>& ranges,
 
   if (not odom_initialized_) return;
 
+  // Temporaries come from the arena of the thread running this update.
+  util::Arena::Scope scope(&util::ThreadArena());
+
   // Get predicted point cloud
-  vector<Vector2f> predicted_cloud;
+  util::ArenaVector<Vector2f> predicted_cloud(
+      util::ArenaAllocator<Vector2f>(scope.arena()));
   GetPredictedPointCloud(particle.loc, particle.angle,
                          ranges.size(),
                          range_min, range_max,
@@ -148,7 +194,8 @@ void ParticleFilter::Update(const vector<float>& ranges,
 
   // Resize ranges to match predicted size
   int ratio = ranges.size() / predicted_cloud.size();
-  vector<float> trimmed_ranges(predicted_cloud.size());
+  util::ArenaVector<float> trimmed_ranges(
+      predicted_cloud.size(), 0.0f, util::ArenaAllocator<float>(scope.arena()));
   for (size_t i = 0; i < predicted_cloud.size(); i++)
     {trimmed_ranges[i] = ranges[ratio*i];}
 
@@ -177,11 +224,14 @@ void ParticleFilter::Update(const vector<float>& ranges,
 // Resample particles to duplicate good ones and get rid of bad ones
 void ParticleFilter::Resample() 
 {
+  TRACE_FUNCTION();
   // Check whether particles have been initialized
   if (particles_.empty() or not odom_initialized_) return;
 
   // Initialize Local Variables (static for speed in exchange for memory)
-  vector<Particle> new_particles;                                         // temp variable to house new particles
+  util::Arena::Scope scope(&util::ThreadArena());
+  util::ArenaVector<Particle> new_particles(                              // temp variable to house new particles
+      util::ArenaAllocator<Particle>(scope.arena()));
   static vector<float> absolute_weight_breakpoints(FLAGS_num_particles);  // vector of cumulative absolute normalized weights
   float normalized_sum = 0;                                               // sum of normalized (but NOT log) weights: used for resampling
 
@@ -208,7 +258,7 @@ void ParticleFilter::Resample()
 
   // Now that all particles are normalized, the maximum log weight will be 0
   max_log_particle_weight_ = 0;
-  particles_ = new_particles;
+  particles_.assign(new_particles.begin(), new_particles.end());
 }
 
 // A new laser scan observation is available (in the laser frame)
@@ -217,38 +267,70 @@ void ParticleFilter::ObserveLaser(const vector<float>& ranges,
                                   float range_max,
                                   float angle_min,
                                   float angle_max) {
+  static CumulativeFunctionTimer function_timer_(__FUNCTION__);
+  CumulativeFunctionTimer::Invocation invoke(&function_timer_);
+  TRACE_FUNCTION();
 
   const float dist_since_last_update = (prev_odom_loc_ - last_update_loc_).norm();
 
   // Test if we've moved > 0.1 meters (for efficiency)
   // Test if we've moved < 1.0 meters (for jumping error at initialization) 
   if (dist_since_last_update > 0.1 and dist_since_last_update < 1.0) {
+    const double t_start = GetMonotonicTime();
+    const util::AllocationCounter allocations;
     // Update last update location
     last_update_loc_ = prev_odom_loc_;
 
-    // Since the range of weights is (-inf,0] we have to initialize max at -inf
-    max_log_particle_weight_ = -std::numeric_limits<float>::infinity();
+    // Weigh every particle of this scan with the same version of the model
+    const config_reader::ConfigSnapshotPtr config =
+        config_reader::CurrentSnapshot();
+    var_obs_ = config->Get(CONFIG_KEY_obs_variance_);
+    d_short_ = config->Get(CONFIG_KEY_obs_d_short_);
+    d_long_ = config->Get(CONFIG_KEY_obs_d_long_);
+
+    // Update all particle weights in parallel and find the maximum weight.
+    // Since the range of weights is (-inf,0] the maximum starts at -inf.
+    max_log_particle_weight_ = util::ThreadPool::Shared().ParallelReduce(
+        0, particles_.size(), 1,
+        -std::numeric_limits<double>::infinity(),
+        [&](size_t begin, size_t end) {
+      double max_log_weight = -std::numeric_limits<double>::infinity();
+      for (size_t i = begin; i < end; ++i) {
+        Update(ranges, range_min, range_max, angle_min, angle_max,
+               &particles_[i]);
+        max_log_weight = std::max(max_log_weight, particles_[i].log_weight);
+      }
+      return max_log_weight;
+    },
+        [](double a, double b) { return std::max(a, b); });
 
-    // Update all particle weights and find the maximum weight
-    for (auto &particle : particles_)
-    {
-      Update(ranges, range_min, range_max, angle_min, angle_max, &particle);
-      if (particle.log_weight > max_log_particle_weight_) max_log_particle_weight_ = particle.log_weight;
-    }
+    // A small spread means the scan barely tells the particles apart
+    statistics::RunningStats<double> log_weights;
+    for (const Particle& p : particles_) log_weights.Add(p.log_weight);
+    log_weight_spread_.Set(log_weights.StdDev());
 
     // Resample every n updates
     if (updates_since_last_resample_ > 5){
       Resample();
       updates_since_last_resample_ = 0;
       last_resample_loc_ = prev_odom_loc_;
+      resamples_.Increment();
     }
     else updates_since_last_resample_ ++;
+
+    scans_processed_.Increment();
+    num_particles_.Set(particles_.size());
+    update_allocations_.Set(allocations.Total());
+    update_time_.Observe(GetMonotonicTime() - t_start);
+  } else {
+    scans_skipped_.Increment();
   }
 }
 
 // Get changes in odom frame and call UpdateParticleLocation to add noise
 void ParticleFilter::ObserveOdometry(const Vector2f& odom_loc,
                                      const float odom_angle) {
+  TRACE_FUNCTION();
   Vector2f odom_trans_diff = odom_loc - prev_odom_loc_;
 
   // Only executes if odom is initialized and a realistic value
@@ -260,13 +342,21 @@ void ParticleFilter::ObserveOdometry(const Vector2f& odom_loc,
     if (std::abs(angle_diff) > M_2PI)
       cout << "Error: reported change in angle exceeds 2pi" << endl;
 
-    for (auto &particle : particles_)
+    // Draw the noise for all particles at once, which is much cheaper than
+    // one Gaussian() call per sample
+    util::Arena::Scope scope(&util::ThreadArena());
+    util::ArenaVector<float> unit_noise(
+        3 * particles_.size(), 0.0f, util::ArenaAllocator<float>(scope.arena()));
+    rng_.FillGaussian(0.0f, 1.0f, unit_noise.size(), unit_noise.data());
+
+    for (size_t i = 0; i < particles_.size(); i++)
     {
+      Particle& particle = particles_[i];
       // Find the transformation between the map and odom frame for this particle
       Eigen::Rotation2Df R_Odom2Map(AngleDiff(particle.angle, prev_odom_angle_));
       Vector2f map_trans_diff = R_Odom2Map * odom_trans_diff;
       // Apply noise to pose of particle
-      UpdateParticleLocation(map_trans_diff, angle_diff, &particle);
+      UpdateParticleLocation(map_trans_diff, angle_diff, &unit_noise[3 * i], &particle);
     }
     prev_odom_loc_ = odom_loc;
     prev_odom_angle_ = odom_angle;
@@ -280,7 +370,7 @@ void ParticleFilter::ObserveOdometry(const Vector2f& odom_loc,
 }
 
 // Update a given particle with random noise based on motion model
-void ParticleFilter::UpdateParticleLocation(Vector2f map_trans_diff, float dtheta_odom, Particle* p_ptr)
+void ParticleFilter::UpdateParticleLocation(Vector2f map_trans_diff, float dtheta_odom, const float* unit_noise, Particle* p_ptr)
 {
   // Noise constants to tune
   const float k1 = 0.40;  // translation error per unit translation (suggested: 0.1-0.2)  was 1
@@ -292,9 +382,9 @@ void ParticleFilter::UpdateParticleLocation(Vector2f map_trans_diff, float dthet
   const float abs_angle_diff = abs(dtheta_odom);
 
   // Add noise to x, y, and theta based on movement in that dimension
-  const float translation_noise_x = rng_.Gaussian(0.0, k1*map_trans_diff.norm() + k2*abs_angle_diff);
-  const float translation_noise_y = rng_.Gaussian(0.0, k1*map_trans_diff.norm() + k2*abs_angle_diff);
-  const float rotation_noise = rng_.Gaussian(0.0, k3*map_trans_diff.norm() + k4*abs_angle_diff);
+  const float translation_noise_x = unit_noise[0] * (k1*map_trans_diff.norm() + k2*abs_angle_diff);
+  const float translation_noise_y = unit_noise[1] * (k1*map_trans_diff.norm() + k2*abs_angle_diff);
+  const float rotation_noise = unit_noise[2] * (k3*map_trans_diff.norm() + k4*abs_angle_diff);
   particle.loc += map_trans_diff + Vector2f(translation_noise_x, translation_noise_y);
   particle.angle += dtheta_odom + rotation_noise;
 }
@@ -304,7 +394,7 @@ void ParticleFilter::Initialize(const string& map_file,
                                 const Vector2f& loc,
                                 const float angle) {
   particles_.clear(); // Need to get rid of particles from previous inits
-  map_.Load("maps/" + map_file + ".txt");
+  map_ = vector_map::LoadShared("maps/" + map_file + ".txt");
   odom_initialized_ = false;
   ResetOdomVariables(loc, angle);
 
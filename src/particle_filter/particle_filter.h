@@ -20,6 +20,7 @@
 //========================================================================
 
 #include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "eigen3/Eigen/Dense"
@@ -69,8 +70,9 @@ class ParticleFilter {
   // Get robot's current location.
   void GetLocation(Eigen::Vector2f* loc, float* angle) const;
 
-  // Update a particle's location given current and last odom
-  void UpdateParticleLocation(Eigen::Vector2f map_trans_diff, float dtheta_odom, Particle* p_ptr);
+  // Update a particle's location given current and last odom, and three
+  // standard normal samples to scale into the motion noise.
+  void UpdateParticleLocation(Eigen::Vector2f map_trans_diff, float dtheta_odom, const float* unit_noise, Particle* p_ptr);
 
   // Update particle weight based on laser.
   void Update(const std::vector<float>& ranges,
@@ -84,14 +86,17 @@ class ParticleFilter {
   void Resample();
 
   // For debugging: get predicted point cloud from current location.
-  void GetPredictedPointCloud(const Eigen::Vector2f& loc,
-                              const float angle,
-                              int num_ranges,
-                              float range_min,
-                              float range_max,
-                              float angle_min,
-                              float angle_max,
-                              std::vector<Eigen::Vector2f>* scan);
+  // Instantiated for std::allocator and util::ArenaAllocator.
+  template <typename Allocator>
+  void GetPredictedPointCloud(
+      const Eigen::Vector2f& loc,
+      const float angle,
+      int num_ranges,
+      float range_min,
+      float range_max,
+      float angle_min,
+      float angle_max,
+      std::vector<Eigen::Vector2f, Allocator>* scan);
   
   Eigen::Vector2f Map2BaseLink(const Eigen::Vector2f& point, const Eigen::Vector2f& loc, const float angle);
   Eigen::Vector2f OdomVec2Map(const Eigen::Vector2f odom_vec);
@@ -101,8 +106,8 @@ class ParticleFilter {
   // List of particles being tracked.
   std::vector<Particle> particles_;
 
-  // Map of the environment.
-  vector_map::VectorMap map_;
+  // Map of the environment, shared with the other components of the process.
+  std::shared_ptr<const vector_map::VectorMap> map_;
 
   // Random number generator.
   util_random::Random rng_;
@@ -113,7 +118,7 @@ class ParticleFilter {
   bool odom_initialized_;
   float init_offset_angle_;
 
-  // Observation Likelihood Model
+  // Observation Likelihood Model, refreshed from the config before each scan
   float var_obs_;   // variance of the gaussian portion of the model
   float d_short_;
   float d_long_;
@@ -29,42 +29,15 @@
 #include <termios.h>
 #include <vector>
 
-#include "eigen3/Eigen/Dense"
-#include "eigen3/Eigen/Geometry"
-#include "amrl_msgs/Localization2DMsg.h"
-#include "amrl_msgs/VisualizationMsg.h"
 #include "gflags/gflags.h"
-#include "geometry_msgs/PoseArray.h"
-#include "sensor_msgs/LaserScan.h"
-#include "nav_msgs/Odometry.h"
 #include "ros/ros.h"
-#include "rosbag/bag.h"
-#include "rosbag/view.h"
-#include "ros/package.h"
 
-#include "config_reader/config_reader.h"
-#include "shared/math/math_util.h"
-#include "shared/math/line2d.h"
+#include "shared/ros/metrics_publisher.h"
 #include "shared/util/timer.h"
+#include "shared/util/thread_pool.h"
+#include "shared/util/trace.h"
 
-#include "particle_filter.h"
-#include "vector_map/vector_map.h"
-#include "visualization/visualization.h"
-
-using amrl_msgs::VisualizationMsg;
-using geometry::line2f;
-using geometry::Line;
-using math_util::DegToRad;
-using math_util::RadToDeg;
-using ros::Time;
-using std::string;
-using std::vector;
-using Eigen::Vector2f;
-using visualization::ClearVisualizationMsg;
-using visualization::DrawArc;
-using visualization::DrawPoint;
-using visualization::DrawLine;
-using visualization::DrawParticle;
+#include "particle_filter_node.h"
 
 // Create command line arguements
 DEFINE_string(laser_topic, "/scan", "Name of ROS topic for LIDAR data");
@@ -72,164 +45,35 @@ DEFINE_string(odom_topic, "/odom", "Name of ROS topic for odometry data");
 DEFINE_string(init_topic,
               "/set_pose",
               "Name of ROS topic for initialization");
+DEFINE_string(loc_topic, "localization",
+              "Name of ROS topic to publish the localization on");
 DEFINE_string(map, "", "Map file to use");
+DEFINE_string(trace, "", "Write a Chrome trace of the node to this file at exit");
+DEFINE_int32(threads, 0,
+             "Worker threads for parallel loops, 0 for one less than the "
+             "number of cores");
+DEFINE_int32(thread_nice, 0, "Niceness of the worker threads");
+DEFINE_double(metrics_period, 1.0,
+              "Seconds between metrics updates on /diagnostics, 0 to disable");
+DEFINE_string(metrics_file, "",
+              "Also write metrics to this file in Prometheus text format");
 
 DECLARE_int32(v);
 
-// Create config reader entries
-CONFIG_STRING(map_name_, "map");
-CONFIG_FLOAT(init_x_, "init_x");
-CONFIG_FLOAT(init_y_, "init_y");
-CONFIG_FLOAT(init_r_, "init_r");
-config_reader::ConfigReader config_reader_({"config/particle_filter.lua"});
-
 bool run_ = true;
-particle_filter::ParticleFilter particle_filter_;
-ros::Publisher visualization_publisher_;
-ros::Publisher localization_publisher_;
-ros::Publisher laser_publisher_;
-VisualizationMsg vis_msg_;
-sensor_msgs::LaserScan last_laser_msg_;
-vector_map::VectorMap map_;
-vector<Vector2f> trajectory_points_;
-
-void InitializeMsgs() {
-  std_msgs::Header header;
-  header.frame_id = "map";
-  header.seq = 0;
-
-  vis_msg_ = visualization::NewVisualizationMessage("map", "particle_filter");
-}
-
-void PublishParticles() {
-  vector<particle_filter::Particle> particles;
-  particle_filter_.GetParticles(&particles);
-  for (const particle_filter::Particle& p : particles) {
-    DrawParticle(p.loc, p.angle, vis_msg_);
-  }
-}
-
-void PublishPredictedScan() {
-  const uint32_t kColor = 0x06990d;
-  Vector2f robot_loc(0, 0);
-  float robot_angle(0);
-  particle_filter_.GetLocation(&robot_loc, &robot_angle);
-  vector<Vector2f> predicted_scan;
-  particle_filter_.GetPredictedPointCloud(
-      robot_loc,
-      robot_angle,
-      last_laser_msg_.ranges.size(),
-      last_laser_msg_.range_min,
-      last_laser_msg_.range_max,
-      last_laser_msg_.angle_min,
-      last_laser_msg_.angle_max,
-      &predicted_scan);
-  for (const Vector2f& p : predicted_scan) {
-    DrawPoint(p, kColor, vis_msg_);
-  }
-}
-
-void PublishTrajectory() {
-  const uint32_t kColor = 0xadadad;
-  Vector2f robot_loc(0, 0);
-  float robot_angle(0);
-  particle_filter_.GetLocation(&robot_loc, &robot_angle);
-  static Vector2f last_loc_(0, 0);
-  if (!trajectory_points_.empty() &&
-      (last_loc_ - robot_loc).squaredNorm() > Sq(1.5)) {
-    trajectory_points_.clear();
-  }
-  if (trajectory_points_.empty() ||
-      (robot_loc - last_loc_).squaredNorm() > 0.25) {
-    trajectory_points_.push_back(robot_loc);
-    last_loc_ = robot_loc;
-  }
-  for (size_t i = 0; i + 1 < trajectory_points_.size(); ++i) {
-    DrawLine(trajectory_points_[i],
-             trajectory_points_[i + 1],
-             kColor,
-             vis_msg_);
-  }
-}
-
-void PublishVisualization() {
-  static double t_last = 0;
-  if (GetMonotonicTime() - t_last < 0.05) {
-    // Rate-limit visualization.
-    return;
-  }
-  t_last = GetMonotonicTime();
-  vis_msg_.header.stamp = ros::Time::now();
-  ClearVisualizationMsg(vis_msg_);
-
-  PublishParticles();
-  PublishPredictedScan();
-  PublishTrajectory();
-  visualization_publisher_.publish(vis_msg_);
-}
-
-void LaserCallback(const sensor_msgs::LaserScan& msg) {
-  if (FLAGS_v > 0) {
-    printf("Laser t=%f\n", msg.header.stamp.toSec());
-  }
-  last_laser_msg_ = msg;
-  particle_filter_.ObserveLaser(
-      msg.ranges,
-      msg.range_min,
-      msg.range_max,
-      msg.angle_min,
-      msg.angle_max);
-  PublishVisualization();
-}
-
-void OdometryCallback(const nav_msgs::Odometry& msg) {
-  if (FLAGS_v > 0) {
-    printf("Odometry t=%f\n", msg.header.stamp.toSec());
-  }
-  const Vector2f odom_loc(msg.pose.pose.position.x, msg.pose.pose.position.y);
-  const float odom_angle =
-      2.0 * atan2(msg.pose.pose.orientation.z, msg.pose.pose.orientation.w);
-  particle_filter_.ObserveOdometry(odom_loc, odom_angle);
-  Vector2f robot_loc(0, 0);
-  float robot_angle(0);
-  particle_filter_.GetLocation(&robot_loc, &robot_angle);
-  amrl_msgs::Localization2DMsg localization_msg;
-  localization_msg.pose.x = robot_loc.x();
-  localization_msg.pose.y = robot_loc.y();
-  localization_msg.pose.theta = robot_angle;
-  localization_publisher_.publish(localization_msg);
-  PublishVisualization();
-}
-
-void InitCallback(const amrl_msgs::Localization2DMsg& msg) {
-  const Vector2f init_loc(msg.pose.x, msg.pose.y);
-  const float init_angle = msg.pose.theta;
-  const string map = msg.map;
-  printf("Initialize: %s (%f,%f) %f\u00b0\n",
-         map.c_str(),
-         init_loc.x(),
-         init_loc.y(),
-         RadToDeg(init_angle));
-  particle_filter_.Initialize(map, init_loc, init_angle);
-  trajectory_points_.clear();
-}
 
 void ProcessLive(ros::NodeHandle* n) {
-  ros::Subscriber initial_pose_sub = n->subscribe(
-      FLAGS_init_topic.c_str(),
-      1,
-      InitCallback);
-  ros::Subscriber laser_sub = n->subscribe(
-      FLAGS_laser_topic.c_str(),
-      1,
-      LaserCallback);
-  ros::Subscriber odom_sub = n->subscribe(
-      FLAGS_odom_topic.c_str(),
-      1,
-      OdometryCallback);
+  particle_filter::ParticleFilterNode node(
+      n, FLAGS_laser_topic, FLAGS_odom_topic, FLAGS_init_topic,
+      FLAGS_loc_topic);
+  ros_helpers::MetricsPublisher metrics_publisher(
+      n, "particle_filter", FLAGS_metrics_period, FLAGS_metrics_file);
   while (ros::ok() && run_) {
     ros::spinOnce();
-    PublishVisualization();
+    metrics_publisher.Update();
+    if (FLAGS_v > 0) {
+      CumulativeFunctionTimer::PrintAllStatsEvery(5.0, stdout);
+    }
     Sleep(0.01);
   }
 }
@@ -246,19 +90,14 @@ void SignalHandler(int) {
 int main(int argc, char** argv) {
   google::ParseCommandLineFlags(&argc, &argv, false);
   signal(SIGINT, SignalHandler);
+  if (!FLAGS_trace.empty()) util::trace::Start(FLAGS_trace);
+  util::ThreadPool::Options pool_options;
+  pool_options.num_threads = FLAGS_threads;
+  pool_options.nice = FLAGS_thread_nice;
+  util::ThreadPool::ConfigureShared(pool_options);
   // Initialize ROS.
   ros::init(argc, argv, "particle_filter", ros::init_options::NoSigintHandler);
   ros::NodeHandle n;
-  InitializeMsgs();
-  map_ = vector_map::VectorMap(CONFIG_map_name_);
-
-  visualization_publisher_ =
-      n.advertise<VisualizationMsg>("visualization", 1);
-  localization_publisher_ =
-      n.advertise<amrl_msgs::Localization2DMsg>("localization", 1);
-  laser_publisher_ =
-      n.advertise<sensor_msgs::LaserScan>("scan", 1);
-
   ProcessLive(&n);
 
   return 0;
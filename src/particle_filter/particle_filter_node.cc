@@ -0,0 +1,204 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+\file    particle_filter_node.cc
+\brief   ROS interface of the particle filter
+\author  Joydeep Biswas, (C) 2019
+*/
+//========================================================================
+
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "amrl_msgs/Localization2DMsg.h"
+#include "amrl_msgs/VisualizationMsg.h"
+#include "gflags/gflags.h"
+#include "nav_msgs/Odometry.h"
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+
+#include "shared/math/math_util.h"
+#include "shared/util/timer.h"
+#include "shared/util/trace.h"
+
+#include "particle_filter_node.h"
+#include "visualization/visualization.h"
+#include "visualization/viz_channel.h"
+
+using amrl_msgs::Localization2DMsg;
+using amrl_msgs::VisualizationMsg;
+using math_util::RadToDeg;
+using math_util::Sq;
+using std::string;
+using std::vector;
+using Eigen::Vector2f;
+using visualization::DrawLineStrip;
+using visualization::DrawParticle;
+using visualization::DrawPoints;
+
+DECLARE_int32(v);
+
+namespace particle_filter {
+
+ParticleFilterNode::ParticleFilterNode(ros::NodeHandle* n,
+                                       const string& laser_topic,
+                                       const string& odom_topic,
+                                       const string& init_topic,
+                                       const string& loc_topic) :
+    vis_builder_("map", "particle_filter"),
+    last_trajectory_loc_(0, 0),
+    t_last_visualization_(0) {
+  visualization_publisher_ =
+      n->advertise<VisualizationMsg>("visualization", 1);
+  localization_publisher_ = n->advertise<Localization2DMsg>(loc_topic, 1);
+  init_sub_ = n->subscribe(
+      init_topic, 1, &ParticleFilterNode::InitCallback, this);
+  laser_sub_ = n->subscribe(
+      laser_topic, 1, &ParticleFilterNode::LaserCallback, this);
+  odom_sub_ = n->subscribe(
+      odom_topic, 1, &ParticleFilterNode::OdometryCallback, this);
+  // Keeps the visualization up to date while no messages arrive.
+  visualization_timer_ = n->createWallTimer(
+      ros::WallDuration(0.05),
+      &ParticleFilterNode::VisualizationTimerCallback,
+      this);
+}
+
+void ParticleFilterNode::PublishParticles() {
+  vector<Particle> particles;
+  particle_filter_.GetParticles(&particles);
+  for (const Particle& p : particles) {
+    DrawParticle(p.loc, p.angle, vis_builder_.Message());
+  }
+}
+
+void ParticleFilterNode::PublishPredictedScan() {
+  if (!last_laser_msg_) return;
+  const uint32_t kColor = 0x06990d;
+  Vector2f robot_loc(0, 0);
+  float robot_angle(0);
+  particle_filter_.GetLocation(&robot_loc, &robot_angle);
+  vector<Vector2f> predicted_scan;
+  particle_filter_.GetPredictedPointCloud(
+      robot_loc,
+      robot_angle,
+      last_laser_msg_->ranges.size(),
+      last_laser_msg_->range_min,
+      last_laser_msg_->range_max,
+      last_laser_msg_->angle_min,
+      last_laser_msg_->angle_max,
+      &predicted_scan);
+  DrawPoints(predicted_scan, kColor, vis_builder_.Message());
+}
+
+void ParticleFilterNode::PublishTrajectory() {
+  const uint32_t kColor = 0xadadad;
+  Vector2f robot_loc(0, 0);
+  float robot_angle(0);
+  particle_filter_.GetLocation(&robot_loc, &robot_angle);
+  if (!trajectory_points_.empty() &&
+      (last_trajectory_loc_ - robot_loc).squaredNorm() > Sq(1.5)) {
+    trajectory_points_.clear();
+  }
+  if (trajectory_points_.empty() ||
+      (robot_loc - last_trajectory_loc_).squaredNorm() > 0.25) {
+    trajectory_points_.push_back(robot_loc);
+    last_trajectory_loc_ = robot_loc;
+  }
+  DrawLineStrip(trajectory_points_, kColor, vis_builder_.Message());
+}
+
+void ParticleFilterNode::PublishVisualization() {
+  if (!visualization::kVisualizationEnabled) return;
+  TRACE_FUNCTION();
+  if (GetMonotonicTime() - t_last_visualization_ < 0.05) {
+    // Rate-limit visualization.
+    return;
+  }
+  t_last_visualization_ = GetMonotonicTime();
+  vis_builder_.Begin();
+
+  PublishParticles();
+  PublishPredictedScan();
+  PublishTrajectory();
+  vis_builder_.Finish();
+  visualization::PublishVisualizationMsg(visualization_publisher_,
+                                         vis_builder_.Message());
+}
+
+void ParticleFilterNode::LaserCallback(
+    const sensor_msgs::LaserScan::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  if (FLAGS_v > 0) {
+    printf("Laser t=%f\n", msg->header.stamp.toSec());
+  }
+  last_laser_msg_ = msg;
+  particle_filter_.ObserveLaser(
+      msg->ranges,
+      msg->range_min,
+      msg->range_max,
+      msg->angle_min,
+      msg->angle_max);
+  PublishVisualization();
+}
+
+void ParticleFilterNode::OdometryCallback(
+    const nav_msgs::Odometry::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  if (FLAGS_v > 0) {
+    printf("Odometry t=%f\n", msg->header.stamp.toSec());
+  }
+  const Vector2f odom_loc(msg->pose.pose.position.x,
+                          msg->pose.pose.position.y);
+  const float odom_angle =
+      2.0 * atan2(msg->pose.pose.orientation.z, msg->pose.pose.orientation.w);
+  particle_filter_.ObserveOdometry(odom_loc, odom_angle);
+  Vector2f robot_loc(0, 0);
+  float robot_angle(0);
+  particle_filter_.GetLocation(&robot_loc, &robot_angle);
+  // Subscribers in this process receive this very message, so it must not
+  // be reused once published.
+  Localization2DMsg::Ptr localization_msg(new Localization2DMsg());
+  localization_msg->pose.x = robot_loc.x();
+  localization_msg->pose.y = robot_loc.y();
+  localization_msg->pose.theta = robot_angle;
+  localization_publisher_.publish(localization_msg);
+  PublishVisualization();
+}
+
+void ParticleFilterNode::InitCallback(
+    const Localization2DMsg::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  const Vector2f init_loc(msg->pose.x, msg->pose.y);
+  const float init_angle = msg->pose.theta;
+  const string& map = msg->map;
+  printf("Initialize: %s (%f,%f) %f\u00b0\n",
+         map.c_str(),
+         init_loc.x(),
+         init_loc.y(),
+         RadToDeg(init_angle));
+  particle_filter_.Initialize(map, init_loc, init_angle);
+  trajectory_points_.clear();
+}
+
+void ParticleFilterNode::VisualizationTimerCallback(
+    const ros::WallTimerEvent&) {
+  PublishVisualization();
+}
+
+}  // namespace particle_filter
@@ -0,0 +1,80 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+\file    particle_filter_node.h
+\brief   ROS interface of the particle filter, used by the particle_filter
+         node and by the single-process robot node
+\author  Joydeep Biswas, (C) 2019
+*/
+//========================================================================
+
+#include <string>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "amrl_msgs/Localization2DMsg.h"
+#include "nav_msgs/Odometry.h"
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+
+#include "particle_filter.h"
+#include "visualization/visualization.h"
+
+#ifndef SRC_PARTICLE_FILTER_NODE_H_
+#define SRC_PARTICLE_FILTER_NODE_H_
+
+namespace particle_filter {
+
+class ParticleFilterNode {
+ public:
+  // Subscribes and advertises through @n, so the callbacks run on the
+  // callback queue of @n. Messages are received and published as shared
+  // pointers, so components in the same process hand them over without
+  // serializing or copying them.
+  ParticleFilterNode(ros::NodeHandle* n,
+                     const std::string& laser_topic,
+                     const std::string& odom_topic,
+                     const std::string& init_topic,
+                     const std::string& loc_topic);
+
+ private:
+  void LaserCallback(const sensor_msgs::LaserScan::ConstPtr& msg);
+  void OdometryCallback(const nav_msgs::Odometry::ConstPtr& msg);
+  void InitCallback(const amrl_msgs::Localization2DMsg::ConstPtr& msg);
+  void VisualizationTimerCallback(const ros::WallTimerEvent& event);
+
+  void PublishParticles();
+  void PublishPredictedScan();
+  void PublishTrajectory();
+  void PublishVisualization();
+
+  ParticleFilter particle_filter_;
+  ros::Publisher visualization_publisher_;
+  ros::Publisher localization_publisher_;
+  ros::Subscriber laser_sub_;
+  ros::Subscriber odom_sub_;
+  ros::Subscriber init_sub_;
+  ros::WallTimer visualization_timer_;
+  visualization::MessageBuilder vis_builder_;
+  // Shared with the other subscribers of the scan, never modified.
+  sensor_msgs::LaserScan::ConstPtr last_laser_msg_;
+  std::vector<Eigen::Vector2f> trajectory_points_;
+  Eigen::Vector2f last_trajectory_loc_;
+  double t_last_visualization_;
+};
+
+}  // namespace particle_filter
+
+#endif  // SRC_PARTICLE_FILTER_NODE_H_
@@ -0,0 +1,160 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+\file    robot_main.cc
+\brief   Runs localization, navigation and optionally SLAM as components of
+         a single process, in place of the particle_filter, navigation and
+         slam nodes.
+
+         Compared to separate nodes, each laser scan and odometry message is
+         deserialized once and shared by all components, the localization is
+         handed to navigation as a pointer instead of being serialized, and
+         the components share a single copy of each vector map and one
+         thread pool. Messages to and from other nodes are unchanged.
+\author  Joydeep Biswas, (C) 2019
+*/
+//========================================================================
+
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "ros/callback_queue.h"
+#include "ros/ros.h"
+#include "shared/ros/metrics_publisher.h"
+#include "shared/util/timer.h"
+#include "shared/util/thread_pool.h"
+#include "shared/util/trace.h"
+
+#include "navigation/navigation.h"
+#include "navigation/navigation_node.h"
+#include "particle_filter/particle_filter_node.h"
+#include "slam/slam_node.h"
+
+using navigation::Navigation;
+
+// Create command line arguments
+DEFINE_string(laser_topic, "/scan", "Name of ROS topic for LIDAR data");
+DEFINE_string(odom_topic, "/odom", "Name of ROS topic for odometry data");
+DEFINE_string(init_topic,
+              "/set_pose",
+              "Name of ROS topic for initialization");
+DEFINE_string(loc_topic, "localization",
+              "Name of ROS topic for the particle filter localization");
+DEFINE_bool(slam, false, "Also run SLAM");
+DEFINE_string(slam_loc_topic, "slam_localization",
+              "Name of ROS topic for the SLAM pose, which navigation ignores");
+DEFINE_string(map, "maps/GDC1.txt", "Name of vector map file");
+DEFINE_bool(track_humans, false, "Track humans reported by the leg detector");
+DEFINE_string(legs_topic,
+              "leg_tracker_measurements",
+              "Name of ROS topic for leg detector measurements");
+DEFINE_string(trace, "", "Write a Chrome trace of the node to this file at exit");
+DEFINE_int32(threads, 0,
+             "Worker threads for parallel loops, 0 for one less than the "
+             "number of cores");
+DEFINE_int32(thread_nice, 0, "Niceness of the worker threads");
+DEFINE_double(metrics_period, 1.0,
+              "Seconds between metrics updates on /diagnostics, 0 to disable");
+DEFINE_string(metrics_file, "",
+              "Also write metrics to this file in Prometheus text format");
+
+DECLARE_int32(v);
+
+bool run_ = true;
+
+void SignalHandler(int) {
+  if (!run_) {
+    printf("Force Exit.\n");
+    exit(0);
+  }
+  printf("Exiting.\n");
+  run_ = false;
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, false);
+  signal(SIGINT, SignalHandler);
+  if (!FLAGS_trace.empty()) util::trace::Start(FLAGS_trace);
+  util::ThreadPool::Options pool_options;
+  pool_options.num_threads = FLAGS_threads;
+  pool_options.nice = FLAGS_thread_nice;
+  util::ThreadPool::ConfigureShared(pool_options);
+  util::trace::SetThreadName("control");
+  // Initialize ROS.
+  ros::init(argc, argv, "robot", ros::init_options::NoSigintHandler);
+
+  // Every component has its own callback queue, served by its own spinner
+  // thread, so that a slow scan update of one does not hold up the others.
+  // Navigation uses the global queue.
+  ros::NodeHandle navigation_n;
+  ros::CallbackQueue localization_queue;
+  ros::NodeHandle localization_n;
+  localization_n.setCallbackQueue(&localization_queue);
+  ros::CallbackQueue slam_queue;
+  ros::NodeHandle slam_n;
+  slam_n.setCallbackQueue(&slam_queue);
+
+  particle_filter::ParticleFilterNode particle_filter(
+      &localization_n, FLAGS_laser_topic, FLAGS_odom_topic, FLAGS_init_topic,
+      FLAGS_loc_topic);
+  std::unique_ptr<slam::SlamNode> slam;
+  if (FLAGS_slam) {
+    slam.reset(new slam::SlamNode(
+        &slam_n, FLAGS_laser_topic, FLAGS_odom_topic, FLAGS_slam_loc_topic));
+  }
+  navigation::NavigationTopics topics;
+  topics.laser = FLAGS_laser_topic;
+  topics.odom = FLAGS_odom_topic;
+  topics.localization = FLAGS_loc_topic;
+  topics.goal = "/move_base_simple/goal";
+  if (FLAGS_track_humans) topics.legs = FLAGS_legs_topic;
+  navigation::NavigationNode navigation_node(&navigation_n, FLAGS_map, topics);
+  Navigation* navigation = navigation_node.navigation();
+
+  navigation->setLocalPlannerWeights(0,0,10);
+  navigation->StartPlannerThread();
+
+  ros::AsyncSpinner navigation_spinner(1);
+  ros::AsyncSpinner localization_spinner(1, &localization_queue);
+  ros::AsyncSpinner slam_spinner(1, &slam_queue);
+  navigation_spinner.start();
+  localization_spinner.start();
+  if (FLAGS_slam) slam_spinner.start();
+
+  // The metrics of all components are in the same registry.
+  ros_helpers::MetricsPublisher metrics_publisher(
+      &navigation_n, "robot", FLAGS_metrics_period, FLAGS_metrics_file);
+  RateLoop loop(20.0);
+  while (run_ && ros::ok()) {
+    navigation->setLoopTiming(loop.LastPeriod(), loop.Budget(), loop.Overrun(),
+                              loop.Jitter());
+    navigation->Run();
+    metrics_publisher.Update();
+    if (FLAGS_v > 0) {
+      navigation_node.PrintLatencyEstimate();
+      navigation_node.PrintLoopStats(loop);
+    }
+    loop.Sleep();
+  }
+  if (FLAGS_slam) slam_spinner.stop();
+  localization_spinner.stop();
+  navigation_spinner.stop();
+  loop.PrintStats(stdout, "robot");
+  return 0;
+}
@@ -616,6 +616,74 @@ T MinDistanceLineArc(const Eigen::Matrix<T, 2, 1>& l0,
   return min_distance;
 }
 
+// Radial clearance between a point and an arc: the distance from the point to
+// the circle if the point is in the sector swept by the arc, which goes from
+// a_angle_start to a_angle_end in the direction of rotation_sign, and
+// infinity otherwise.
+template <typename T>
+T ArcClearance(const Eigen::Matrix<T, 2, 1>& point,
+               const Eigen::Matrix<T, 2, 1>& a_center,
+               const T& a_radius,
+               const T a_angle_start,
+               const T a_angle_end,
+               const int rotation_sign) {
+  const Eigen::Matrix<T, 2, 1> dir = point - a_center;
+  const T angle = math_util::AngleMod(Angle<T>(dir));
+  if (!math_util::IsAngleBetween(angle,
+                                 math_util::AngleMod(a_angle_start),
+                                 math_util::AngleMod(a_angle_end),
+                                 rotation_sign)) {
+    return std::numeric_limits<T>::infinity();
+  }
+  return std::abs(dir.norm() - a_radius);
+}
+
+// Distance a car can travel forward along an arc of the given curvature
+// before it hits a point, with the car driving from the origin along +x.
+// The car is modelled by its sides at y = +/-half_width and its front at
+// x = front, with the rear axle at the origin. Returns infinity if the point
+// is not in the area swept by the car within half a turn.
+template <typename T>
+T FreePathLengthArc(const Eigen::Matrix<T, 2, 1>& point,
+                    const T curvature,
+                    const T half_width,
+                    const T front) {
+  if (curvature == T(0)) {
+    if (std::abs(point.y()) < half_width && point.x() >= front) {
+      return point.x() - front;
+    }
+    return std::numeric_limits<T>::infinity();
+  }
+  // Mirror right turns into left turns, with the center of the turn at
+  // (0, radius).
+  const T radius = std::abs(T(1) / curvature);
+  const Eigen::Matrix<T, 2, 1> p(point.x(),
+                                 (curvature > T(0)) ? point.y() : -point.y());
+  const Eigen::Matrix<T, 2, 1> center(0, radius);
+  const T r_point = (p - center).norm();
+  const T r_min = std::abs(radius - half_width);
+  const T r_corner = std::sqrt(Sq(front) + Sq(radius - half_width));
+  const T r_max = std::sqrt(Sq(front) + Sq(radius + half_width));
+  if (r_point <= r_min || r_point >= r_max) {
+    return std::numeric_limits<T>::infinity();
+  }
+  // Point of the car that hits the point first: on the inner side, or on the
+  // front.
+  Eigen::Matrix<T, 2, 1> contact;
+  if (r_point <= r_corner) {
+    contact = Eigen::Matrix<T, 2, 1>(
+        std::sqrt(std::max(T(0), Sq(r_point) - Sq(radius - half_width))),
+        half_width);
+  } else {
+    contact = Eigen::Matrix<T, 2, 1>(
+        front, radius - std::sqrt(std::max(T(0), Sq(r_point) - Sq(front))));
+  }
+  // Angle between the contact and the point, by the law of cosines.
+  const T cos_theta = T(1) - (p - contact).squaredNorm() / (T(2) * Sq(r_point));
+  const T theta = std::acos(std::max(T(-1), std::min(T(1), cos_theta)));
+  return theta * radius;
+}
+
 // Returns the scalar projection of vector1 onto vector2
 // vector2 must be nonzero
 template <typename T>
@@ -0,0 +1,377 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+//
+// Batch versions of the arc queries in geometry.h, over points and line
+// segments stored as structures of arrays. The kernels work on fixed-size
+// blocks of Eigen arrays, which Eigen compiles to SIMD instructions, and pad
+// the last block so that the results do not depend on the batch size.
+//
+// Example:
+// ==============================
+// geometry::PointArray<float> points;
+// for (const Vector2f& p : cloud) points.PushBack(p);
+// vector<float> free_path_lengths;
+// geometry::FreePathLengthsArc(points, curvature, half_width, front,
+//                              &free_path_lengths);
+// ==============================
+
+#ifndef SRC_MATH_GEOMETRY_BATCH_H_
+#define SRC_MATH_GEOMETRY_BATCH_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "math/geometry.h"
+
+namespace geometry {
+
+// Points with their x and y coordinates in separate arrays.
+template <typename T, typename Allocator = std::allocator<T>>
+struct PointArray {
+  explicit PointArray(const Allocator& allocator = Allocator()) :
+      x(allocator), y(allocator) {}
+
+  size_t Size() const { return x.size(); }
+  void Clear() {
+    x.clear();
+    y.clear();
+  }
+  void Reserve(size_t n) {
+    x.reserve(n);
+    y.reserve(n);
+  }
+  void PushBack(const Eigen::Matrix<T, 2, 1>& p) {
+    x.push_back(p.x());
+    y.push_back(p.y());
+  }
+  Eigen::Matrix<T, 2, 1> operator[](size_t i) const {
+    return Eigen::Matrix<T, 2, 1>(x[i], y[i]);
+  }
+
+  std::vector<T, Allocator> x;
+  std::vector<T, Allocator> y;
+};
+
+// Line segments from (x0, y0) to (x1, y1), with every coordinate in its own
+// array.
+template <typename T, typename Allocator = std::allocator<T>>
+struct SegmentArray {
+  explicit SegmentArray(const Allocator& allocator = Allocator()) :
+      x0(allocator), y0(allocator), x1(allocator), y1(allocator) {}
+
+  size_t Size() const { return x0.size(); }
+  void Clear() {
+    x0.clear();
+    y0.clear();
+    x1.clear();
+    y1.clear();
+  }
+  void Reserve(size_t n) {
+    x0.reserve(n);
+    y0.reserve(n);
+    x1.reserve(n);
+    y1.reserve(n);
+  }
+  void PushBack(const Eigen::Matrix<T, 2, 1>& p0,
+                const Eigen::Matrix<T, 2, 1>& p1) {
+    x0.push_back(p0.x());
+    y0.push_back(p0.y());
+    x1.push_back(p1.x());
+    y1.push_back(p1.y());
+  }
+
+  std::vector<T, Allocator> x0;
+  std::vector<T, Allocator> y0;
+  std::vector<T, Allocator> x1;
+  std::vector<T, Allocator> y1;
+};
+
+namespace batch_internal {
+
+// Number of elements processed at once: two SSE or one AVX register of
+// floats.
+static const int kBlockSize = 8;
+
+template <typename T>
+using Block = Eigen::Array<T, kBlockSize, 1>;
+
+template <typename T>
+using Mask = Eigen::Array<bool, kBlockSize, 1>;
+
+// Load @count <= kBlockSize elements starting at @data. The rest of the
+// block repeats the first element, so that it holds valid inputs.
+template <typename T>
+Block<T> Load(const T* data, size_t count) {
+  if (count == static_cast<size_t>(kBlockSize)) {
+    return Eigen::Map<const Block<T>>(data);
+  }
+  Block<T> block = Block<T>::Constant(data[0]);
+  for (size_t i = 1; i < count; ++i) block(i) = data[i];
+  return block;
+}
+
+template <typename T>
+void Store(const Block<T>& block, size_t count, T* data) {
+  if (count == static_cast<size_t>(kBlockSize)) {
+    Eigen::Map<Block<T>> out(data);
+    out = block;
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) data[i] = block(i);
+}
+
+// Monotonic stand-in for the angle of (x, y) in [0, 2pi), with values in
+// [0, 4), which needs no trigonometry.
+template <typename T>
+Block<T> PseudoAngle(const Block<T>& x, const Block<T>& y) {
+  const Block<T> norm =
+      (x.abs() + y.abs()).max(std::numeric_limits<T>::min());
+  const Block<T> ax = x.abs() / norm;
+  const Block<T> ay = y.abs() / norm;
+  return (y >= T(0)).select((x >= T(0)).select(ay, ax + T(1)),
+                            (x < T(0)).select(ay + T(2), ax + T(3)));
+}
+
+template <typename T>
+T PseudoAngle(T x, T y) {
+  return PseudoAngle<T>(Block<T>::Constant(x), Block<T>::Constant(y))(0);
+}
+
+// Arc in the form used by geometry.h, preprocessed for the sector test.
+template <typename T>
+struct Arc {
+  Arc(const Eigen::Matrix<T, 2, 1>& center,
+      T radius,
+      T angle_start,
+      T angle_end,
+      int rotation_sign) :
+      center(center),
+      radius(radius),
+      start(Heading(angle_start)),
+      end(Heading(angle_end)),
+      sign(static_cast<T>(rotation_sign)) {
+    if (rotation_sign == 0) {
+      sweep = T(-1);
+    } else if (math_util::AngleMod(angle_start) ==
+               math_util::AngleMod(angle_end)) {
+      // Like math_util::IsAngleBetween(), equal angles are a full circle.
+      sweep = T(4);
+    } else {
+      sweep = Relative(end.x(), end.y());
+    }
+  }
+
+  // Pseudo-angle of the direction (dx, dy) from the start of the arc, in
+  // the direction of rotation.
+  T Relative(T dx, T dy) const {
+    return PseudoAngle<T>(start.x() * dx + start.y() * dy,
+                          sign * (start.x() * dy - start.y() * dx));
+  }
+
+  // Whether the directions (dx, dy) from the center are in the sector.
+  Mask<T> InSector(const Block<T>& dx, const Block<T>& dy) const {
+    return PseudoAngle<T>(start.x() * dx + start.y() * dy,
+                          sign * (start.x() * dy - start.y() * dx)) <= sweep;
+  }
+
+  // Distance from the points (px, py), relative to the center, to the arc.
+  Block<T> Distance(const Block<T>& px, const Block<T>& py) const {
+    const Block<T> to_circle =
+        ((px.square() + py.square()).sqrt() - radius).abs();
+    const Block<T> to_start = ((px - radius * start.x()).square() +
+                               (py - radius * start.y()).square()).sqrt();
+    const Block<T> to_end = ((px - radius * end.x()).square() +
+                             (py - radius * end.y()).square()).sqrt();
+    return InSector(px, py).select(to_circle, to_start.min(to_end));
+  }
+
+  Eigen::Matrix<T, 2, 1> center;
+  T radius;
+  // Unit vectors towards the ends of the arc.
+  Eigen::Matrix<T, 2, 1> start;
+  Eigen::Matrix<T, 2, 1> end;
+  T sign;
+  // Pseudo-angle of the end of the arc from its start.
+  T sweep;
+};
+
+}  // namespace batch_internal
+
+// Batch ArcClearance(): the radial clearance of every point from the arc,
+// infinity for points outside the sector swept by the arc.
+template <typename T, typename Allocator, typename OutAllocator>
+void ArcClearances(const PointArray<T, Allocator>& points,
+                   const Eigen::Matrix<T, 2, 1>& a_center,
+                   const T& a_radius,
+                   const T a_angle_start,
+                   const T a_angle_end,
+                   const int rotation_sign,
+                   std::vector<T, OutAllocator>* clearances) {
+  using batch_internal::Block;
+  using batch_internal::Load;
+  const batch_internal::Arc<T> arc(
+      a_center, a_radius, a_angle_start, a_angle_end, rotation_sign);
+  const size_t n = points.Size();
+  clearances->resize(n);
+  for (size_t i = 0; i < n; i += batch_internal::kBlockSize) {
+    const size_t count =
+        std::min<size_t>(batch_internal::kBlockSize, n - i);
+    const Block<T> dx = Load(&points.x[i], count) - a_center.x();
+    const Block<T> dy = Load(&points.y[i], count) - a_center.y();
+    const Block<T> clearance =
+        arc.InSector(dx, dy).select(
+            ((dx.square() + dy.square()).sqrt() - a_radius).abs(),
+            Block<T>::Constant(std::numeric_limits<T>::infinity()));
+    batch_internal::Store(clearance, count, &(*clearances)[i]);
+  }
+}
+
+// Batch FreePathLengthArc(): the distance the car can travel along the arc
+// before hitting each point, infinity for points it does not hit.
+template <typename T, typename Allocator, typename OutAllocator>
+void FreePathLengthsArc(const PointArray<T, Allocator>& points,
+                        const T curvature,
+                        const T half_width,
+                        const T front,
+                        std::vector<T, OutAllocator>* free_path_lengths) {
+  using batch_internal::Block;
+  using batch_internal::Load;
+  using batch_internal::Mask;
+  const T kInf = std::numeric_limits<T>::infinity();
+  const size_t n = points.Size();
+  free_path_lengths->resize(n);
+  const T radius = (curvature == T(0)) ? T(0) : std::abs(T(1) / curvature);
+  const T mirror = (curvature > T(0)) ? T(1) : T(-1);
+  const T r_min = std::abs(radius - half_width);
+  const T r_corner_sq = Sq(front) + Sq(radius - half_width);
+  const T r_max_sq = Sq(front) + Sq(radius + half_width);
+  for (size_t i = 0; i < n; i += batch_internal::kBlockSize) {
+    const size_t count =
+        std::min<size_t>(batch_internal::kBlockSize, n - i);
+    const Block<T> x = Load(&points.x[i], count);
+    Block<T> fpl;
+    if (curvature == T(0)) {
+      const Block<T> y = Load(&points.y[i], count);
+      fpl = (y.abs() < half_width && x >= front).select(
+          x - front, Block<T>::Constant(kInf));
+    } else {
+      // Mirrored so that the turn is to the left, around (0, radius).
+      const Block<T> y = mirror * Load(&points.y[i], count);
+      const Block<T> r_sq = x.square() + (y - radius).square();
+      const Block<T> side_x =
+          (r_sq - Sq(radius - half_width)).max(T(0)).sqrt();
+      const Block<T> front_y = radius - (r_sq - Sq(front)).max(T(0)).sqrt();
+      const Mask<T> on_side = (r_sq <= r_corner_sq);
+      const Block<T> contact_x =
+          on_side.select(side_x, Block<T>::Constant(front));
+      const Block<T> contact_y =
+          on_side.select(Block<T>::Constant(half_width), front_y);
+      const Block<T> cos_theta =
+          T(1) - ((x - contact_x).square() + (y - contact_y).square()) /
+          (T(2) * r_sq);
+      const Block<T> theta = cos_theta.max(T(-1)).min(T(1)).acos();
+      fpl = (r_sq > Sq(r_min) && r_sq < r_max_sq).select(
+          theta * radius, Block<T>::Constant(kInf));
+    }
+    batch_internal::Store(fpl, count, &(*free_path_lengths)[i]);
+  }
+}
+
+// Minimum distance between every segment and an arc, which goes from
+// a_angle_start to a_angle_end in the direction of rotation_sign. Unlike
+// MinDistanceLineArc(), which measures from the projection of the center
+// onto the segment, this is the exact distance between the two curves.
+template <typename T, typename Allocator, typename OutAllocator>
+void MinDistancesLineArc(const SegmentArray<T, Allocator>& segments,
+                         const Eigen::Matrix<T, 2, 1>& a_center,
+                         const T& a_radius,
+                         const T a_angle_start,
+                         const T a_angle_end,
+                         const int rotation_sign,
+                         std::vector<T, OutAllocator>* distances) {
+  using batch_internal::Block;
+  using batch_internal::Load;
+  using batch_internal::Mask;
+  const batch_internal::Arc<T> arc(
+      a_center, a_radius, a_angle_start, a_angle_end, rotation_sign);
+  // Ends of the arc, relative to the center.
+  const Eigen::Matrix<T, 2, 1> e0 = a_radius * arc.start;
+  const Eigen::Matrix<T, 2, 1> e1 = a_radius * arc.end;
+  const size_t n = segments.Size();
+  distances->resize(n);
+  for (size_t i = 0; i < n; i += batch_internal::kBlockSize) {
+    const size_t count =
+        std::min<size_t>(batch_internal::kBlockSize, n - i);
+    // Segments from (ax, ay) along (vx, vy), relative to the center.
+    const Block<T> ax = Load(&segments.x0[i], count) - a_center.x();
+    const Block<T> ay = Load(&segments.y0[i], count) - a_center.y();
+    const Block<T> vx = Load(&segments.x1[i], count) - a_center.x() - ax;
+    const Block<T> vy = Load(&segments.y1[i], count) - a_center.y() - ay;
+    const Block<T> v_sq =
+        (vx.square() + vy.square()).max(std::numeric_limits<T>::min());
+
+    // The closest points are either at an end of one of the curves...
+    Block<T> distance = arc.Distance(ax, ay).min(arc.Distance(ax + vx,
+                                                              ay + vy));
+    for (const Eigen::Matrix<T, 2, 1>& e : {e0, e1}) {
+      const Block<T> t =
+          (((e.x() - ax) * vx + (e.y() - ay) * vy) / v_sq).max(T(0)).min(T(1));
+      distance = distance.min(((ax + t * vx - e.x()).square() +
+                               (ay + t * vy - e.y()).square()).sqrt());
+    }
+
+    // ...or on the line from the center perpendicular to the segment, at its
+    // foot on the segment...
+    const Block<T> t_foot = -(ax * vx + ay * vy) / v_sq;
+    const Block<T> fx = ax + t_foot * vx;
+    const Block<T> fy = ay + t_foot * vy;
+    const Block<T> f_norm = (fx.square() + fy.square()).sqrt();
+    // If the segment goes through the center, any direction perpendicular
+    // to the segment will do.
+    const Mask<T> f_degenerate =
+        (f_norm < std::numeric_limits<T>::epsilon());
+    const Block<T> v_norm = v_sq.sqrt();
+    const Block<T> nx = f_degenerate.select(-vy / v_norm, fx / f_norm);
+    const Block<T> ny = f_degenerate.select(vx / v_norm, fy / f_norm);
+    const Mask<T> foot_on_segment = (t_foot >= T(0) && t_foot <= T(1));
+    distance = (foot_on_segment && arc.InSector(nx, ny)).select(
+        distance.min((f_norm - a_radius).abs()), distance);
+    distance = (foot_on_segment && arc.InSector(-nx, -ny)).select(
+        distance.min(f_norm + a_radius), distance);
+
+    // ...unless they cross.
+    const Block<T> b = ax * vx + ay * vy;
+    const Block<T> c = ax.square() + ay.square() - Sq(a_radius);
+    const Block<T> discriminant = b.square() - v_sq * c;
+    const Mask<T> crosses_circle = (discriminant >= T(0));
+    const Block<T> root = discriminant.max(T(0)).sqrt();
+    for (const T side : {T(-1), T(1)}) {
+      const Block<T> t = (-b + side * root) / v_sq;
+      const Mask<T> crosses = (crosses_circle && t >= T(0) && t <= T(1) &&
+                               arc.InSector(ax + t * vx, ay + t * vy));
+      distance = crosses.select(Block<T>::Zero(), distance);
+    }
+    batch_internal::Store(distance, count, &(*distances)[i]);
+  }
+}
+
+}  // namespace geometry
+
+#endif  // SRC_MATH_GEOMETRY_BATCH_H_
@@ -20,7 +20,12 @@
 #ifndef SRC_MATH_STATISTICS_H_
 #define SRC_MATH_STATISTICS_H_
 
+#include <stdint.h>
+
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
 
 #include "math/math_util.h"
 
@@ -53,15 +58,310 @@ T ProbabilityDensityUniform(const T& sample, const T& min, const T& max) {
   }
 }
 
+// Returns the element at the given percentile of @c, in [0, 1], partially
+// reordering @c. Linear in the size of @c, and does not copy it.
+template <typename Container, typename PercentType>
+typename Container::value_type GetPercentileInPlace(
+    Container* c, const PercentType percentile) {
+  const size_t idx = std::min(
+      c->size() - 1,
+      static_cast<size_t>(static_cast<PercentType>(c->size()) * percentile));
+  std::nth_element(c->begin(), c->begin() + idx, c->end());
+  return (*c)[idx];
+}
+
 template <typename Container, typename Type, typename PercentType>
 Type GetPercentile(Container c, const PercentType percentile) {
-  std::sort(c.begin(), c.end());
-  const size_t idx =
-      static_cast<size_t>(static_cast<PercentType>(c.size()) * percentile);
-  const Type& val = c[idx];
-  return val;
+  return GetPercentileInPlace(&c, percentile);
 }
 
+// Estimates the given quantile, in [0, 1], of a histogram with the inclusive
+// upper @bounds of its buckets and the @cumulative counts of values up to
+// each bound, followed by the total count. Values are assumed to be spread
+// evenly within each bucket, and the first bucket to start at 0 if its bound
+// is positive. Quantiles in the overflow bucket return the last bound.
+// Returns NaN for an empty histogram.
+template <typename Bounds, typename CumulativeCounts>
+double HistogramQuantile(const Bounds& bounds,
+                         const CumulativeCounts& cumulative,
+                         const double quantile) {
+  const size_t num_bounds = bounds.size();
+  const double total = static_cast<double>(cumulative[num_bounds]);
+  if (!(total > 0)) return std::numeric_limits<double>::quiet_NaN();
+  const double rank = quantile * total;
+  size_t i = 0;
+  while (i < num_bounds && static_cast<double>(cumulative[i]) < rank) ++i;
+  if (i == num_bounds) return static_cast<double>(bounds[num_bounds - 1]);
+  const double upper = static_cast<double>(bounds[i]);
+  const double lower = (i > 0) ? static_cast<double>(bounds[i - 1]) :
+      std::min(0.0, upper);
+  const double below = (i > 0) ? static_cast<double>(cumulative[i - 1]) : 0.0;
+  const double in_bucket = static_cast<double>(cumulative[i]) - below;
+  if (!(in_bucket > 0)) return lower;
+  return lower + (upper - lower) * (rank - below) / in_bucket;
+}
+
+// Streaming mean, variance and range of a sequence of values, with Welford's
+// algorithm, which stays accurate when the variance is small compared to the
+// mean.
+template <typename T>
+class RunningStats {
+ public:
+  RunningStats() { Reset(); }
+
+  void Reset() {
+    count_ = 0;
+    mean_ = T(0);
+    m2_ = T(0);
+    min_ = std::numeric_limits<T>::infinity();
+    max_ = -std::numeric_limits<T>::infinity();
+  }
+
+  void Add(const T& value) {
+    ++count_;
+    const T delta = value - mean_;
+    mean_ += delta / static_cast<T>(count_);
+    m2_ += delta * (value - mean_);
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  // Combine with the statistics of another sequence, e.g. computed on
+  // another thread.
+  void Merge(const RunningStats& other) {
+    if (other.count_ == 0) return;
+    if (count_ == 0) {
+      *this = other;
+      return;
+    }
+    const T count = static_cast<T>(count_ + other.count_);
+    const T delta = other.mean_ - mean_;
+    mean_ += delta * static_cast<T>(other.count_) / count;
+    m2_ += other.m2_ + math_util::Sq(delta) * static_cast<T>(count_) *
+        static_cast<T>(other.count_) / count;
+    count_ += other.count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  uint64_t Count() const { return count_; }
+  T Mean() const { return mean_; }
+  // Sample variance, 0 for fewer than two values.
+  T Variance() const {
+    return (count_ > 1) ? m2_ / static_cast<T>(count_ - 1) : T(0);
+  }
+  T StdDev() const { return std::sqrt(Variance()); }
+  // Infinity and -infinity respectively until a value is added.
+  T Min() const { return min_; }
+  T Max() const { return max_; }
+
+ private:
+  uint64_t count_;
+  T mean_;
+  // Sum of the squared differences from the mean.
+  T m2_;
+  T min_;
+  T max_;
+};
+
+// Exponentially weighted moving mean and variance. Each new value has weight
+// @alpha, in (0, 1], so the statistics cover roughly the last 1 / @alpha
+// values.
+template <typename T>
+class ExponentialStats {
+ public:
+  explicit ExponentialStats(const T& alpha) :
+      alpha_(alpha), initialized_(false), mean_(0), variance_(0) {}
+
+  void Add(const T& value) {
+    if (!initialized_) {
+      mean_ = value;
+      variance_ = T(0);
+      initialized_ = true;
+      return;
+    }
+    const T delta = value - mean_;
+    const T increment = alpha_ * delta;
+    mean_ += increment;
+    variance_ = (T(1) - alpha_) * (variance_ + delta * increment);
+  }
+
+  bool Initialized() const { return initialized_; }
+  T Mean() const { return mean_; }
+  T Variance() const { return variance_; }
+  T StdDev() const { return std::sqrt(variance_); }
+
+ private:
+  T alpha_;
+  bool initialized_;
+  T mean_;
+  T variance_;
+};
+
+// Streaming estimate of a single quantile with the P-square algorithm (Jain
+// and Chlamtac, 1985), which tracks five markers whose heights are adjusted
+// with piecewise parabolic interpolation. Constant memory and time per value,
+// with no stored samples.
+template <typename T>
+class P2Quantile {
+ public:
+  // @quantile in [0, 1], e.g. 0.99 for the 99th percentile.
+  explicit P2Quantile(double quantile) : quantile_(quantile) { Reset(); }
+
+  void Reset() {
+    count_ = 0;
+    heights_.fill(T(0));
+    const double p = quantile_;
+    increments_ = {{0.0, p / 2, p, (1 + p) / 2, 1.0}};
+  }
+
+  void Add(const T& value) {
+    if (count_ < 5) {
+      heights_[count_++] = value;
+      if (count_ == 5) {
+        std::sort(heights_.begin(), heights_.end());
+        for (int i = 0; i < 5; ++i) {
+          positions_[i] = i;
+          desired_[i] = 4 * increments_[i];
+        }
+      }
+      return;
+    }
+    ++count_;
+
+    // Find the cell containing the value, extending the extreme markers.
+    int k;
+    if (value < heights_[0]) {
+      heights_[0] = value;
+      k = 0;
+    } else if (value >= heights_[4]) {
+      heights_[4] = value;
+      k = 3;
+    } else {
+      k = 0;
+      while (value >= heights_[k + 1]) ++k;
+    }
+    for (int i = k + 1; i < 5; ++i) ++positions_[i];
+    for (int i = 0; i < 5; ++i) desired_[i] += increments_[i];
+
+    // Move the middle markers towards their desired positions.
+    for (int i = 1; i < 4; ++i) {
+      const double d = desired_[i] - positions_[i];
+      if ((d >= 1 && positions_[i + 1] - positions_[i] > 1) ||
+          (d <= -1 && positions_[i - 1] - positions_[i] < -1)) {
+        const int step = (d > 0) ? 1 : -1;
+        const T parabolic = Parabolic(i, step);
+        if (heights_[i - 1] < parabolic && parabolic < heights_[i + 1]) {
+          heights_[i] = parabolic;
+        } else {
+          heights_[i] += static_cast<T>(step) *
+              (heights_[i + step] - heights_[i]) /
+              static_cast<T>(positions_[i + step] - positions_[i]);
+        }
+        positions_[i] += step;
+      }
+    }
+  }
+
+  uint64_t Count() const { return count_; }
+
+  // Current estimate. Exact for up to five values, NaN for none.
+  T Value() const {
+    if (count_ == 0) return std::numeric_limits<T>::quiet_NaN();
+    if (count_ < 5) {
+      std::array<T, 5> sorted = heights_;
+      std::sort(sorted.begin(), sorted.begin() + count_);
+      const size_t idx = std::min<size_t>(
+          count_ - 1, static_cast<size_t>(quantile_ * count_));
+      return sorted[idx];
+    }
+    return heights_[2];
+  }
+
+ private:
+  T Parabolic(int i, int step) const {
+    const double d = step;
+    const double n_prev = positions_[i - 1];
+    const double n = positions_[i];
+    const double n_next = positions_[i + 1];
+    return heights_[i] + static_cast<T>(
+        d / (n_next - n_prev) *
+        ((n - n_prev + d) * (heights_[i + 1] - heights_[i]) / (n_next - n) +
+         (n_next - n - d) * (heights_[i] - heights_[i - 1]) / (n - n_prev)));
+  }
+
+  double quantile_;
+  uint64_t count_;
+  // Marker heights, and their actual and desired positions, 0-based.
+  std::array<T, 5> heights_;
+  std::array<int64_t, 5> positions_;
+  std::array<double, 5> desired_;
+  std::array<double, 5> increments_;
+};
+
+// Histogram over fixed buckets in which older values fade out exponentially,
+// for quantiles of the recent distribution of a value. Each value added
+// scales the weight of all earlier values by @decay, so the histogram covers
+// roughly the last 1 / (1 - @decay) values. Updates take constant time: new
+// values get growing weights instead, and the weights are renormalized
+// before they overflow.
+template <typename T, size_t N>
+class DecayingHistogram {
+ public:
+  // @bounds are the inclusive upper bounds of the buckets, in increasing
+  // order. Values above the last bound go to an overflow bucket.
+  DecayingHistogram(const std::array<T, N>& bounds, double decay) :
+      bounds_(bounds), decay_(decay) {
+    Reset();
+  }
+
+  void Reset() {
+    weights_.fill(0.0);
+    total_ = 0.0;
+    weight_ = 1.0;
+  }
+
+  void Add(const T& value) {
+    const size_t bucket = static_cast<size_t>(
+        std::lower_bound(bounds_.begin(), bounds_.end(), value) -
+        bounds_.begin());
+    weight_ /= decay_;
+    weights_[bucket] += weight_;
+    total_ += weight_;
+    // Renormalize well before the weights overflow.
+    if (weight_ > 1e100) {
+      for (double& w : weights_) w /= weight_;
+      total_ /= weight_;
+      weight_ = 1.0;
+    }
+  }
+
+  // Estimated quantile, in [0, 1], of the recent values. NaN if empty.
+  double Quantile(double quantile) const {
+    std::array<double, N + 1> cumulative;
+    double sum = 0.0;
+    for (size_t i = 0; i <= N; ++i) {
+      sum += weights_[i];
+      cumulative[i] = sum;
+    }
+    return HistogramQuantile(bounds_, cumulative, quantile);
+  }
+
+  // Fraction of the recent values in each bucket, the overflow bucket last.
+  double BucketFraction(size_t bucket) const {
+    return (total_ > 0.0) ? weights_[bucket] / total_ : 0.0;
+  }
+
+ private:
+  const std::array<T, N> bounds_;
+  const double decay_;
+  // Weights of the buckets, relative to weight_, with the overflow last.
+  std::array<double, N + 1> weights_;
+  double total_;
+  // Weight of the latest value.
+  double weight_;
+};
+
 }  // namespace statistics
 
 #endif  // SRC_MATH_STATISTICS_H_
\ No newline at end of file
@@ -0,0 +1,116 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+// C++ headers.
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// C++ Library headers.
+#include "diagnostic_msgs/DiagnosticArray.h"
+#include "diagnostic_msgs/DiagnosticStatus.h"
+#include "diagnostic_msgs/KeyValue.h"
+#include "ros/ros.h"
+
+// Custom headers.
+#include "math/statistics.h"
+#include "util/metrics.h"
+#include "util/timer.h"
+
+#ifndef METRICS_PUBLISHER_H
+#define METRICS_PUBLISHER_H
+
+namespace ros_helpers {
+
+// Periodically publishes the process metrics as a single DiagnosticStatus on
+// /diagnostics, and optionally writes them to a file in the Prometheus text
+// format, e.g. for the node exporter's textfile collector. Call Update() from
+// any loop or callback; it does nothing until the period has elapsed.
+class MetricsPublisher {
+ public:
+  MetricsPublisher(ros::NodeHandle* n,
+                   const std::string& node_name,
+                   double period,
+                   const std::string& prometheus_file) :
+      period_(period),
+      prometheus_file_(prometheus_file),
+      t_last_(0) {
+    publisher_ = n->advertise<diagnostic_msgs::DiagnosticArray>(
+        "/diagnostics", 1);
+    status_.name = node_name;
+    status_.hardware_id = node_name;
+    status_.level = diagnostic_msgs::DiagnosticStatus::OK;
+    message_.status.resize(1);
+  }
+
+  void Update() {
+    if (period_ <= 0.0) return;
+    const double t_now = GetMonotonicTime();
+    if (t_now - t_last_ < period_) return;
+    t_last_ = t_now;
+    Publish();
+  }
+
+  void Publish() {
+    const std::vector<util::metrics::Sample> samples =
+        util::metrics::Collect();
+    status_.values.resize(samples.size());
+    char buffer[128];
+    for (size_t i = 0; i < samples.size(); ++i) {
+      const util::metrics::Sample& sample = samples[i];
+      diagnostic_msgs::KeyValue& value = status_.values[i];
+      value.key = sample.metric->Name();
+      if (sample.cumulative_counts.empty()) {
+        snprintf(buffer, sizeof(buffer), "%g", sample.value);
+      } else {
+        // Histograms are summarized by their mean and estimated quantiles.
+        const uint64_t count = sample.cumulative_counts.back();
+        const std::vector<double>& bounds =
+            static_cast<const util::metrics::Histogram*>(sample.metric)
+                ->Bounds();
+        snprintf(buffer, sizeof(buffer), "mean=%g p50=%g p99=%g count=%llu",
+                 (count > 0) ? sample.value / count : 0.0,
+                 statistics::HistogramQuantile(
+                     bounds, sample.cumulative_counts, 0.5),
+                 statistics::HistogramQuantile(
+                     bounds, sample.cumulative_counts, 0.99),
+                 static_cast<unsigned long long>(count));
+      }
+      value.value = buffer;
+    }
+    message_.header.stamp = ros::Time::now();
+    message_.status[0] = status_;
+    publisher_.publish(message_);
+
+    if (!prometheus_file_.empty() &&
+        !util::metrics::WritePrometheusFile(prometheus_file_)) {
+      ROS_WARN_THROTTLE(10.0, "Unable to write metrics to %s",
+                        prometheus_file_.c_str());
+    }
+  }
+
+ private:
+  const double period_;
+  const std::string prometheus_file_;
+  double t_last_;
+  ros::Publisher publisher_;
+  diagnostic_msgs::DiagnosticStatus status_;
+  diagnostic_msgs::DiagnosticArray message_;
+};
+
+}  // namespace ros_helpers
+
+#endif  // METRICS_PUBLISHER_H
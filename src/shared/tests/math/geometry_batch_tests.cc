@@ -0,0 +1,203 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "math/geometry.h"
+#include "math/geometry_batch.h"
+#include "math/math_util.h"
+
+using Eigen::Vector2f;
+using std::vector;
+
+namespace {
+
+const float kInf = std::numeric_limits<float>::infinity();
+
+// Batch sizes that are not multiples of the block size exercise the padded
+// last block.
+const size_t kNumPoints = 203;
+
+geometry::PointArray<float> RandomPoints(std::mt19937* rng, float range) {
+  std::uniform_real_distribution<float> coordinate(-range, range);
+  geometry::PointArray<float> points;
+  for (size_t i = 0; i < kNumPoints; ++i) {
+    points.PushBack(Vector2f(coordinate(*rng), coordinate(*rng)));
+  }
+  return points;
+}
+
+void ExpectNearOrBothInf(float expected, float actual) {
+  if (expected == kInf) {
+    EXPECT_EQ(kInf, actual);
+  } else {
+    EXPECT_NEAR(expected, actual, 1e-4);
+  }
+}
+
+// Distance between a segment and an arc, by sampling both densely.
+float SampledDistanceLineArc(const Vector2f& l0,
+                             const Vector2f& l1,
+                             const Vector2f& center,
+                             float radius,
+                             float angle_start,
+                             float sweep) {
+  const int kSamples = 2000;
+  float min_sq_distance = kInf;
+  for (int i = 0; i <= kSamples; ++i) {
+    const Vector2f a =
+        center + radius * geometry::Heading(angle_start + sweep * i / kSamples);
+    min_sq_distance = std::min(min_sq_distance,
+        (geometry::ProjectPointOntoLineSegment(a, l0, l1) - a).squaredNorm());
+  }
+  return std::sqrt(min_sq_distance);
+}
+
+}  // namespace
+
+TEST(ArcClearances, MatchesScalar) {
+  std::mt19937 rng(1);
+  const geometry::PointArray<float> points = RandomPoints(&rng, 5);
+  const Vector2f center(0.5, -1);
+  for (int rotation_sign : {-1, 1}) {
+    for (float angle_end : {-2.5f, 0.3f, 1.0f, 3.0f}) {
+      vector<float> clearances;
+      geometry::ArcClearances(
+          points, center, 2.0f, 1.0f, angle_end, rotation_sign, &clearances);
+      ASSERT_EQ(points.Size(), clearances.size());
+      for (size_t i = 0; i < points.Size(); ++i) {
+        ExpectNearOrBothInf(
+            geometry::ArcClearance(
+                points[i], center, 2.0f, 1.0f, angle_end, rotation_sign),
+            clearances[i]);
+      }
+    }
+  }
+}
+
+TEST(ArcClearances, OutsideSector) {
+  geometry::PointArray<float> points;
+  points.PushBack(Vector2f(3, 0));
+  points.PushBack(Vector2f(0, 3));
+  points.PushBack(Vector2f(-3, 0));
+  vector<float> clearances;
+  geometry::ArcClearances(points, Vector2f(0, 0), 2.0f, 0.0f,
+                          static_cast<float>(M_PI / 2), 1, &clearances);
+  EXPECT_NEAR(1, clearances[0], 1e-6);
+  EXPECT_NEAR(1, clearances[1], 1e-6);
+  EXPECT_EQ(kInf, clearances[2]);
+}
+
+TEST(FreePathLengthsArc, MatchesScalar) {
+  std::mt19937 rng(2);
+  const geometry::PointArray<float> points = RandomPoints(&rng, 4);
+  const float kHalfWidth = 0.2;
+  const float kFront = 0.45;
+  for (float curvature : {-2.0f, -0.5f, -0.001f, 0.0f, 0.001f, 0.5f, 2.0f}) {
+    vector<float> free_path_lengths;
+    geometry::FreePathLengthsArc(
+        points, curvature, kHalfWidth, kFront, &free_path_lengths);
+    ASSERT_EQ(points.Size(), free_path_lengths.size());
+    for (size_t i = 0; i < points.Size(); ++i) {
+      const float expected = geometry::FreePathLengthArc(
+          points[i], curvature, kHalfWidth, kFront);
+      if (expected == kInf) {
+        EXPECT_EQ(kInf, free_path_lengths[i]);
+      } else {
+        // The arc length of a small angle error grows with the radius.
+        EXPECT_NEAR(expected, free_path_lengths[i],
+                    1e-4 * std::max(1.0f, 1 / std::abs(curvature)));
+      }
+    }
+  }
+}
+
+TEST(FreePathLengthsArc, Straight) {
+  geometry::PointArray<float> points;
+  points.PushBack(Vector2f(2, 0.1));
+  points.PushBack(Vector2f(2, 0.3));
+  points.PushBack(Vector2f(-2, 0));
+  vector<float> free_path_lengths;
+  geometry::FreePathLengthsArc(points, 0.0f, 0.2f, 0.5f, &free_path_lengths);
+  EXPECT_FLOAT_EQ(1.5, free_path_lengths[0]);
+  EXPECT_EQ(kInf, free_path_lengths[1]);
+  EXPECT_EQ(kInf, free_path_lengths[2]);
+}
+
+TEST(FreePathLengthsArc, QuarterTurn) {
+  // A point on the turning circle of the front of the car, a quarter turn
+  // ahead of it.
+  const float kRadius = 2;
+  const float kFront = 0.5;
+  const float r_front = std::hypot(kFront, kRadius);
+  const float front_angle = std::atan2(kFront, kRadius);
+  const Vector2f center(0, kRadius);
+  const float angle = -M_PI / 2 + front_angle + M_PI / 2;
+  geometry::PointArray<float> points;
+  points.PushBack(center + r_front * geometry::Heading(angle));
+  vector<float> free_path_lengths;
+  geometry::FreePathLengthsArc(
+      points, 1 / kRadius, 0.2f, kFront, &free_path_lengths);
+  EXPECT_NEAR(M_PI / 2 * kRadius, free_path_lengths[0], 1e-4);
+}
+
+TEST(MinDistancesLineArc, MatchesSampling) {
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> coordinate(-4, 4);
+  geometry::SegmentArray<float> segments;
+  for (size_t i = 0; i < kNumPoints; ++i) {
+    segments.PushBack(Vector2f(coordinate(rng), coordinate(rng)),
+                      Vector2f(coordinate(rng), coordinate(rng)));
+  }
+  // Include a degenerate segment and one through the center.
+  segments.PushBack(Vector2f(1, 1), Vector2f(1, 1));
+  segments.PushBack(Vector2f(-3, 0), Vector2f(3, 0));
+  const Vector2f center(0, 0);
+  const float kRadius = 2;
+  for (int rotation_sign : {-1, 1}) {
+    const float angle_start = 0.5;
+    const float angle_end = 2.5;
+    const float sweep = (rotation_sign > 0) ? angle_end - angle_start :
+        angle_end - angle_start - 2 * M_PI;
+    vector<float> distances;
+    geometry::MinDistancesLineArc(segments, center, kRadius, angle_start,
+                                  angle_end, rotation_sign, &distances);
+    ASSERT_EQ(segments.Size(), distances.size());
+    for (size_t i = 0; i < segments.Size(); ++i) {
+      const Vector2f l0(segments.x0[i], segments.y0[i]);
+      const Vector2f l1(segments.x1[i], segments.y1[i]);
+      EXPECT_NEAR(SampledDistanceLineArc(
+                      l0, l1, center, kRadius, angle_start, sweep),
+                  distances[i], 1e-2) << "Segment " << i;
+    }
+  }
+}
+
+TEST(MinDistancesLineArc, Crossing) {
+  geometry::SegmentArray<float> segments;
+  // Crosses the arc.
+  segments.PushBack(Vector2f(0, 0), Vector2f(0, 3));
+  // Crosses the circle, but not the arc.
+  segments.PushBack(Vector2f(0, 0), Vector2f(0, -3));
+  vector<float> distances;
+  geometry::MinDistancesLineArc(segments, Vector2f(0, 0), 2.0f, 0.0f,
+                                static_cast<float>(M_PI), 1, &distances);
+  EXPECT_EQ(0, distances[0]);
+  EXPECT_NEAR(2, distances[1], 1e-6);
+}
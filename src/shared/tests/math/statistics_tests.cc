@@ -0,0 +1,134 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "math/statistics.h"
+
+using std::vector;
+
+TEST(GetPercentile, MatchesSorting) {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  vector<double> values(1001);
+  for (double& v : values) v = uniform(rng);
+  vector<double> sorted = values;
+  std::sort(sorted.begin(), sorted.end());
+  for (double p : {0.0, 0.1, 0.5, 0.99, 1.0}) {
+    const size_t idx = std::min<size_t>(sorted.size() - 1, sorted.size() * p);
+    EXPECT_EQ(sorted[idx],
+              (statistics::GetPercentile<vector<double>, double>(values, p)));
+    vector<double> copy = values;
+    EXPECT_EQ(sorted[idx], statistics::GetPercentileInPlace(&copy, p));
+  }
+}
+
+TEST(HistogramQuantile, Interpolates) {
+  const std::array<double, 3> bounds = {{1, 2, 4}};
+  // 10 values in (0, 1], 10 in (1, 2], none in (2, 4], 5 above 4.
+  const std::array<int, 4> cumulative = {{10, 20, 20, 25}};
+  EXPECT_DOUBLE_EQ(0.5, statistics::HistogramQuantile(bounds, cumulative, 0.2));
+  EXPECT_DOUBLE_EQ(1.5, statistics::HistogramQuantile(bounds, cumulative, 0.6));
+  EXPECT_DOUBLE_EQ(4, statistics::HistogramQuantile(bounds, cumulative, 0.99));
+  const std::array<int, 4> empty = {{0, 0, 0, 0}};
+  EXPECT_TRUE(std::isnan(statistics::HistogramQuantile(bounds, empty, 0.5)));
+}
+
+TEST(RunningStats, MatchesTwoPass) {
+  std::mt19937 rng(2);
+  // A large offset would lose precision with the naive sum of squares.
+  std::normal_distribution<double> normal(1e6, 2);
+  vector<double> values(1000);
+  for (double& v : values) v = normal(rng);
+  double mean = 0;
+  for (double v : values) mean += v;
+  mean /= values.size();
+  double variance = 0;
+  for (double v : values) variance += math_util::Sq(v - mean);
+  variance /= values.size() - 1;
+
+  statistics::RunningStats<double> stats;
+  statistics::RunningStats<double> first_half;
+  statistics::RunningStats<double> second_half;
+  for (size_t i = 0; i < values.size(); ++i) {
+    stats.Add(values[i]);
+    ((i < values.size() / 2) ? first_half : second_half).Add(values[i]);
+  }
+  EXPECT_EQ(values.size(), stats.Count());
+  EXPECT_NEAR(mean, stats.Mean(), 1e-6);
+  EXPECT_NEAR(variance, stats.Variance(), 1e-6);
+  EXPECT_EQ(*std::min_element(values.begin(), values.end()), stats.Min());
+  EXPECT_EQ(*std::max_element(values.begin(), values.end()), stats.Max());
+
+  first_half.Merge(second_half);
+  EXPECT_EQ(stats.Count(), first_half.Count());
+  EXPECT_NEAR(mean, first_half.Mean(), 1e-6);
+  EXPECT_NEAR(variance, first_half.Variance(), 1e-6);
+}
+
+TEST(ExponentialStats, TracksStep) {
+  statistics::ExponentialStats<double> stats(0.1);
+  EXPECT_FALSE(stats.Initialized());
+  for (int i = 0; i < 200; ++i) stats.Add(1);
+  EXPECT_DOUBLE_EQ(1, stats.Mean());
+  EXPECT_DOUBLE_EQ(0, stats.Variance());
+  for (int i = 0; i < 200; ++i) stats.Add(3);
+  EXPECT_NEAR(3, stats.Mean(), 1e-6);
+  EXPECT_NEAR(0, stats.StdDev(), 1e-3);
+}
+
+TEST(P2Quantile, MatchesSorting) {
+  std::mt19937 rng(3);
+  std::exponential_distribution<double> exponential(1);
+  for (double p : {0.5, 0.9, 0.99}) {
+    statistics::P2Quantile<double> quantile(p);
+    vector<double> values(20000);
+    for (double& v : values) {
+      v = exponential(rng);
+      quantile.Add(v);
+    }
+    const double expected =
+        statistics::GetPercentile<vector<double>, double>(values, p);
+    EXPECT_NEAR(expected, quantile.Value(), 0.03 * expected) << "p=" << p;
+  }
+}
+
+TEST(P2Quantile, FewValues) {
+  statistics::P2Quantile<float> median(0.5);
+  EXPECT_TRUE(std::isnan(median.Value()));
+  median.Add(3);
+  median.Add(1);
+  median.Add(2);
+  EXPECT_EQ(2, median.Value());
+}
+
+TEST(DecayingHistogram, ForgetsOldValues) {
+  const std::array<double, 4> bounds = {{1, 2, 3, 4}};
+  statistics::DecayingHistogram<double, 4> histogram(bounds, 0.9);
+  EXPECT_TRUE(std::isnan(histogram.Quantile(0.5)));
+  for (int i = 0; i < 100; ++i) histogram.Add(0.5);
+  EXPECT_NEAR(1, histogram.BucketFraction(0), 1e-9);
+  EXPECT_DOUBLE_EQ(0.5, histogram.Quantile(0.5));
+  // After many newer values, the old ones no longer matter. This also
+  // renormalizes the weights several times.
+  for (int i = 0; i < 10000; ++i) histogram.Add(3.5);
+  EXPECT_NEAR(1, histogram.BucketFraction(3), 1e-9);
+  EXPECT_NEAR(3.5, histogram.Quantile(0.5), 1e-6);
+}
@@ -0,0 +1,171 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "util/allocation_counter.h"
+#include "util/arena.h"
+#include "util/thread_pool.h"
+
+using util::AllocationCounter;
+using util::Arena;
+using util::ArenaAllocator;
+using util::ArenaVector;
+
+namespace {
+
+// One control cycle's worth of temporaries, with a nested scope per call.
+void RunCycle(Arena* arena, size_t num_calls, size_t call_size) {
+  Arena::Scope cycle(arena);
+  ArenaVector<float> persistent(ArenaAllocator<float>(cycle.arena()));
+  for (size_t i = 0; i < num_calls; ++i) {
+    Arena::Scope call(arena);
+    ArenaVector<double> scratch(call_size, 1.0,
+                                ArenaAllocator<double>(call.arena()));
+    persistent.push_back(static_cast<float>(scratch.size()));
+  }
+}
+
+TEST(Arena, AlignsAllocations) {
+  Arena arena(256);
+  Arena::Scope scope(&arena);
+  for (size_t alignment : {1, 2, 8, 16, 64, 1, 32}) {
+    const uintptr_t p =
+        reinterpret_cast<uintptr_t>(arena.Allocate(3, alignment));
+    EXPECT_EQ(0u, p % alignment);
+  }
+}
+
+TEST(Arena, NestedScopesRewind) {
+  Arena arena(1024);
+  Arena::Scope outer(&arena);
+  arena.Allocate(100, 8);
+  const size_t used_outer = arena.Used();
+  void* inner_first = nullptr;
+  {
+    Arena::Scope inner(&arena);
+    inner_first = arena.Allocate(200, 8);
+    {
+      Arena::Scope innermost(&arena);
+      arena.Allocate(300, 8);
+      EXPECT_LT(used_outer + 500, arena.Used() + 1);
+    }
+    EXPECT_GE(used_outer + 208, arena.Used());
+  }
+  EXPECT_EQ(used_outer, arena.Used());
+  // The inner scope's memory is handed out again.
+  EXPECT_EQ(inner_first, arena.Allocate(200, 8));
+}
+
+TEST(Arena, GrowsThenMergesIntoOneBlock) {
+  Arena arena(1024);
+  const size_t kNumAllocations = 20;
+  const size_t kSize = 1000;
+  const auto cycle = [&]() {
+    Arena::Scope scope(&arena);
+    for (size_t i = 0; i < kNumAllocations; ++i) arena.Allocate(kSize, 8);
+    EXPECT_LE(kNumAllocations * kSize, arena.Used());
+  };
+  // The first cycle needs far more than one block.
+  cycle();
+  const uint64_t first_cycle_blocks = arena.NumBlockAllocations();
+  EXPECT_GT(first_cycle_blocks, 2u);
+  // The outermost scope merged the blocks into one that fits the cycle.
+  EXPECT_EQ(0u, arena.Used());
+  const size_t capacity = arena.Capacity();
+  EXPECT_LE(kNumAllocations * kSize, capacity);
+
+  for (int i = 0; i < 5; ++i) cycle();
+  EXPECT_EQ(first_cycle_blocks, arena.NumBlockAllocations());
+  EXPECT_EQ(capacity, arena.Capacity());
+}
+
+TEST(AllocationCounter, CountsOperatorNew) {
+  // Called directly, since the compiler may elide new expressions.
+  AllocationCounter allocations;
+  void* one = ::operator new(sizeof(int));
+  void* many = ::operator new[](10 * sizeof(int));
+  ::operator delete(one);
+  ::operator delete[](many);
+  EXPECT_EQ(2u, allocations.Thread());
+  EXPECT_LE(2u, allocations.Total());
+
+  // Other threads' allocations only count towards the total. Starting the
+  // thread allocates on this one, so count only once it runs.
+  std::atomic<bool> go(false);
+  std::thread other([&go]() {
+    while (!go.load()) std::this_thread::yield();
+    ::operator delete(::operator new(sizeof(int)));
+  });
+  const AllocationCounter across_threads;
+  go = true;
+  other.join();
+  EXPECT_EQ(0u, across_threads.Thread());
+  EXPECT_LE(1u, across_threads.Total());
+}
+
+TEST(AllocationCounter, WarmArenaCycleDoesNotAllocate) {
+  Arena arena;
+  RunCycle(&arena, 10, 1000);
+  const AllocationCounter allocations;
+  for (int i = 0; i < 10; ++i) RunCycle(&arena, 10, 1000);
+  EXPECT_EQ(0u, allocations.Thread());
+}
+
+TEST(AllocationCounter, WarmParallelReduceDoesNotAllocate) {
+  util::ThreadPool::Options options;
+  options.num_threads = 3;
+  util::ThreadPool pool(options);
+  const size_t kGrain = 64;
+  std::vector<float> values(4096, 0.5f);
+  const auto sum_squares = [&](size_t begin, size_t end) {
+    Arena::Scope scope(&util::ThreadArena());
+    ArenaVector<float> squares(ArenaAllocator<float>(scope.arena()));
+    for (size_t i = begin; i < end; ++i) {
+      squares.push_back(values[i] * values[i]);
+    }
+    float sum = 0;
+    for (const float s : squares) sum += s;
+    return sum;
+  };
+  const auto reduce = [&]() {
+    return pool.ParallelReduce(0, values.size(), kGrain, 0.0f, sum_squares,
+                               [](float a, float b) { return a + b; });
+  };
+
+  // Each chunk waits until every thread has one, so that all the workers
+  // have started and warmed up their arenas before counting.
+  const size_t num_threads = pool.NumThreads() + 1;
+  std::atomic<size_t> arrived(0);
+  pool.ParallelFor(0, num_threads, 1, [&](size_t, size_t) {
+    sum_squares(0, kGrain);
+    ++arrived;
+    while (arrived.load() < num_threads) std::this_thread::yield();
+  });
+  // And the task queues.
+  for (int i = 0; i < 10; ++i) ASSERT_EQ(1024.0f, reduce());
+
+  // Counts the workers too, since nothing else runs in the test.
+  const AllocationCounter allocations;
+  for (int i = 0; i < 50; ++i) ASSERT_EQ(1024.0f, reduce());
+  EXPECT_EQ(0u, allocations.Total());
+}
+
+}  // namespace
@@ -0,0 +1,130 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "util/pthread_utils.h"
+
+using std::shared_ptr;
+using std::vector;
+
+namespace {
+
+const int kNumReaders = 3;
+const uint64_t kNumWrites = 20000;
+
+// Large enough to span several words, so that a torn read mixes versions.
+struct Versioned {
+  uint64_t words[7];
+  float tail;
+};
+
+Versioned MakeVersioned(uint64_t version) {
+  Versioned value;
+  for (uint64_t& word : value.words) word = version;
+  value.tail = static_cast<float>(version);
+  return value;
+}
+
+// Counts live instances, to tell when old versions are freed.
+struct Tracked {
+  explicit Tracked(int version = 0) : version(version) { ++live; }
+  Tracked(const Tracked& other) : version(other.version) { ++live; }
+  ~Tracked() { --live; }
+  int version;
+  static std::atomic<int> live;
+};
+std::atomic<int> Tracked::live(0);
+
+TEST(SeqLockThreadSafe, ReadersNeverSeeTornValues) {
+  SeqLockThreadSafe<Versioned> value(MakeVersioned(0));
+  std::atomic<bool> done(false);
+  std::atomic<int> torn(0);
+  vector<std::thread> readers;
+  for (int r = 0; r < kNumReaders; ++r) {
+    readers.emplace_back([&]() {
+      uint64_t last = 0;
+      while (!done.load()) {
+        const Versioned v = value.Get();
+        bool consistent = (v.tail == static_cast<float>(v.words[0]));
+        for (const uint64_t word : v.words) {
+          consistent = consistent && (word == v.words[0]);
+        }
+        // Versions are only ever published in increasing order.
+        if (!consistent || v.words[0] < last) ++torn;
+        last = v.words[0];
+      }
+    });
+  }
+  for (uint64_t i = 1; i <= kNumWrites; ++i) value.Set(MakeVersioned(i));
+  done = true;
+  for (std::thread& reader : readers) reader.join();
+  EXPECT_EQ(0, torn.load());
+  EXPECT_EQ(kNumWrites, value.Get().words[6]);
+}
+
+TEST(RcuThreadSafe, ReadersKeepTheirVersion) {
+  {
+    RcuThreadSafe<Tracked> value(Tracked(1));
+    const shared_ptr<const Tracked> old_version = value.Get();
+    value.Set(Tracked(2));
+    value.Update([](Tracked* t) { t->version *= 10; });
+    // The old version is unchanged and alive while the reader holds it.
+    EXPECT_EQ(1, old_version->version);
+    EXPECT_EQ(20, value.Get()->version);
+    EXPECT_EQ(2, Tracked::live.load());
+  }
+  EXPECT_EQ(0, Tracked::live.load());
+}
+
+TEST(RcuThreadSafe, ConcurrentReadersAndWriter) {
+  RcuThreadSafe<vector<int>> value(vector<int>(100, 0));
+  std::atomic<bool> done(false);
+  std::atomic<int> errors(0);
+  vector<std::thread> readers;
+  for (int r = 0; r < kNumReaders; ++r) {
+    readers.emplace_back([&]() {
+      while (!done.load()) {
+        const shared_ptr<const vector<int>> version = value.Get();
+        const int first = version->front();
+        // Writers must not modify a published version under the reader.
+        for (int repeat = 0; repeat < 3; ++repeat) {
+          for (const int x : *version) {
+            if (x != first) ++errors;
+          }
+        }
+      }
+    });
+  }
+  for (int i = 1; i <= 2000; ++i) {
+    if (i % 2 == 0) {
+      value.Set(vector<int>(100, i));
+    } else {
+      value.Update([i](vector<int>* v) {
+        for (int& x : *v) x = i;
+      });
+    }
+  }
+  done = true;
+  for (std::thread& reader : readers) reader.join();
+  EXPECT_EQ(0, errors.load());
+  EXPECT_EQ(2000, value.Get()->back());
+}
+
+}  // namespace
@@ -0,0 +1,113 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "math/statistics.h"
+#include "util/random.h"
+
+using std::vector;
+
+namespace {
+
+// Sizes that are not multiples of the lane or block counts exercise the
+// partial last blocks.
+const size_t kNumValues = 100003;
+
+template <typename T>
+void ExpectUniform(const vector<T>& values, T a, T b) {
+  statistics::RunningStats<double> stats;
+  for (const T v : values) {
+    ASSERT_LE(a, v);
+    ASSERT_GT(b, v);
+    stats.Add(v);
+  }
+  EXPECT_NEAR((a + b) / 2, stats.Mean(), 0.01 * (b - a));
+  EXPECT_NEAR((b - a) / std::sqrt(12.0), stats.StdDev(), 0.01 * (b - a));
+}
+
+template <typename T>
+void ExpectGaussian(const vector<T>& values, T mean, T stddev) {
+  statistics::RunningStats<double> stats;
+  size_t outside_two_sigma = 0;
+  for (const T v : values) {
+    ASSERT_TRUE(std::isfinite(v));
+    stats.Add(v);
+    if (std::abs(v - mean) > 2 * stddev) ++outside_two_sigma;
+  }
+  EXPECT_NEAR(mean, stats.Mean(), 0.02 * stddev);
+  EXPECT_NEAR(stddev, stats.StdDev(), 0.02 * stddev);
+  EXPECT_NEAR(0.0455,
+              static_cast<double>(outside_two_sigma) / values.size(), 0.003);
+}
+
+}  // namespace
+
+TEST(Random, Deterministic) {
+  util_random::Random a(7);
+  util_random::Random b(7);
+  vector<double> bulk_a(37);
+  vector<double> bulk_b(37);
+  a.FillGaussian(0.0, 1.0, bulk_a.size(), bulk_a.data());
+  b.FillGaussian(0.0, 1.0, bulk_b.size(), bulk_b.data());
+  EXPECT_EQ(bulk_a, bulk_b);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(a.UniformRandom(), b.UniformRandom());
+    EXPECT_EQ(a.Gaussian(0, 1), b.Gaussian(0, 1));
+  }
+}
+
+TEST(Random, StreamsDiffer) {
+  util_random::Random a(7, 0);
+  util_random::Random b(7, 1);
+  util_random::Random c(8, 0);
+  const double x = a.UniformRandom();
+  EXPECT_NE(x, b.UniformRandom());
+  EXPECT_NE(x, c.UniformRandom());
+}
+
+TEST(Random, UniformRandom) {
+  util_random::Random rng;
+  vector<double> values(kNumValues);
+  for (double& v : values) v = rng.UniformRandom(-2, 3);
+  ExpectUniform(values, -2.0, 3.0);
+  for (int i = 0; i < 1000; ++i) {
+    const int v = rng.RandomInt(-3, 3);
+    ASSERT_LE(-3, v);
+    ASSERT_GE(3, v);
+  }
+}
+
+TEST(Random, FillUniform) {
+  util_random::Random rng(3);
+  vector<double> values(kNumValues);
+  rng.FillUniform(-2.0, 3.0, values.size(), values.data());
+  ExpectUniform(values, -2.0, 3.0);
+  vector<float> float_values(kNumValues);
+  rng.FillUniform(1.0f, 1.5f, float_values.size(), float_values.data());
+  ExpectUniform(float_values, 1.0f, 1.5f);
+}
+
+TEST(Random, FillGaussian) {
+  util_random::Random rng(4);
+  vector<double> values(kNumValues);
+  rng.FillGaussian(1.0, 2.0, values.size(), values.data());
+  ExpectGaussian(values, 1.0, 2.0);
+  vector<float> float_values(kNumValues);
+  rng.FillGaussian(-1.0f, 0.5f, float_values.size(), float_values.data());
+  ExpectGaussian(float_values, -1.0f, 0.5f);
+}
@@ -0,0 +1,155 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "util/thread_pool.h"
+
+using std::vector;
+using util::ThreadPool;
+
+namespace {
+
+ThreadPool::Options PoolOptions(int num_threads) {
+  ThreadPool::Options options;
+  options.num_threads = num_threads;
+  options.name = "test";
+  return options;
+}
+
+// Every index of [0, n) must be visited exactly once.
+void ExpectEachOnce(const vector<std::atomic<int>>& visits) {
+  for (size_t i = 0; i < visits.size(); ++i) {
+    ASSERT_EQ(1, visits[i].load()) << "index " << i;
+  }
+}
+
+TEST(ThreadPool, SubmitAndWait) {
+  ThreadPool pool(PoolOptions(3));
+  vector<std::future<int>> futures;
+  for (int i = 0; i < 100; ++i) {
+    futures.push_back(pool.Submit([i]() { return i * i; }));
+  }
+  int sum = 0;
+  for (std::future<int>& future : futures) sum += pool.Wait(&future);
+  EXPECT_EQ(328350, sum);
+}
+
+TEST(ThreadPool, WaitOnWorker) {
+  // A single worker that waits on a task it queued must run it itself.
+  ThreadPool pool(PoolOptions(1));
+  std::future<int> outer = pool.Submit([&pool]() {
+    std::future<int> inner = pool.Submit([]() { return 2; });
+    return 1 + pool.Wait(&inner);
+  });
+  EXPECT_EQ(3, pool.Wait(&outer));
+}
+
+TEST(ThreadPool, ParallelForVisitsEachIndexOnce) {
+  ThreadPool pool(PoolOptions(3));
+  for (size_t grain : {1, 7, 1000, 5000}) {
+    vector<std::atomic<int>> visits(1000);
+    for (std::atomic<int>& v : visits) v = 0;
+    pool.ParallelFor(0, visits.size(), grain, [&](size_t begin, size_t end) {
+      ASSERT_LE(end - begin, grain);
+      for (size_t i = begin; i < end; ++i) ++visits[i];
+    });
+    ExpectEachOnce(visits);
+  }
+}
+
+TEST(ThreadPool, NestedParallelFor) {
+  ThreadPool pool(PoolOptions(3));
+  const size_t kOuter = 16;
+  const size_t kInner = 200;
+  vector<std::atomic<int>> visits(kOuter * kInner);
+  for (std::atomic<int>& v : visits) v = 0;
+  pool.ParallelFor(0, kOuter, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      pool.ParallelFor(0, kInner, 10, [&](size_t inner_begin,
+                                          size_t inner_end) {
+        for (size_t j = inner_begin; j < inner_end; ++j) {
+          ++visits[i * kInner + j];
+        }
+      });
+    }
+  });
+  ExpectEachOnce(visits);
+}
+
+TEST(ThreadPool, ConcurrentCallers) {
+  // Loops from several threads share the workers, and helpers of finished
+  // loops may still be queued while the next loops start.
+  ThreadPool pool(PoolOptions(2));
+  const size_t kCallers = 4;
+  const size_t kN = 500;
+  vector<vector<std::atomic<int>>> visits(kCallers);
+  vector<std::thread> callers;
+  for (size_t c = 0; c < kCallers; ++c) {
+    visits[c] = vector<std::atomic<int>>(kN);
+    for (std::atomic<int>& v : visits[c]) v = 0;
+    callers.emplace_back([&pool, &visits, c, kN]() {
+      for (int repeat = 0; repeat < 50; ++repeat) {
+        pool.ParallelFor(0, kN, 3, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) ++visits[c][i];
+        });
+      }
+    });
+  }
+  for (std::thread& caller : callers) caller.join();
+  for (size_t c = 0; c < kCallers; ++c) {
+    for (size_t i = 0; i < kN; ++i) ASSERT_EQ(50, visits[c][i].load());
+  }
+}
+
+TEST(ThreadPool, ParallelReduceIsDeterministic) {
+  // Terms of very different magnitudes, so that the float sum depends on
+  // the order of the additions.
+  vector<float> values(10007);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = (i % 3 == 0) ? 1e7f + i : 1.0f / (i + 1);
+  }
+  const size_t kGrain = 64;
+  const auto sum_chunk = [&](size_t begin, size_t end) {
+    float sum = 0;
+    for (size_t i = begin; i < end; ++i) sum += values[i];
+    return sum;
+  };
+  const auto add = [](float a, float b) { return a + b; };
+
+  // The chunk sums added in order, as a single thread would.
+  float expected = 0;
+  for (size_t i = 0; i < values.size(); i += kGrain) {
+    expected += sum_chunk(i, std::min(values.size(), i + kGrain));
+  }
+
+  for (int num_threads : {1, 3}) {
+    ThreadPool pool(PoolOptions(num_threads));
+    for (int repeat = 0; repeat < 20; ++repeat) {
+      const float sum = pool.ParallelReduce(0, values.size(), kGrain, 0.0f,
+                                            sum_chunk, add);
+      ASSERT_EQ(expected, sum) << num_threads << " threads";
+    }
+  }
+  EXPECT_EQ(0.0f, ThreadPool(PoolOptions(2)).ParallelReduce(
+      5, 5, 1, 0.0f, sum_chunk, add));
+}
+
+}  // namespace
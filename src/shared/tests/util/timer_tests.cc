@@ -0,0 +1,137 @@
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+// ========================================================================
+
+#include <gtest/gtest.h>
+
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "util/timer.h"
+
+using std::vector;
+
+namespace {
+
+typedef CumulativeFunctionTimer Timer;
+
+// Largest error of a bucket's value relative to the values it holds.
+const double kBucketError = 1.0 / 32.0;
+
+TEST(CumulativeFunctionTimer, BucketValueRoundTrip) {
+  const int num_buckets = Timer::kNumBuckets;
+  int last_index = -1;
+  for (uint64_t ns = 0; ns < (uint64_t(1) << 41); ns += 1 + ns / 100) {
+    const int index = Timer::BucketIndex(ns);
+    ASSERT_LE(last_index, index) << ns << " ns";
+    ASSERT_LT(index, num_buckets) << ns << " ns";
+    last_index = index;
+    const double value = Timer::BucketValue(index);
+    if (ns < 16) {
+      ASSERT_EQ(1.0E-9 * ns, value);
+    } else {
+      ASSERT_NEAR(1.0E-9 * ns, value, kBucketError * 1.0E-9 * ns)
+          << ns << " ns";
+    }
+  }
+  // Every bucket is reachable, and values past the range share the last one.
+  EXPECT_EQ(num_buckets - 1, last_index);
+  EXPECT_EQ(num_buckets - 1, Timer::BucketIndex(uint64_t(1) << 60));
+}
+
+TEST(CumulativeFunctionTimer, BucketBoundaries) {
+  for (int magnitude = 4; magnitude < 40; ++magnitude) {
+    const uint64_t power = uint64_t(1) << magnitude;
+    // A power of two starts a bucket.
+    EXPECT_EQ(Timer::BucketIndex(power - 1) + 1, Timer::BucketIndex(power));
+    EXPECT_LT(Timer::BucketValue(Timer::BucketIndex(power - 1)),
+              Timer::BucketValue(Timer::BucketIndex(power)));
+  }
+}
+
+TEST(CumulativeFunctionTimer, Percentiles) {
+  Timer timer("percentiles");
+  // 1 to 1000 microseconds, in shuffled order.
+  for (int i = 0; i < 1000; ++i) {
+    timer.Record(1.0E-6 * (1 + (i * 7919) % 1000));
+  }
+  const Timer::Stats stats = timer.GetStats();
+  EXPECT_EQ(1000u, stats.invocations);
+  EXPECT_NEAR(0.5005, stats.total, 1.0E-6);
+  EXPECT_NEAR(500.5E-6, stats.mean, 1.0E-9);
+  EXPECT_NEAR(1000.0E-6, stats.max, 1.0E-9);
+  EXPECT_NEAR(500.0E-6, stats.p50, kBucketError * 500.0E-6);
+  EXPECT_NEAR(900.0E-6, stats.p90, kBucketError * 900.0E-6);
+  EXPECT_NEAR(990.0E-6, stats.p99, kBucketError * 990.0E-6);
+  // Percentiles never exceed the largest value seen.
+  EXPECT_LE(stats.p99, stats.max);
+}
+
+TEST(CumulativeFunctionTimer, MergesShards) {
+  // More threads than shards, so that some shards are shared.
+  const int kNumThreads = 20;
+  const int kPerThread = 500;
+  Timer sharded("sharded");
+  Timer single("single");
+  vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&sharded, t]() {
+      for (int i = 0; i < kPerThread; ++i) {
+        sharded.Record(1.0E-6 * (1 + t * kPerThread + i));
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  for (int i = 0; i < kNumThreads * kPerThread; ++i) {
+    single.Record(1.0E-6 * (1 + i));
+  }
+
+  const Timer::Stats merged = sharded.GetStats();
+  const Timer::Stats expected = single.GetStats();
+  EXPECT_EQ(expected.invocations, merged.invocations);
+  EXPECT_DOUBLE_EQ(expected.total, merged.total);
+  EXPECT_EQ(expected.max, merged.max);
+  EXPECT_EQ(expected.p50, merged.p50);
+  EXPECT_EQ(expected.p90, merged.p90);
+  EXPECT_EQ(expected.p99, merged.p99);
+}
+
+TEST(CumulativeFunctionTimer, NestedInvocationsSetParent) {
+  Timer outer("outer");
+  Timer inner("inner");
+  Timer other("other");
+  {
+    Timer::Invocation outer_invocation(&outer);
+    Timer::Invocation inner_invocation(&inner);
+  }
+  { Timer::Invocation other_invocation(&other); }
+  EXPECT_EQ(nullptr, outer.Parent());
+  EXPECT_EQ(&outer, inner.Parent());
+  EXPECT_EQ(nullptr, other.Parent());
+  // A stage keeps the parent it was first invoked under.
+  {
+    Timer::Invocation other_invocation(&other);
+    Timer::Invocation inner_invocation(&inner);
+  }
+  EXPECT_EQ(&outer, inner.Parent());
+  EXPECT_EQ(1u, outer.GetStats().invocations);
+  EXPECT_EQ(2u, inner.GetStats().invocations);
+}
+
+}  // namespace
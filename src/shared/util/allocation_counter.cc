@@ -0,0 +1,96 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+
+#include "util/allocation_counter.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+namespace {
+
+// Plain thread-local integers need no construction, so they are usable from
+// operator new at any point of a thread's life.
+thread_local uint64_t thread_allocations_ = 0;
+std::atomic<uint64_t> total_allocations_(0);
+
+void* CountedAllocate(size_t size) {
+  ++thread_allocations_;
+  total_allocations_.fetch_add(1, std::memory_order_relaxed);
+  if (size == 0) size = 1;
+  while (true) {
+    void* p = malloc(size);
+    if (p != nullptr) return p;
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void* CountedAllocateNoThrow(size_t size) noexcept {
+  try {
+    return CountedAllocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+}  // namespace
+
+namespace util {
+
+uint64_t ThreadAllocations() {
+  return thread_allocations_;
+}
+
+uint64_t TotalAllocations() {
+  return total_allocations_.load(std::memory_order_relaxed);
+}
+
+}  // namespace util
+
+void* operator new(size_t size) {
+  return CountedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+  return CountedAllocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return CountedAllocateNoThrow(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return CountedAllocateNoThrow(size);
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  free(p);
+}
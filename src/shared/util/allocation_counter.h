@@ -0,0 +1,62 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// Heap allocation counting, to check that hot paths do not allocate once
+// warmed up. The shared library replaces the global operator new, which then
+// counts every allocation of the program on top of the usual malloc(); the
+// count is a thread-local and a relaxed atomic increment. Direct calls to
+// malloc() are not counted.
+//
+// Example:
+// ==============================
+// util::AllocationCounter allocations;
+// UpdateParticles();
+// CHECK_EQ(allocations.Thread(), 0);
+// ==============================
+
+#include <stdint.h>
+
+#ifndef SRC_UTIL_ALLOCATION_COUNTER_H_
+#define SRC_UTIL_ALLOCATION_COUNTER_H_
+
+namespace util {
+
+// Number of operator new calls made by the calling thread so far.
+uint64_t ThreadAllocations();
+
+// Number of operator new calls made by all threads so far.
+uint64_t TotalAllocations();
+
+// Counts the allocations made since construction.
+class AllocationCounter {
+ public:
+  AllocationCounter() :
+      thread_start_(ThreadAllocations()), total_start_(TotalAllocations()) {}
+
+  // Allocations made by the constructing thread. Must be called from it.
+  uint64_t Thread() const { return ThreadAllocations() - thread_start_; }
+
+  // Allocations made by all threads, including work handed to other
+  // threads, but also any unrelated allocations of other threads.
+  uint64_t Total() const { return TotalAllocations() - total_start_; }
+
+ private:
+  const uint64_t thread_start_;
+  const uint64_t total_start_;
+};
+
+}  // namespace util
+
+#endif  // SRC_UTIL_ALLOCATION_COUNTER_H_
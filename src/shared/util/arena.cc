@@ -0,0 +1,112 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+
+#include "util/arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+#include <vector>
+
+namespace util {
+
+Arena::Arena(size_t block_size) :
+    block_(0), offset_(0), block_size_(block_size),
+    num_block_allocations_(0) {}
+
+Arena::~Arena() {
+  for (const Block& block : blocks_) free(block.data);
+}
+
+void Arena::AddBlock(size_t min_size) {
+  // Grow geometrically, so that a cycle needs only a few blocks the first
+  // time round.
+  const size_t size = std::max(min_size, std::max(block_size_, Capacity()));
+  Block block;
+  block.data = static_cast<char*>(malloc(size));
+  if (block.data == nullptr) throw std::bad_alloc();
+  block.size = size;
+  blocks_.push_back(block);
+  ++num_block_allocations_;
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+  while (true) {
+    if (block_ < blocks_.size()) {
+      const Block& block = blocks_[block_];
+      const uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+      const uintptr_t aligned =
+          (base + offset_ + alignment - 1) & ~(uintptr_t(alignment) - 1);
+      const size_t end = static_cast<size_t>(aligned - base) + size;
+      if (end <= block.size) {
+        offset_ = end;
+        return reinterpret_cast<void*>(aligned);
+      }
+      if (block_ + 1 < blocks_.size()) {
+        // Move on to the next block kept from an earlier cycle.
+        ++block_;
+        offset_ = 0;
+        continue;
+      }
+    }
+    AddBlock(size + alignment);
+    block_ = blocks_.size() - 1;
+    offset_ = 0;
+  }
+}
+
+void Arena::Reset() {
+  if (blocks_.size() > 1) {
+    const size_t capacity = Capacity();
+    for (const Block& block : blocks_) free(block.data);
+    blocks_.clear();
+    AddBlock(capacity);
+  }
+  block_ = 0;
+  offset_ = 0;
+}
+
+size_t Arena::Used() const {
+  size_t used = offset_;
+  for (size_t i = 0; i < block_ && i < blocks_.size(); ++i) {
+    used += blocks_[i].size;
+  }
+  return used;
+}
+
+size_t Arena::Capacity() const {
+  size_t capacity = 0;
+  for (const Block& block : blocks_) capacity += block.size;
+  return capacity;
+}
+
+Arena::Scope::Scope(Arena* arena) :
+    arena_(arena), block_(arena->block_), offset_(arena->offset_) {}
+
+Arena::Scope::~Scope() {
+  arena_->block_ = block_;
+  arena_->offset_ = offset_;
+  // The outermost scope merges the blocks, like Reset().
+  if (block_ == 0 && offset_ == 0) arena_->Reset();
+}
+
+Arena& ThreadArena() {
+  static thread_local Arena arena;
+  return arena;
+}
+
+}  // namespace util
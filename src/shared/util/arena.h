@@ -0,0 +1,147 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// Bump allocator for short-lived temporaries in hot loops. Allocating moves a
+// pointer forward, freeing is a no-op, and the whole arena is rewound at once
+// at the end of a callback or control cycle. Once the arena has grown to the
+// peak size of a cycle, it never touches the heap again.
+//
+// Example:
+// ==============================
+// void ObserveLaser(const vector<float>& ranges) {
+//   util::Arena::Scope scope(&util::ThreadArena());
+//   util::ArenaVector<Vector2f> cloud(util::ArenaAllocator<Vector2f>(
+//       scope.arena()));
+//   // ... Fill in and use cloud ...
+// }  // Everything allocated in the scope is released here.
+// ==============================
+// Containers using an arena must not outlive the scope they were created in.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#ifndef SRC_UTIL_ARENA_H_
+#define SRC_UTIL_ARENA_H_
+
+namespace util {
+
+class Arena {
+ public:
+  // The first block is allocated on first use, with at least @block_size
+  // bytes.
+  explicit Arena(size_t block_size = 64 * 1024);
+  ~Arena();
+
+  // Allocate @size bytes aligned to @alignment, which must be a power of two.
+  void* Allocate(size_t size, size_t alignment);
+
+  // Release everything allocated so far. If the arena had to grow past its
+  // first block, the blocks are merged into one, so that the next cycle fits
+  // in a single block.
+  void Reset();
+
+  // Bytes in use since the last Reset(), including padding and the unused
+  // ends of full blocks.
+  size_t Used() const;
+  // Bytes available without allocating another block.
+  size_t Capacity() const;
+  // Number of blocks allocated from the heap so far.
+  uint64_t NumBlockAllocations() const { return num_block_allocations_; }
+
+  // Rewinds the arena to where it was at construction on destruction.
+  // Scopes may be nested, e.g. one per function call within one per cycle.
+  class Scope {
+   public:
+    explicit Scope(Arena* arena);
+    ~Scope();
+    Arena* arena() const { return arena_; }
+
+   private:
+    // Disable copy constructor and assignment.
+    Scope(const Scope&);
+    void operator=(const Scope&);
+
+    Arena* const arena_;
+    const size_t block_;
+    const size_t offset_;
+  };
+
+ private:
+  // Disable copy constructor and assignment.
+  Arena(const Arena&);
+  void operator=(const Arena&);
+
+  struct Block {
+    char* data;
+    size_t size;
+  };
+
+  void AddBlock(size_t min_size);
+
+  std::vector<Block> blocks_;
+  // Current block and the offset of the first free byte in it.
+  size_t block_;
+  size_t offset_;
+  size_t block_size_;
+  uint64_t num_block_allocations_;
+};
+
+// Arena owned by the calling thread, for temporaries of code that may run on
+// any thread, e.g. on thread pool workers.
+Arena& ThreadArena();
+
+// STL allocator drawing from an Arena. Deallocation is a no-op; memory is
+// reclaimed when the arena is rewound.
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, size_t) {}
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+}  // namespace util
+
+#endif  // SRC_UTIL_ARENA_H_
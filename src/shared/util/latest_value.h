@@ -0,0 +1,82 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// Lock-free "latest value" slot for handing snapshots from one producer thread
+// to one consumer thread. Implemented as a triple buffer: the producer fills a
+// back buffer and publishes it, the consumer picks up the most recently
+// published buffer, and intermediate values are overwritten. Neither side ever
+// blocks or allocates, and buffers are reused so large values (point clouds)
+// keep their capacity across updates.
+
+#include <stdint.h>
+
+#include <atomic>
+
+#ifndef SRC_UTIL_LATEST_VALUE_H_
+#define SRC_UTIL_LATEST_VALUE_H_
+
+namespace util {
+
+template <typename T>
+class LatestValue {
+ public:
+  LatestValue() : middle_(1), back_(0), front_(2) {}
+
+  // Producer: the buffer to fill in before calling Publish().
+  T& Back() { return buffers_[back_]; }
+
+  // Producer: make the back buffer the latest value.
+  void Publish() {
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+        kIndexMask;
+  }
+
+  // Producer: copy @value into the back buffer and publish it.
+  void Set(const T& value) {
+    Back() = value;
+    Publish();
+  }
+
+  // Consumer: fetch the latest published value into Front(), if there is one
+  // that has not been fetched yet. Returns true iff Front() changed.
+  bool Update() {
+    if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  // Consumer: the most recently fetched value.
+  const T& Front() const { return buffers_[front_]; }
+
+ private:
+  // Disable copy constructor and assignment.
+  LatestValue(const LatestValue&);
+  void operator=(const LatestValue&);
+
+  static const uint8_t kIndexMask = 0x3;
+  static const uint8_t kFresh = 0x4;
+
+  T buffers_[3];
+  // Index of the published buffer, plus kFresh if the consumer has not seen it.
+  std::atomic<uint8_t> middle_;
+  // Buffer owned by the producer.
+  uint8_t back_;
+  // Buffer owned by the consumer.
+  uint8_t front_;
+};
+
+}  // namespace util
+
+#endif  // SRC_UTIL_LATEST_VALUE_H_
@@ -0,0 +1,200 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+
+#include "util/metrics.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace util {
+namespace metrics {
+
+namespace {
+
+struct MetricRegistry {
+  std::mutex mutex;
+  vector<const Metric*> metrics;
+};
+
+MetricRegistry& Registry() {
+  static MetricRegistry registry;
+  return registry;
+}
+
+uint64_t ToBits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double FromBits(uint64_t bits) {
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+const char* TypeName(Metric::Type type) {
+  switch (type) {
+    case Metric::kCounter: return "counter";
+    case Metric::kGauge: return "gauge";
+    case Metric::kHistogram: return "histogram";
+  }
+  return "untyped";
+}
+
+}  // namespace
+
+Metric::Metric(const char* name, const char* help, Type type) :
+    name_(name), help_(help), type_(type) {
+  MetricRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.metrics.push_back(this);
+}
+
+Metric::~Metric() {
+  MetricRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.metrics.erase(
+      std::remove(registry.metrics.begin(), registry.metrics.end(), this),
+      registry.metrics.end());
+}
+
+void Gauge::Set(double value) {
+  bits_.store(ToBits(value), std::memory_order_relaxed);
+}
+
+double Gauge::Value() const {
+  return FromBits(bits_.load(std::memory_order_relaxed));
+}
+
+Histogram::Histogram(const char* name, const char* help,
+                     const vector<double>& bounds) :
+    Metric(name, help, kHistogram),
+    bounds_(bounds),
+    counts_(bounds.size() + 1),
+    sum_bits_(ToBits(0.0)) {
+  for (std::atomic<uint64_t>& count : counts_) count.store(0);
+}
+
+void Histogram::Observe(double value) {
+  const size_t bucket =
+      std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+  counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+  uint64_t bits = sum_bits_.load(std::memory_order_relaxed);
+  while (!sum_bits_.compare_exchange_weak(bits, ToBits(FromBits(bits) + value),
+                                          std::memory_order_relaxed)) {}
+}
+
+vector<uint64_t> Histogram::BucketCounts() const {
+  vector<uint64_t> counts;
+  counts.reserve(counts_.size());
+  for (const std::atomic<uint64_t>& count : counts_) {
+    counts.push_back(count.load(std::memory_order_relaxed));
+  }
+  return counts;
+}
+
+uint64_t Histogram::Count() const {
+  uint64_t total = 0;
+  for (const std::atomic<uint64_t>& count : counts_) {
+    total += count.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+double Histogram::Sum() const {
+  return FromBits(sum_bits_.load(std::memory_order_relaxed));
+}
+
+vector<double> LatencyBounds() {
+  return {1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 0.01, 0.025, 0.05, 0.1,
+          0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+}
+
+vector<Sample> Collect() {
+  MetricRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  vector<Sample> samples(registry.metrics.size());
+  for (size_t i = 0; i < registry.metrics.size(); ++i) {
+    const Metric* metric = registry.metrics[i];
+    Sample& sample = samples[i];
+    sample.metric = metric;
+    switch (metric->GetType()) {
+      case Metric::kCounter: {
+        sample.value =
+            static_cast<double>(static_cast<const Counter*>(metric)->Value());
+      } break;
+      case Metric::kGauge: {
+        sample.value = static_cast<const Gauge*>(metric)->Value();
+      } break;
+      case Metric::kHistogram: {
+        const Histogram* histogram = static_cast<const Histogram*>(metric);
+        sample.value = histogram->Sum();
+        uint64_t cumulative = 0;
+        for (const uint64_t count : histogram->BucketCounts()) {
+          cumulative += count;
+          sample.cumulative_counts.push_back(cumulative);
+        }
+      } break;
+    }
+  }
+  return samples;
+}
+
+void WritePrometheus(FILE* stream) {
+  for (const Sample& sample : Collect()) {
+    const Metric& metric = *sample.metric;
+    fprintf(stream, "# HELP %s %s\n", metric.Name(), metric.Help());
+    fprintf(stream, "# TYPE %s %s\n", metric.Name(), TypeName(metric.GetType()));
+    if (metric.GetType() != Metric::kHistogram) {
+      fprintf(stream, "%s %.17g\n", metric.Name(), sample.value);
+      continue;
+    }
+    const vector<double>& bounds =
+        static_cast<const Histogram&>(metric).Bounds();
+    for (size_t i = 0; i < bounds.size(); ++i) {
+      fprintf(stream, "%s_bucket{le=\"%.15g\"} %" PRIu64 "\n",
+              metric.Name(), bounds[i], sample.cumulative_counts[i]);
+    }
+    const uint64_t count = sample.cumulative_counts.back();
+    fprintf(stream, "%s_bucket{le=\"+Inf\"} %" PRIu64 "\n", metric.Name(),
+            count);
+    fprintf(stream, "%s_sum %.17g\n", metric.Name(), sample.value);
+    fprintf(stream, "%s_count %" PRIu64 "\n", metric.Name(), count);
+  }
+}
+
+bool WritePrometheusFile(const string& file_name) {
+  const string temp_name = file_name + ".tmp";
+  FILE* file = fopen(temp_name.c_str(), "w");
+  if (file == nullptr) return false;
+  WritePrometheus(file);
+  const bool ok = (ferror(file) == 0);
+  if (fclose(file) != 0 || !ok) return false;
+  return rename(temp_name.c_str(), file_name.c_str()) == 0;
+}
+
+}  // namespace metrics
+}  // namespace util
@@ -0,0 +1,152 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// Process-wide performance metrics: counters, gauges and histograms. Updating
+// a metric is a relaxed atomic operation, so metrics can stay enabled on hot
+// paths and in production. Metrics register themselves on construction and
+// are normally declared as statics next to the code they measure:
+// ==============================
+// util::metrics::Counter scans_processed_(
+//     "scans_processed_total", "Laser scans processed");
+// void ObserveLaser() {
+//   scans_processed_.Increment();
+//   // ...
+// }
+// ==============================
+// Names should follow the Prometheus conventions, e.g. a "_total" suffix for
+// counters and base units (seconds) for durations.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#ifndef SRC_UTIL_METRICS_H_
+#define SRC_UTIL_METRICS_H_
+
+namespace util {
+namespace metrics {
+
+class Metric {
+ public:
+  enum Type {
+    kCounter,
+    kGauge,
+    kHistogram,
+  };
+
+  // Registers the metric. @name and @help must outlive the metric.
+  Metric(const char* name, const char* help, Type type);
+
+  // Unregisters the metric.
+  virtual ~Metric();
+
+  const char* Name() const { return name_; }
+  const char* Help() const { return help_; }
+  Type GetType() const { return type_; }
+
+ private:
+  // Disable copy constructor and assignment.
+  Metric(const Metric&);
+  void operator=(const Metric&);
+
+  const char* const name_;
+  const char* const help_;
+  const Type type_;
+};
+
+// Monotonically increasing count of events.
+class Counter : public Metric {
+ public:
+  Counter(const char* name, const char* help) :
+      Metric(name, help, kCounter), value_(0) {}
+
+  void Increment(uint64_t n = 1) {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  uint64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_;
+};
+
+// Value that can go up and down, such as a queue length.
+class Gauge : public Metric {
+ public:
+  Gauge(const char* name, const char* help) :
+      Metric(name, help, kGauge), bits_(0) {}
+
+  void Set(double value);
+  double Value() const;
+
+ private:
+  // Bit pattern of the double value.
+  std::atomic<uint64_t> bits_;
+};
+
+// Distribution of observed values over fixed buckets.
+class Histogram : public Metric {
+ public:
+  // @bounds are the inclusive upper bounds of the buckets, in increasing
+  // order. Values above the last bound go to an overflow bucket.
+  Histogram(const char* name, const char* help,
+            const std::vector<double>& bounds);
+
+  void Observe(double value);
+
+  const std::vector<double>& Bounds() const { return bounds_; }
+
+  // Number of observations in each bucket, the overflow bucket last. Not
+  // cumulative.
+  std::vector<uint64_t> BucketCounts() const;
+  uint64_t Count() const;
+  double Sum() const;
+
+ private:
+  const std::vector<double> bounds_;
+  std::vector<std::atomic<uint64_t>> counts_;
+  // Sum of all observations, as the bit pattern of a double.
+  std::atomic<uint64_t> sum_bits_;
+};
+
+// Bounds for latencies in seconds, from 100us to 10s.
+std::vector<double> LatencyBounds();
+
+// Point-in-time value of a metric, for exporters.
+struct Sample {
+  const Metric* metric;
+  // Counter or gauge value, or the histogram sum.
+  double value;
+  // Histograms only: cumulative counts per bound, then the total count.
+  std::vector<uint64_t> cumulative_counts;
+};
+
+// Values of all registered metrics, in registration order.
+std::vector<Sample> Collect();
+
+// Write the registered metrics in the Prometheus text exposition format.
+void WritePrometheus(FILE* stream);
+
+// Write the metrics to @file_name through a temporary file and a rename, so
+// that a scraper never reads a partial file. Returns false on failure.
+bool WritePrometheusFile(const std::string& file_name);
+
+}  // namespace metrics
+}  // namespace util
+
+#endif  // SRC_UTIL_METRICS_H_
@@ -22,6 +22,12 @@
 #include <assert.h>
 #include <glog/logging.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
 
 #ifndef SRC_UTIL_PTHREAD_UTILS_H_
 #define SRC_UTIL_PTHREAD_UTILS_H_
@@ -87,14 +93,14 @@ class ThreadSafe {
   // Set the value of the underlying type in a thread-safe manner.
   template <typename T_Other>
   void Set(const T_Other& rvalue) {
-    ScopedLock lock(mutex_);
+    ScopedLock lock(&mutex_);
     value_ = rvalue;
   }
 
   // Get a copy of the value of the underlying type in a thread-safe manner.
   T Get() const {
     T value;
-    ScopedLock lock(mutex_);
+    ScopedLock lock(&mutex_);
     value = value_;
     return (value);
   }
@@ -137,4 +143,139 @@ class ThreadSafe {
   mutable bool locked_;
 };
 
+// ThreadSafe variant for small, trivially copyable values that are read at a
+// high rate, such as poses. Readers copy the value without taking a lock, and
+// retry if a write overlapped the copy, so they never block writers. Writers
+// are serialized with each other.
+template <typename T>
+class SeqLockThreadSafe {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLockThreadSafe requires a trivially copyable type");
+
+ public:
+  SeqLockThreadSafe() : sequence_(0) {
+    const int init_error = pthread_mutex_init(&write_mutex_, NULL);
+    DCHECK_EQ(init_error, 0);
+    Store(T());
+  }
+
+  explicit SeqLockThreadSafe(const T& value) : sequence_(0) {
+    const int init_error = pthread_mutex_init(&write_mutex_, NULL);
+    DCHECK_EQ(init_error, 0);
+    Store(value);
+  }
+
+  ~SeqLockThreadSafe() {
+    pthread_mutex_destroy(&write_mutex_);
+  }
+
+  // Set the value. Readers see either the old or the new value, never a mix.
+  void Set(const T& value) {
+    ScopedLock lock(&write_mutex_);
+    const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    // An odd sequence number marks a write in progress.
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Store(value);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Get a consistent copy of the value.
+  T Get() const {
+    uint64_t words[kNumWords];
+    while (true) {
+      const uint64_t before = sequence_.load(std::memory_order_acquire);
+      if ((before & 1) != 0) continue;
+      for (size_t i = 0; i < kNumWords; ++i) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before) break;
+    }
+    T value;
+    memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+ private:
+  // Disable copy constructor and assignment.
+  SeqLockThreadSafe(const SeqLockThreadSafe<T>&);
+  void operator=(const SeqLockThreadSafe<T>&);
+
+  static const size_t kNumWords = (sizeof(T) + 7) / 8;
+
+  // The value is stored in atomic words, so that a reader racing a writer
+  // reads stale words rather than causing undefined behavior.
+  void Store(const T& value) {
+    uint64_t words[kNumWords] = {0};
+    memcpy(words, &value, sizeof(T));
+    for (size_t i = 0; i < kNumWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<uint64_t> sequence_;
+  std::atomic<uint64_t> words_[kNumWords];
+  pthread_mutex_t write_mutex_;
+};
+
+// ThreadSafe variant for large, read-mostly values, such as maps. Each value
+// is an immutable version: readers hold on to the version they got for as
+// long as they need it, and writers publish a new version rather than modify
+// the current one (read-copy-update). Readers never wait for writers, and
+// writers are serialized with each other.
+template <typename T>
+class RcuThreadSafe {
+ public:
+  RcuThreadSafe() : value_(std::make_shared<const T>()) {
+    const int init_error = pthread_mutex_init(&write_mutex_, NULL);
+    DCHECK_EQ(init_error, 0);
+  }
+
+  explicit RcuThreadSafe(const T& value) :
+      value_(std::make_shared<const T>(value)) {
+    const int init_error = pthread_mutex_init(&write_mutex_, NULL);
+    DCHECK_EQ(init_error, 0);
+  }
+
+  ~RcuThreadSafe() {
+    pthread_mutex_destroy(&write_mutex_);
+  }
+
+  // Get the current version. It does not change while the caller holds it.
+  std::shared_ptr<const T> Get() const {
+    return std::atomic_load(&value_);
+  }
+
+  // Publish @value as the new version.
+  void Set(const T& value) {
+    Set(std::make_shared<const T>(value));
+  }
+
+  void Set(std::shared_ptr<const T> value) {
+    ScopedLock lock(&write_mutex_);
+    std::atomic_store(&value_, std::move(value));
+  }
+
+  // Read-modify-write: call @update on a copy of the current version, and
+  // publish the copy. The old version is freed once its last reader lets go
+  // of it.
+  template <typename Function>
+  void Update(const Function& update) {
+    ScopedLock lock(&write_mutex_);
+    std::shared_ptr<T> copy = std::make_shared<T>(*std::atomic_load(&value_));
+    update(copy.get());
+    std::atomic_store(&value_, std::shared_ptr<const T>(std::move(copy)));
+  }
+
+ private:
+  // Disable copy constructor and assignment.
+  RcuThreadSafe(const RcuThreadSafe<T>&);
+  void operator=(const RcuThreadSafe<T>&);
+
+  // Accessed only through std::atomic_load and std::atomic_store.
+  std::shared_ptr<const T> value_;
+  pthread_mutex_t write_mutex_;
+};
+
 #endif  // SRC_UTIL_PTHREAD_UTILS_H_
@@ -19,6 +19,10 @@
 // If not, see <http://www.gnu.org/licenses/>.
 //========================================================================
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
 #include <random>
 
 #ifndef SRC_UTIL_RANDOM_H_
@@ -26,13 +30,66 @@
 
 // Your one-stop shop for generating random numbers.
 namespace util_random {
+
+// xoshiro256++ (Blackman and Vigna): a small, fast generator with a period of
+// 2^256 - 1 that passes BigCrush, unlike the linear congruential
+// std::default_random_engine. Satisfies UniformRandomBitGenerator, so it
+// also works with the std:: distributions.
+class Xoshiro256pp {
+ public:
+  typedef uint64_t result_type;
+
+  // Expands the seed into the 256-bit state with splitmix64, as recommended
+  // by the authors.
+  explicit Xoshiro256pp(uint64_t seed);
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()() {
+    const uint64_t result = Rotl(s_[0] + s_[3], 23) + s_[0];
+    const uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = Rotl(s_[3], 45);
+    return result;
+  }
+
+  // Advances the state by 2^128 draws. Successive jumps give up to 2^128
+  // non-overlapping subsequences of 2^128 draws each.
+  void Jump();
+
+  // Advances the state by 2^192 draws. Successive long jumps give up to 2^64
+  // starting points, each of which can be split further with Jump().
+  void LongJump();
+
+  static uint64_t Rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+ private:
+  friend class Random;
+
+  void Jump(const uint64_t (&polynomial)[4]);
+
+  uint64_t s_[4];
+};
+
 class Random {
  public:
-  Random() : randn_(0, 1.0), randf_(0.0, 1.0) {}
+  static const unsigned long kDefaultSeed = 1;
 
-  Random(unsigned long seed): generator_(seed),
-                              randn_(0, 1.0),
-                              randf_(0.0, 1.0) {}
+  Random() : Random(kDefaultSeed) {}
+
+  // Streams with the same seed but different indices are non-overlapping, so
+  // each thread can own a Random(seed, thread_index) and the results do not
+  // depend on scheduling.
+  Random(unsigned long seed, unsigned int stream = 0);
 
   // Generate random numbers between 0 and 1, inclusive.
   double UniformRandom();
@@ -50,10 +107,41 @@ class Random {
   // Return a random value drawn from a Normal distribution.
   double Gaussian(const double mean, const double stddev);
 
+  // Fill values[0..n) with uniform random numbers in [a, b). Much faster per
+  // value than repeated UniformRandom() calls: the bits come from kLanes
+  // interleaved generators, and the loops are simple enough to vectorize.
+  void FillUniform(double a, double b, size_t n, double* values);
+  void FillUniform(float a, float b, size_t n, float* values);
+
+  // Fill values[0..n) with draws from a Normal distribution, using the
+  // Box-Muller transform on blocks of uniform numbers. The float version
+  // computes in single precision, which caps the tails at about 5.7 sigma.
+  void FillGaussian(double mean, double stddev, size_t n, double* values);
+  void FillGaussian(float mean, float stddev, size_t n, float* values);
+
  private:
-  std::default_random_engine generator_;
+  static const int kLanes = 4;
+
+  // Draws one value from each lane.
+  void NextBlock(uint64_t (&bits)[kLanes]) {
+    for (int i = 0; i < kLanes; ++i) {
+      bits[i] = Xoshiro256pp::Rotl(lanes_[0][i] + lanes_[3][i], 23) +
+          lanes_[0][i];
+      const uint64_t t = lanes_[1][i] << 17;
+      lanes_[2][i] ^= lanes_[0][i];
+      lanes_[3][i] ^= lanes_[1][i];
+      lanes_[1][i] ^= lanes_[2][i];
+      lanes_[0][i] ^= lanes_[3][i];
+      lanes_[2][i] ^= t;
+      lanes_[3][i] = Xoshiro256pp::Rotl(lanes_[3][i], 45);
+    }
+  }
+
+  Xoshiro256pp generator_;
   std::normal_distribution<double> randn_;
-  std::uniform_real_distribution<double> randf_;
+  // State of the bulk generators, one column per lane so that NextBlock()
+  // updates all lanes with the same vector operations.
+  uint64_t lanes_[4][kLanes];
 };
 }  // namespace util_random
 #endif  // SRC_UTIL_RANDOM_H_
@@ -0,0 +1,87 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// Fixed-capacity circular buffer. Storage is allocated inline once, so
+// pushing and popping never touch the heap. This is not thread-safe.
+
+#include <stddef.h>
+
+#include <array>
+
+#ifndef SRC_UTIL_RING_BUFFER_H_
+#define SRC_UTIL_RING_BUFFER_H_
+
+namespace util {
+
+template <typename T, size_t N>
+class RingBuffer {
+  static_assert(N > 0, "RingBuffer capacity must be non-zero");
+
+ public:
+  RingBuffer() : head_(0), size_(0) {}
+
+  // Append an element at the back. If the buffer is full, the oldest element
+  // is overwritten and false is returned.
+  bool PushBack(const T& value) {
+    const bool had_room = (size_ < N);
+    data_[(head_ + size_) % N] = value;
+    if (had_room) {
+      ++size_;
+    } else {
+      head_ = (head_ + 1) % N;
+    }
+    return had_room;
+  }
+
+  // Drop the oldest element. Does nothing if the buffer is empty.
+  void PopFront() {
+    if (size_ == 0) return;
+    head_ = (head_ + 1) % N;
+    --size_;
+  }
+
+  // Drop the @n oldest elements.
+  void PopFront(size_t n) {
+    if (n > size_) n = size_;
+    head_ = (head_ + n) % N;
+    size_ -= n;
+  }
+
+  // Access the i'th oldest element, 0 being the front.
+  const T& operator[](size_t i) const { return data_[(head_ + i) % N]; }
+  T& operator[](size_t i) { return data_[(head_ + i) % N]; }
+
+  const T& Front() const { return (*this)[0]; }
+  const T& Back() const { return (*this)[size_ - 1]; }
+
+  size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+  bool Full() const { return size_ == N; }
+  static constexpr size_t Capacity() { return N; }
+
+  void Clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+ private:
+  std::array<T, N> data_;
+  size_t head_;
+  size_t size_;
+};
+
+}  // namespace util
+
+#endif  // SRC_UTIL_RING_BUFFER_H_
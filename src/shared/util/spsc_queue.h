@@ -0,0 +1,81 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// Lock-free bounded queue for passing values from exactly one producer thread
+// to exactly one consumer thread.
+
+#include <stddef.h>
+
+#include <array>
+#include <atomic>
+
+#ifndef SRC_UTIL_SPSC_QUEUE_H_
+#define SRC_UTIL_SPSC_QUEUE_H_
+
+namespace util {
+
+// N must be a power of two. Push() may only be called from the producer
+// thread, and Pop() only from the consumer thread.
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0,
+                "SpscQueue capacity must be a power of two");
+
+ public:
+  SpscQueue() : head_(0), tail_(0) {}
+
+  // Append a value. Returns false, leaving the queue unchanged, if it is full.
+  bool Push(const T& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == N) return false;
+    data_[tail & (N - 1)] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Remove the oldest value into @value. Returns false if the queue is empty.
+  bool Pop(T* value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    *value = data_[head & (N - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate number of queued values; exact only when both threads are idle.
+  size_t Size() const {
+    return tail_.load(std::memory_order_acquire) -
+        head_.load(std::memory_order_acquire);
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  static constexpr size_t Capacity() { return N; }
+
+ private:
+  // Disable copy constructor and assignment.
+  SpscQueue(const SpscQueue&);
+  void operator=(const SpscQueue&);
+
+  std::array<T, N> data_;
+  // Index of the next value to pop, written only by the consumer.
+  alignas(64) std::atomic<size_t> head_;
+  // Index of the next slot to push, written only by the producer.
+  alignas(64) std::atomic<size_t> tail_;
+};
+
+}  // namespace util
+
+#endif  // SRC_UTIL_SPSC_QUEUE_H_
@@ -0,0 +1,292 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+
+#include "util/thread_pool.h"
+
+#include <glog/logging.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/trace.h"
+
+using std::string;
+using std::vector;
+
+namespace util {
+
+namespace {
+
+// Pool and index of the worker running on this thread, if any.
+thread_local const ThreadPool* current_pool_ = nullptr;
+thread_local size_t current_worker_ = 0;
+
+std::mutex shared_options_mutex_;
+ThreadPool::Options shared_options_;
+
+}  // namespace
+
+ThreadPool::ThreadPool(const Options& options) :
+    pending_(0), stop_(false), next_queue_(0) {
+  int num_threads = options.num_threads;
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+  }
+  // Submitted tasks need at least one worker to run on.
+  num_threads = std::max(num_threads, 1);
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(new Worker());
+    workers_.back()->name = options.name + "_" + std::to_string(i);
+  }
+  // Start the workers once all queues exist, since they steal from each
+  // other.
+  for (int i = 0; i < num_threads; ++i) {
+    workers_[i]->thread =
+        std::thread(&ThreadPool::WorkerLoop, this, i, options);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+void ThreadPool::TaskQueue::PushBack(Task task, const void* owner) {
+  if (size_ == slots_.size()) {
+    // Grow, unwrapping the ring to start at index 0.
+    std::vector<Slot> slots(std::max<size_t>(2 * slots_.size(), 16));
+    for (size_t i = 0; i < size_; ++i) slots[i] = std::move(At(i));
+    slots_.swap(slots);
+    head_ = 0;
+  }
+  Slot& slot = At(size_);
+  slot.task = std::move(task);
+  slot.owner = owner;
+  ++size_;
+}
+
+ThreadPool::Task ThreadPool::TaskQueue::PopBack() {
+  --size_;
+  Slot& slot = At(size_);
+  Task task = std::move(slot.task);
+  slot.task = nullptr;
+  return task;
+}
+
+ThreadPool::Task ThreadPool::TaskQueue::PopFront() {
+  Slot& slot = At(0);
+  Task task = std::move(slot.task);
+  slot.task = nullptr;
+  head_ = (head_ + 1) % slots_.size();
+  --size_;
+  return task;
+}
+
+size_t ThreadPool::TaskQueue::RemoveOwned(const void* owner) {
+  size_t kept = 0;
+  for (size_t i = 0; i < size_; ++i) {
+    if (At(i).owner == owner) continue;
+    if (kept != i) At(kept) = std::move(At(i));
+    ++kept;
+  }
+  for (size_t i = kept; i < size_; ++i) At(i).task = nullptr;
+  const size_t removed = size_ - kept;
+  size_ = kept;
+  return removed;
+}
+
+void ThreadPool::Push(Task task, const void* owner) {
+  const size_t queue = (current_pool_ == this) ?
+      current_worker_ :
+      next_queue_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+  {
+    Worker& worker = *workers_[queue];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.PushBack(std::move(task), owner);
+  }
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::Pop(size_t self, Task* task) {
+  const size_t n = workers_.size();
+  if (self < n) {
+    Worker& worker = *workers_[self];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.tasks.Empty()) {
+      *task = worker.tasks.PopBack();
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  for (size_t k = 1; k <= n; ++k) {
+    const size_t victim = (self + k) % n;
+    if (victim == self) continue;
+    Worker& worker = *workers_[victim];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.tasks.Empty()) {
+      *task = worker.tasks.PopFront();
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t ThreadPool::Unqueue(const void* owner) {
+  size_t removed = 0;
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    removed += worker->tasks.RemoveOwned(owner);
+  }
+  pending_.fetch_sub(removed, std::memory_order_relaxed);
+  return removed;
+}
+
+bool ThreadPool::RunPendingTask() {
+  if (pending_.load(std::memory_order_relaxed) == 0) return false;
+  const size_t self = (current_pool_ == this) ? current_worker_ :
+      workers_.size();
+  Task task;
+  if (!Pop(self, &task)) return false;
+  task();
+  return true;
+}
+
+void ThreadPool::WorkerLoop(size_t index, const Options& options) {
+  current_pool_ = this;
+  current_worker_ = index;
+  Worker& worker = *workers_[index];
+  // Thread names are limited to 15 characters.
+  pthread_setname_np(pthread_self(), worker.name.substr(0, 15).c_str());
+  trace::SetThreadName(worker.name.c_str());
+  if (!options.cpus.empty()) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(options.cpus[index % options.cpus.size()], &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+      LOG(WARNING) << "Unable to pin " << worker.name << " to CPU "
+                   << options.cpus[index % options.cpus.size()];
+    }
+  }
+  if (options.nice != 0) {
+    // On Linux, the niceness of a thread is set through its thread ID.
+    const id_t tid = static_cast<id_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, tid, options.nice) != 0) {
+      LOG(WARNING) << "Unable to set the niceness of " << worker.name
+                   << " to " << options.nice;
+    }
+  }
+
+  Task task;
+  while (true) {
+    if (Pop(index, &task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_.wait(lock, [this]() {
+      return stop_ || pending_.load(std::memory_order_relaxed) > 0;
+    });
+    if (stop_ && pending_.load(std::memory_order_relaxed) == 0) return;
+  }
+}
+
+void ThreadPool::RunChunks(LoopState* loop) {
+  size_t c;
+  while ((c = loop->next_chunk.fetch_add(1, std::memory_order_relaxed)) <
+         loop->num_chunks) {
+    const size_t chunk_begin = loop->begin + c * loop->grain;
+    (*loop->body)(chunk_begin, std::min(loop->end, chunk_begin + loop->grain));
+  }
+}
+
+void ThreadPool::RunParallelFor(
+    size_t begin,
+    size_t end,
+    size_t grain,
+    const std::function<void(size_t, size_t)>& body) {
+  if (end <= begin) return;
+  grain = std::max<size_t>(grain, 1);
+  const size_t num_chunks = (end - begin + grain - 1) / grain;
+  if (num_chunks == 1) {
+    body(begin, end);
+    return;
+  }
+
+  // The calling thread is one of the participants.
+  const size_t num_helpers = std::min(workers_.size(), num_chunks - 1);
+  LoopState loop;
+  loop.body = &body;
+  loop.begin = begin;
+  loop.end = end;
+  loop.grain = grain;
+  loop.num_chunks = num_chunks;
+  loop.next_chunk.store(0, std::memory_order_relaxed);
+  loop.helpers.store(num_helpers, std::memory_order_relaxed);
+  LoopState* const state = &loop;
+  for (size_t i = 0; i < num_helpers; ++i) {
+    // Captures one pointer only, so the task is stored inline.
+    Push([state]() {
+      RunChunks(state);
+      state->helpers.fetch_sub(1, std::memory_order_release);
+    }, state);
+  }
+  RunChunks(state);
+  // Every chunk has been claimed. Helpers still queued would find nothing to
+  // do, so drop them rather than wait for a worker to pick them up.
+  loop.helpers.fetch_sub(Unqueue(state), std::memory_order_relaxed);
+  // The remaining helpers have started on other threads, and finish once
+  // their last chunk is done.
+  while (loop.helpers.load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+}
+
+ThreadPool& ThreadPool::Shared() {
+  // Never destroyed, so that other statics may use the pool during exit.
+  static ThreadPool* pool = []() {
+    std::lock_guard<std::mutex> lock(shared_options_mutex_);
+    return new ThreadPool(shared_options_);
+  }();
+  return *pool;
+}
+
+void ThreadPool::ConfigureShared(const Options& options) {
+  std::lock_guard<std::mutex> lock(shared_options_mutex_);
+  shared_options_ = options;
+}
+
+}  // namespace util
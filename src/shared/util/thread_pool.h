@@ -0,0 +1,235 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// Work-stealing thread pool. Every worker has its own task deque: it runs its
+// own tasks newest first, and when it runs out, steals the oldest tasks of
+// the other workers. Wait() runs queued tasks instead of blocking. A thread in
+// ParallelFor() only runs chunks of its own loop: once they are all claimed,
+// it drops its helpers that have not started and waits for those that have,
+// so parallel loops may be nested. Once the task queues have grown to their
+// peak size, ParallelFor() and ParallelReduce() do not allocate.
+//
+// Modules should share the process-wide pool rather than start their own
+// threads, so that they do not oversubscribe the cores:
+// ==============================
+// util::ThreadPool::Shared().ParallelFor(0, particles.size(), 1,
+//     [&](size_t begin, size_t end) {
+//   for (size_t i = begin; i < end; ++i) Update(&particles[i]);
+// });
+// ==============================
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "util/arena.h"
+
+#ifndef SRC_UTIL_THREAD_POOL_H_
+#define SRC_UTIL_THREAD_POOL_H_
+
+namespace util {
+
+class ThreadPool {
+ public:
+  struct Options {
+    Options() : num_threads(0), nice(0), name("worker") {}
+
+    // Number of worker threads. 0 for one less than the number of cores,
+    // since the thread calling ParallelFor() takes part in the loop.
+    int num_threads;
+    // CPUs to pin the workers to, round robin. Empty to let them run on any
+    // CPU.
+    std::vector<int> cpus;
+    // Niceness of the workers. Positive values lower their priority below
+    // the rest of the process, so that parallel loops yield to control loops.
+    int nice;
+    // Workers are named "<name>_<index>" in the trace and in top.
+    std::string name;
+  };
+
+  explicit ThreadPool(const Options& options = Options());
+
+  // Runs the tasks still queued, then stops the workers.
+  ~ThreadPool();
+
+  int NumThreads() const { return static_cast<int>(workers_.size()); }
+
+  // Queue @f to run on a worker. The returned future holds its result; wait
+  // for it with Wait() from code that may itself run on a worker.
+  template <typename F>
+  std::future<typename std::result_of<F()>::type> Submit(F f) {
+    typedef typename std::result_of<F()>::type Result;
+    std::shared_ptr<std::packaged_task<Result()>> task(
+        new std::packaged_task<Result()>(std::move(f)));
+    std::future<Result> future = task->get_future();
+    Push([task]() { (*task)(); });
+    return future;
+  }
+
+  // Wait for @future, running queued tasks in the meantime.
+  template <typename T>
+  T Wait(std::future<T>* future) {
+    while (future->wait_for(std::chrono::seconds(0)) !=
+           std::future_status::ready) {
+      if (!RunPendingTask()) std::this_thread::yield();
+    }
+    return future->get();
+  }
+
+  // Call @body(chunk_begin, chunk_end) over [@begin, @end) split into chunks
+  // of @grain indices, on the workers and the calling thread, and return
+  // once all chunks are done. Chunks are handed out dynamically, so uneven
+  // chunks balance out. @body must not throw.
+  template <typename Body>
+  void ParallelFor(size_t begin, size_t end, size_t grain, const Body& body) {
+    // Wrap @body by reference, so that the std::function stores it inline
+    // rather than on the heap, whatever the size of its captures.
+    RunParallelFor(begin, end, grain, [&body](size_t b, size_t e) {
+      body(b, e);
+    });
+  }
+
+  // Reduce @map(chunk_begin, chunk_end) over the chunks of [@begin, @end)
+  // with @reduce, starting from @identity. Chunk results are reduced in
+  // order, so the result does not depend on the scheduling, even for
+  // floating point sums.
+  template <typename T, typename Map, typename Reduce>
+  T ParallelReduce(size_t begin,
+                   size_t end,
+                   size_t grain,
+                   const T& identity,
+                   const Map& map,
+                   const Reduce& reduce) {
+    if (end <= begin) return identity;
+    grain = std::max<size_t>(grain, 1);
+    const size_t num_chunks = (end - begin + grain - 1) / grain;
+    Arena::Scope scope(&ThreadArena());
+    ArenaVector<T> partials(num_chunks, identity,
+                            ArenaAllocator<T>(scope.arena()));
+    ParallelFor(0, num_chunks, 1, [&](size_t chunk_begin, size_t chunk_end) {
+      for (size_t c = chunk_begin; c < chunk_end; ++c) {
+        const size_t i = begin + c * grain;
+        partials[c] = map(i, std::min(end, i + grain));
+      }
+    });
+    T result = identity;
+    for (const T& partial : partials) result = reduce(result, partial);
+    return result;
+  }
+
+  // Run one queued task on the calling thread. Returns false if there was
+  // none.
+  bool RunPendingTask();
+
+  // Process-wide pool, created on first use with the options of the last
+  // ConfigureShared() call before that.
+  static ThreadPool& Shared();
+  static void ConfigureShared(const Options& options);
+
+ private:
+  typedef std::function<void()> Task;
+
+  // Double-ended ring buffer of tasks. Unlike std::deque, it keeps its
+  // storage when emptied, so steady-state pushes do not allocate. Each task
+  // may be tagged with an owner, so that its queued tasks can be removed.
+  class TaskQueue {
+   public:
+    TaskQueue() : head_(0), size_(0) {}
+    bool Empty() const { return size_ == 0; }
+    void PushBack(Task task, const void* owner);
+    Task PopBack();
+    Task PopFront();
+    // Remove the tasks of @owner, keeping the others in order. Returns the
+    // number removed.
+    size_t RemoveOwned(const void* owner);
+
+   private:
+    struct Slot {
+      Task task;
+      const void* owner;
+    };
+
+    Slot& At(size_t i) { return slots_[(head_ + i) % slots_.size()]; }
+
+    std::vector<Slot> slots_;
+    size_t head_;
+    size_t size_;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    TaskQueue tasks;
+    std::string name;
+    std::thread thread;
+  };
+
+  // Shared by the threads taking part in one ParallelFor(), on the stack of
+  // the calling thread.
+  struct LoopState {
+    const std::function<void(size_t, size_t)>* body;
+    size_t begin;
+    size_t end;
+    size_t grain;
+    size_t num_chunks;
+    std::atomic<size_t> next_chunk;
+    // Helper tasks that are queued or running.
+    std::atomic<size_t> helpers;
+  };
+
+  // Disable copy constructor and assignment.
+  ThreadPool(const ThreadPool&);
+  void operator=(const ThreadPool&);
+
+  void Push(Task task, const void* owner = nullptr);
+  // Remove the tasks of @owner that no thread has started yet. Returns the
+  // number removed.
+  size_t Unqueue(const void* owner);
+  void RunParallelFor(size_t begin,
+                      size_t end,
+                      size_t grain,
+                      const std::function<void(size_t, size_t)>& body);
+  // Take the newest task of worker @self, or else the oldest task of another
+  // worker. @self may be NumThreads() for threads outside the pool.
+  bool Pop(size_t self, Task* task);
+  void WorkerLoop(size_t index, const Options& options);
+  // Run chunks of @loop until none are left to claim.
+  static void RunChunks(LoopState* loop);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // Number of queued tasks. Incremented under wake_mutex_, so that workers
+  // going to sleep do not miss new tasks.
+  std::atomic<size_t> pending_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  // Queue that the next task from outside the pool goes to.
+  std::atomic<size_t> next_queue_;
+};
+
+}  // namespace util
+
+#endif  // SRC_UTIL_THREAD_POOL_H_
@@ -25,10 +25,17 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
 #include <string>
+#include <vector>
 
+using std::fill;
 using std::max;
+using std::min;
 using std::string;
+using std::vector;
 
 #if defined(__i386__)
 uint64_t RDTSC() {
@@ -68,13 +75,79 @@ void Sleep(double duration) {
 }
 
 RateLoop::RateLoop(double rate) :
-    t_last_run_(0.0), delay_interval_(1.0 / rate) { }
+    t_last_run_(0.0),
+    delay_interval_(1.0 / rate),
+    t_cycle_start_(0.0),
+    last_period_(delay_interval_),
+    last_overrun_(false),
+    iterations_(0),
+    overruns_(0),
+    period_mean_(0.0),
+    period_m2_(0.0),
+    period_max_(0.0) {
+  fill(period_histogram_, period_histogram_ + kHistogramBuckets, 0);
+}
 
 void RateLoop::Sleep() {
   const double t_now = GetMonotonicTime();
+  // The work done this iteration is everything since the previous sleep ended.
+  last_overrun_ = (t_cycle_start_ > 0.0 &&
+                   t_now - t_cycle_start_ > delay_interval_);
+  if (last_overrun_) ++overruns_;
+
   const double sleep_duration = max(0.0, delay_interval_ + t_last_run_ - t_now);
   ::Sleep(sleep_duration);
   t_last_run_ = t_now + sleep_duration;
+
+  const double t_wake = GetMonotonicTime();
+  if (t_cycle_start_ > 0.0) {
+    const double period = t_wake - t_cycle_start_;
+    last_period_ = period;
+    ++iterations_;
+    const double delta = period - period_mean_;
+    period_mean_ += delta / static_cast<double>(iterations_);
+    period_m2_ += delta * (period - period_mean_);
+    period_max_ = max(period_max_, period);
+    const int bucket = min(kHistogramBuckets - 1,
+        static_cast<int>(10.0 * period / delay_interval_));
+    ++period_histogram_[bucket];
+  }
+  t_cycle_start_ = t_wake;
+}
+
+double RateLoop::Elapsed() const {
+  if (t_cycle_start_ == 0.0) return 0.0;
+  return GetMonotonicTime() - t_cycle_start_;
+}
+
+double RateLoop::LastPeriod() const {
+  return last_period_;
+}
+
+double RateLoop::Jitter() const {
+  if (iterations_ < 2) return 0.0;
+  return sqrt(period_m2_ / static_cast<double>(iterations_ - 1));
+}
+
+void RateLoop::PrintStats(FILE* stream, const char* name) const {
+  fprintf(stream,
+          "Loop stats for %s : iterations = %" PRIu64 ", overruns = %" PRIu64
+          ", mean period = %f ms, jitter = %f ms, max period = %f ms\n",
+          name,
+          iterations_,
+          overruns_,
+          1.0E3 * period_mean_,
+          1.0E3 * Jitter(),
+          1.0E3 * period_max_);
+  fprintf(stream, "Period histogram (ms : count):");
+  for (int i = 0; i < kHistogramBuckets; ++i) {
+    if (period_histogram_[i] == 0) continue;
+    fprintf(stream, " %s%.0f:%" PRIu64,
+            (i == kHistogramBuckets - 1) ? ">=" : "",
+            1.0E3 * 0.1 * i * delay_interval_,
+            period_histogram_[i]);
+  }
+  fprintf(stream, "\n");
 }
 
 FunctionTimer::FunctionTimer(const char* name) :
@@ -94,28 +167,229 @@ void FunctionTimer::Lap(int id) {
   t_lap_start_ = t_now;
 }
 
+namespace {
+
+// Registry of all live cumulative timers.
+struct TimerRegistry {
+  std::mutex mutex;
+  vector<CumulativeFunctionTimer*> timers;
+};
+
+TimerRegistry& Registry() {
+  static TimerRegistry registry;
+  return registry;
+}
+
+// Invocation running on this thread, for nesting.
+thread_local CumulativeFunctionTimer::Invocation* current_invocation_ = nullptr;
+
+// Histogram shard used by this thread.
+int ThreadShard(int num_shards) {
+  static std::atomic<int> next_shard(0);
+  thread_local const int shard = next_shard.fetch_add(1) % num_shards;
+  return shard;
+}
+
+}  // namespace
+
+struct CumulativeFunctionTimer::Shard {
+  Shard() : total_ns(0), max_ns(0) {
+    for (std::atomic<uint64_t>& count : counts) count.store(0);
+  }
+  std::atomic<uint64_t> counts[kNumBuckets];
+  std::atomic<uint64_t> total_ns;
+  std::atomic<uint64_t> max_ns;
+};
+
 CumulativeFunctionTimer::Invocation::Invocation(
     CumulativeFunctionTimer* cumulative_timer) :
-    t_start_(GetMonotonicTime()), cumulative_timer_(cumulative_timer) {}
+    t_start_(GetMonotonicTime()),
+    cumulative_timer_(cumulative_timer),
+    enclosing_(current_invocation_) {
+  if (enclosing_ != nullptr &&
+      enclosing_->cumulative_timer_ != cumulative_timer_ &&
+      cumulative_timer_->parent_.load(std::memory_order_relaxed) == nullptr) {
+    CumulativeFunctionTimer* expected = nullptr;
+    cumulative_timer_->parent_.compare_exchange_strong(
+        expected, enclosing_->cumulative_timer_);
+  }
+  current_invocation_ = this;
+}
 
 CumulativeFunctionTimer::Invocation::~Invocation() {
   const double t_duration = GetMonotonicTime() - t_start_;
-  cumulative_timer_->total_invocations_++;
-  cumulative_timer_->total_run_time_ += t_duration;
+  cumulative_timer_->Record(t_duration);
+  current_invocation_ = enclosing_;
 }
 
 CumulativeFunctionTimer::CumulativeFunctionTimer(const char* name) :
-    name_(name), total_run_time_(0.0), total_invocations_(0) {}
+    name_(name), parent_(nullptr) {
+  for (std::atomic<Shard*>& shard : shards_) shard.store(nullptr);
+  TimerRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.timers.push_back(this);
+}
 
 CumulativeFunctionTimer::~CumulativeFunctionTimer() {
-  const double mean_run_time =
-      total_run_time_ / static_cast<double>(total_invocations_);
-  printf("Run-time stats for %s : mean run time = %f ms, "
-         "invocations = %" PRIu64 "\n",
-         name_.c_str(),
-         1.0E3 * mean_run_time,
-         total_invocations_);
+  {
+    TimerRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.timers.erase(
+        std::remove(registry.timers.begin(), registry.timers.end(), this),
+        registry.timers.end());
+    // Reparent the stages nested under this timer.
+    for (CumulativeFunctionTimer* timer : registry.timers) {
+      CumulativeFunctionTimer* expected = this;
+      timer->parent_.compare_exchange_strong(expected, parent_.load());
+    }
+  }
+  PrintStats(stdout);
+  for (std::atomic<Shard*>& shard : shards_) delete shard.load();
+}
+
+int CumulativeFunctionTimer::BucketIndex(uint64_t ns) {
+  if (ns < kSubBuckets) return static_cast<int>(ns);
+  ns = min<uint64_t>(ns, (uint64_t(1) << (kMaxMagnitude + 1)) - 1);
+  const int magnitude = 63 - __builtin_clzll(ns);
+  const int shift = magnitude - kSubBucketBits;
+  return (shift + 1) * kSubBuckets +
+      static_cast<int>((ns >> shift) & (kSubBuckets - 1));
+}
+
+double CumulativeFunctionTimer::BucketValue(int index) {
+  if (index < kSubBuckets) return 1.0E-9 * index;
+  const int shift = index / kSubBuckets - 1;
+  const double lower =
+      static_cast<double>((kSubBuckets + index % kSubBuckets)) *
+      static_cast<double>(uint64_t(1) << shift);
+  // Middle of the whole nanoseconds in the bucket, so that buckets one
+  // nanosecond wide are exact.
+  return 1.0E-9 *
+      (lower + 0.5 * static_cast<double>((uint64_t(1) << shift) - 1));
+}
+
+CumulativeFunctionTimer::Shard* CumulativeFunctionTimer::GetShard() {
+  std::atomic<Shard*>& slot = shards_[ThreadShard(kNumShards)];
+  Shard* shard = slot.load(std::memory_order_acquire);
+  if (shard != nullptr) return shard;
+  Shard* new_shard = new Shard();
+  if (slot.compare_exchange_strong(shard, new_shard,
+                                   std::memory_order_acq_rel)) {
+    return new_shard;
+  }
+  // Another thread sharing the slot got there first.
+  delete new_shard;
+  return shard;
+}
+
+void CumulativeFunctionTimer::Record(double duration) {
+  const uint64_t ns = static_cast<uint64_t>(max(0.0, 1.0E9 * duration));
+  Shard* shard = GetShard();
+  shard->counts[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+  shard->total_ns.fetch_add(ns, std::memory_order_relaxed);
+  uint64_t current_max = shard->max_ns.load(std::memory_order_relaxed);
+  while (ns > current_max &&
+         !shard->max_ns.compare_exchange_weak(current_max, ns,
+                                              std::memory_order_relaxed)) {}
+}
+
+CumulativeFunctionTimer::Stats CumulativeFunctionTimer::GetStats() const {
+  vector<uint64_t> counts(kNumBuckets, 0);
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+  for (const std::atomic<Shard*>& slot : shards_) {
+    const Shard* shard = slot.load(std::memory_order_acquire);
+    if (shard == nullptr) continue;
+    for (int i = 0; i < kNumBuckets; ++i) {
+      counts[i] += shard->counts[i].load(std::memory_order_relaxed);
+    }
+    total_ns += shard->total_ns.load(std::memory_order_relaxed);
+    max_ns = max(max_ns, shard->max_ns.load(std::memory_order_relaxed));
+  }
+
+  Stats stats;
+  stats.invocations = 0;
+  for (const uint64_t count : counts) stats.invocations += count;
+  stats.total = 1.0E-9 * static_cast<double>(total_ns);
+  stats.max = 1.0E-9 * static_cast<double>(max_ns);
+  stats.mean = (stats.invocations > 0) ?
+      stats.total / static_cast<double>(stats.invocations) : 0.0;
+  const double quantiles[] = {0.5, 0.9, 0.99};
+  double* results[] = {&stats.p50, &stats.p90, &stats.p99};
+  for (int q = 0; q < 3; ++q) {
+    const uint64_t rank = static_cast<uint64_t>(
+        ceil(quantiles[q] * static_cast<double>(stats.invocations)));
+    uint64_t seen = 0;
+    *results[q] = 0.0;
+    for (int i = 0; i < kNumBuckets; ++i) {
+      seen += counts[i];
+      if (seen >= rank && counts[i] > 0) {
+        *results[q] = min(BucketValue(i), stats.max);
+        break;
+      }
+    }
+  }
+  return stats;
+}
+
+void CumulativeFunctionTimer::PrintStats(FILE* stream) const {
+  const Stats stats = GetStats();
+  fprintf(stream,
+          "Run-time stats for %s : mean run time = %f ms, "
+          "invocations = %" PRIu64 ", p50 = %f ms, p90 = %f ms, "
+          "p99 = %f ms, max = %f ms\n",
+          name_.c_str(),
+          1.0E3 * stats.mean,
+          stats.invocations,
+          1.0E3 * stats.p50,
+          1.0E3 * stats.p90,
+          1.0E3 * stats.p99,
+          1.0E3 * stats.max);
 }
 
+void CumulativeFunctionTimer::PrintTree(
+    FILE* stream, int depth, double parent_total,
+    const vector<CumulativeFunctionTimer*>& timers) const {
+  // Guard against cycles from stages nested both ways in different paths.
+  if (depth > static_cast<int>(timers.size())) return;
+  const Stats stats = GetStats();
+  fprintf(stream,
+          "%*s%s : n = %" PRIu64 ", mean = %.3f ms, p50 = %.3f ms, "
+          "p90 = %.3f ms, p99 = %.3f ms, max = %.3f ms",
+          2 * depth, "",
+          name_.c_str(),
+          stats.invocations,
+          1.0E3 * stats.mean,
+          1.0E3 * stats.p50,
+          1.0E3 * stats.p90,
+          1.0E3 * stats.p99,
+          1.0E3 * stats.max);
+  if (parent_total > 0.0) {
+    fprintf(stream, ", %.1f%% of parent", 100.0 * stats.total / parent_total);
+  }
+  fprintf(stream, "\n");
+  for (const CumulativeFunctionTimer* timer : timers) {
+    if (timer->parent_.load(std::memory_order_relaxed) == this) {
+      timer->PrintTree(stream, depth + 1, stats.total, timers);
+    }
+  }
+}
 
+void CumulativeFunctionTimer::PrintAllStats(FILE* stream) {
+  TimerRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const CumulativeFunctionTimer* timer : registry.timers) {
+    if (timer->parent_.load(std::memory_order_relaxed) == nullptr) {
+      timer->PrintTree(stream, 0, 0.0, registry.timers);
+    }
+  }
+}
 
+void CumulativeFunctionTimer::PrintAllStatsEvery(double period, FILE* stream) {
+  static std::atomic<double> t_last(0.0);
+  const double t_now = GetMonotonicTime();
+  double t_prev = t_last.load(std::memory_order_relaxed);
+  if (t_now - t_prev < period) return;
+  if (!t_last.compare_exchange_strong(t_prev, t_now)) return;
+  PrintAllStats(stream);
+}
@@ -20,21 +20,63 @@
 //========================================================================
 
 #include <stdint.h>
+#include <stdio.h>
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 #ifndef SRC_UTIL_TIMER_H_
 #define SRC_UTIL_TIMER_H_
 
-// Helper class to execute tightly timed loops.
+// Helper class to execute tightly timed loops. Besides sleeping to the
+// requested rate, it keeps track of how long each iteration actually took so
+// that the loop body can adapt to, and report, missed deadlines.
 class RateLoop {
  public:
+  // Number of buckets in the period histogram. Each bucket spans a tenth of the
+  // nominal period, and the last bucket collects everything longer.
+  static const int kHistogramBuckets = 30;
+
   // Primary constructor, initialize a fixed rate.
   explicit RateLoop(double rate);
 
   // Sleep for as long as necessary to run at the specified rate.
   void Sleep();
 
+  // Nominal period of the loop in seconds.
+  double Budget() const { return delay_interval_; }
+
+  // Time in seconds since the current iteration started.
+  double Elapsed() const;
+
+  // Measured duration of the last complete iteration in seconds, or the
+  // nominal period if no iteration has completed yet.
+  double LastPeriod() const;
+
+  // Returns true iff the work in the last iteration took longer than the
+  // nominal period.
+  bool Overrun() const { return last_overrun_; }
+
+  // Number of completed iterations.
+  uint64_t Iterations() const { return iterations_; }
+
+  // Number of iterations whose work took longer than the nominal period.
+  uint64_t Overruns() const { return overruns_; }
+
+  // Mean and standard deviation of the measured period in seconds.
+  double MeanPeriod() const { return period_mean_; }
+  double Jitter() const;
+
+  // Longest measured period in seconds.
+  double MaxPeriod() const { return period_max_; }
+
+  // Histogram of measured periods, see kHistogramBuckets.
+  const uint64_t* PeriodHistogram() const { return period_histogram_; }
+
+  // Print a summary of the loop timing statistics.
+  void PrintStats(FILE* stream, const char* name) const;
+
  private:
   // Disable default constructor.
   RateLoop();
@@ -42,6 +84,17 @@ class RateLoop {
  private:
   double t_last_run_;
   const double delay_interval_;
+  // Time the previous iteration started, or zero before the first iteration.
+  double t_cycle_start_;
+  double last_period_;
+  bool last_overrun_;
+  uint64_t iterations_;
+  uint64_t overruns_;
+  // Running mean, sum of squared deviations (Welford), and maximum of the period.
+  double period_mean_;
+  double period_m2_;
+  double period_max_;
+  uint64_t period_histogram_[kHistogramBuckets];
 };
 
 // Return the value of the CPU TSC register.
@@ -100,6 +153,11 @@ class FunctionTimer {
 //   // ... Do some stuff ...
 // }
 // ==============================
+// Durations are recorded in a log-linear histogram (within 1/32 of the true
+// value) kept per thread, so invocations from any number of threads are
+// recorded without locks. All live timers are kept in a registry that can be
+// printed at any time. A timer invoked while another timer's invocation is
+// running on the same thread is reported as a stage nested under it.
 class CumulativeFunctionTimer {
  public:
   class Invocation {
@@ -120,6 +178,19 @@ class CumulativeFunctionTimer {
     const double t_start_;
     // Pointer to cumulative timer.
     CumulativeFunctionTimer* const cumulative_timer_;
+    // Invocation that was running on this thread when this one started.
+    Invocation* const enclosing_;
+  };
+
+  // Summary of all invocations so far. Times are in seconds.
+  struct Stats {
+    uint64_t invocations;
+    double total;
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
   };
 
  public:
@@ -130,19 +201,65 @@ class CumulativeFunctionTimer {
   // Default destructor. Print statistics of all invocations.
   ~CumulativeFunctionTimer();
 
+  // Histogram buckets: values below 16ns get one bucket each, after that
+  // every power of two is split into 16 buckets, up to about 18 minutes.
+  static const int kSubBucketBits = 4;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kMaxMagnitude = 40;
+  static const int kNumBuckets =
+      (kMaxMagnitude - kSubBucketBits + 2) * kSubBuckets;
+
+  // Bucket of a duration in nanoseconds, and the duration in seconds that a
+  // bucket stands for.
+  static int BucketIndex(uint64_t ns);
+  static double BucketValue(int index);
+
+  const std::string& Name() const { return name_; }
+
+  // Timer that this one was first invoked under, or nullptr.
+  const CumulativeFunctionTimer* Parent() const {
+    return parent_.load(std::memory_order_relaxed);
+  }
+
+  // Record one invocation that took @duration seconds, from any thread.
+  void Record(double duration);
+
+  // Statistics of the invocations recorded so far, from all threads.
+  Stats GetStats() const;
+
+  // Print the statistics of this timer.
+  void PrintStats(FILE* stream) const;
+
+  // Print the statistics of every live timer, with nested stages indented
+  // under their parents.
+  static void PrintAllStats(FILE* stream);
+
+  // Call PrintAllStats if at least @period seconds have passed since the last
+  // time it was printed by this function. Cheap enough to call every cycle.
+  static void PrintAllStatsEvery(double period, FILE* stream);
+
  private:
   // Disable copy constructor.
   CumulativeFunctionTimer(const CumulativeFunctionTimer&);
   // Disable default constructor.
   CumulativeFunctionTimer();
 
+  // Threads are spread over this many histograms.
+  static const int kNumShards = 16;
+
+  struct Shard;
+
+  Shard* GetShard();
+  void PrintTree(FILE* stream, int depth, double parent_total,
+                 const std::vector<CumulativeFunctionTimer*>& timers) const;
+
  private:
   // Name of the timer.
   const std::string name_;
-  // Cumulative run time.
-  double total_run_time_;
-  // Number of times the function was invoked.
-  uint64_t total_invocations_;
+  // Per-thread histograms, allocated on first use.
+  std::atomic<Shard*> shards_[kNumShards];
+  // Timer whose invocation enclosed the first nested invocation of this one.
+  std::atomic<CumulativeFunctionTimer*> parent_;
 };
 
 #endif  // SRC_UTIL_TIMER_H_
@@ -0,0 +1,243 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+
+#include "util/trace.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "util/timer.h"
+
+using std::string;
+using std::vector;
+
+namespace util {
+namespace trace {
+
+namespace internal {
+std::atomic<bool> enabled(false);
+}  // namespace internal
+
+namespace {
+
+// Set in the stamp of end events.
+const uint64_t kEndFlag = uint64_t(1) << 63;
+
+// Fields are relaxed atomics so that Write() may read a slot while its thread
+// overwrites it; such slots are detected through ThreadBuffer::started and
+// dropped.
+struct Event {
+  std::atomic<const char*> name;
+  std::atomic<uint64_t> stamp;
+};
+
+struct ThreadBuffer {
+  explicit ThreadBuffer(int tid) :
+      tid(tid), started(0), count(0), thread_name(nullptr) {}
+  const int tid;
+  // Number of events whose slot the thread has started to write, and of those
+  // completely written. Event i is in events[i % kEventsPerThread].
+  std::atomic<uint64_t> started;
+  std::atomic<uint64_t> count;
+  std::atomic<const char*> thread_name;
+  Event events[kEventsPerThread];
+};
+
+struct Tracer {
+  Tracer() : tsc_start(0), t_start(0.0), write_at_exit(false) {}
+  std::mutex mutex;
+  // Buffers are never freed, so the events of threads that have exited are
+  // still written out.
+  vector<ThreadBuffer*> buffers;
+  string file_name;
+  // Clocks at the first Start(), to convert TSC stamps to trace time.
+  uint64_t tsc_start;
+  double t_start;
+  bool write_at_exit;
+};
+
+// Never destroyed, so threads still running during static destruction can
+// keep recording.
+Tracer& GetTracer() {
+  static Tracer* tracer = new Tracer();
+  return *tracer;
+}
+
+thread_local ThreadBuffer* thread_buffer_ = nullptr;
+
+ThreadBuffer* GetThreadBuffer() {
+  if (thread_buffer_ == nullptr) {
+    Tracer& tracer = GetTracer();
+    std::lock_guard<std::mutex> lock(tracer.mutex);
+    thread_buffer_ = new ThreadBuffer(static_cast<int>(tracer.buffers.size()));
+    tracer.buffers.push_back(thread_buffer_);
+  }
+  return thread_buffer_;
+}
+
+void Record(const char* name, uint64_t stamp) {
+  ThreadBuffer* buffer = GetThreadBuffer();
+  const uint64_t i = buffer->count.load(std::memory_order_relaxed);
+  Event& event = buffer->events[i % kEventsPerThread];
+  // Announce the overwrite before touching the slot: a reader that sees any
+  // of the stores below also sees @started, through its acquire fence.
+  buffer->started.store(i + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  event.name.store(name, std::memory_order_relaxed);
+  event.stamp.store(stamp, std::memory_order_relaxed);
+  buffer->count.store(i + 1, std::memory_order_release);
+}
+
+void WriteAtExit() {
+  Stop();
+  const string file_name = GetTracer().file_name;
+  if (Write(file_name)) {
+    printf("Trace written to %s\n", file_name.c_str());
+  } else {
+    fprintf(stderr, "ERROR: Unable to write trace to %s\n", file_name.c_str());
+  }
+}
+
+void WriteString(FILE* file, const char* str) {
+  fputc('"', file);
+  for (const char* c = str; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') fputc('\\', file);
+    if (static_cast<unsigned char>(*c) >= 0x20) fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+}  // namespace
+
+void Start(const string& file_name) {
+  Tracer& tracer = GetTracer();
+  {
+    std::lock_guard<std::mutex> lock(tracer.mutex);
+    if (tracer.tsc_start == 0) {
+      tracer.t_start = GetMonotonicTime();
+      tracer.tsc_start = RDTSC();
+    }
+    if (!file_name.empty()) {
+      tracer.file_name = file_name;
+      if (!tracer.write_at_exit) atexit(WriteAtExit);
+      tracer.write_at_exit = true;
+    }
+  }
+  internal::enabled.store(true, std::memory_order_relaxed);
+}
+
+void Stop() {
+  internal::enabled.store(false, std::memory_order_relaxed);
+}
+
+void Begin(const char* name) {
+  Record(name, RDTSC() & ~kEndFlag);
+}
+
+void End(const char* name) {
+  Record(name, RDTSC() | kEndFlag);
+}
+
+void SetThreadName(const char* name) {
+  GetThreadBuffer()->thread_name.store(name, std::memory_order_relaxed);
+}
+
+bool Write(const string& file_name) {
+  Tracer& tracer = GetTracer();
+  vector<ThreadBuffer*> buffers;
+  uint64_t tsc_start = 0;
+  double t_start = 0.0;
+  {
+    std::lock_guard<std::mutex> lock(tracer.mutex);
+    buffers = tracer.buffers;
+    tsc_start = tracer.tsc_start;
+    t_start = tracer.t_start;
+  }
+  // Calibrate the TSC against the monotonic clock over the whole trace.
+  const double elapsed = GetMonotonicTime() - t_start;
+  const double ticks_per_us = (elapsed > 0.0 && tsc_start > 0) ?
+      1.0E-6 * static_cast<double>(RDTSC() - tsc_start) / elapsed : 1.0;
+
+  FILE* file = fopen(file_name.c_str(), "w");
+  if (file == nullptr) return false;
+  const int pid = getpid();
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  vector<const char*> names;
+  vector<uint64_t> stamps;
+  for (const ThreadBuffer* buffer : buffers) {
+    const char* thread_name =
+        buffer->thread_name.load(std::memory_order_relaxed);
+    if (thread_name != nullptr) {
+      fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+              "\"tid\":%d,\"args\":{\"name\":",
+              first ? "" : ",\n", pid, buffer->tid);
+      WriteString(file, thread_name);
+      fprintf(file, "}}");
+      first = false;
+    }
+
+    // Copy the events, then drop the ones the thread may have overwritten
+    // while they were copied.
+    const uint64_t end = buffer->count.load(std::memory_order_acquire);
+    uint64_t begin = (end > kEventsPerThread) ? end - kEventsPerThread : 0;
+    names.clear();
+    stamps.clear();
+    for (uint64_t i = begin; i < end; ++i) {
+      const Event& event = buffer->events[i % kEventsPerThread];
+      names.push_back(event.name.load(std::memory_order_relaxed));
+      stamps.push_back(event.stamp.load(std::memory_order_relaxed));
+    }
+    // Pairs with the release fence in Record(): slots overwritten while they
+    // were copied are among the events the thread had started by now.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t started = buffer->started.load(std::memory_order_relaxed);
+    const uint64_t first_valid =
+        (started > kEventsPerThread) ? started - kEventsPerThread : 0;
+    const size_t skip = static_cast<size_t>(
+        std::min<uint64_t>(end - begin, std::max(begin, first_valid) - begin));
+
+    // Leading end events lost their begin events to the ring buffer.
+    int depth = 0;
+    for (size_t i = skip; i < names.size(); ++i) {
+      const bool is_end = (stamps[i] & kEndFlag) != 0;
+      if (is_end && depth == 0) continue;
+      depth += is_end ? -1 : 1;
+      const uint64_t tsc = stamps[i] & ~kEndFlag;
+      const double ts = (tsc > tsc_start) ?
+          static_cast<double>(tsc - tsc_start) / ticks_per_us : 0.0;
+      fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+      WriteString(file, names[i]);
+      fprintf(file, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+              is_end ? 'E' : 'B', ts, pid, buffer->tid);
+      first = false;
+    }
+  }
+  fprintf(file, "\n]}\n");
+  const bool ok = (ferror(file) == 0);
+  fclose(file);
+  return ok;
+}
+
+}  // namespace trace
+}  // namespace util
@@ -0,0 +1,107 @@
+//========================================================================
+// This software is free: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License Version 3,
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// Version 3 in the file COPYING that came with this distribution.
+// If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// Low-overhead event tracing. Scoped begin/end events are stamped with the
+// TSC and appended to a ring buffer owned by the recording thread, so
+// recording takes no locks. The buffers are written out as Chrome trace JSON,
+// which chrome://tracing and the Perfetto UI both open, showing how the
+// threads of a node interleave. While tracing is disabled, a trace scope costs
+// one relaxed atomic load.
+//
+// Example:
+// ==============================
+// void Foo() {
+//   TRACE_SCOPE("Foo");
+//   // ... Do some stuff ...
+// }
+// ==============================
+// Event names must be string literals, or otherwise outlive the trace.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#ifndef SRC_UTIL_TRACE_H_
+#define SRC_UTIL_TRACE_H_
+
+namespace util {
+namespace trace {
+
+// Events kept per thread. When a thread records more than this between
+// flushes, its oldest events are overwritten.
+const int kEventsPerThread = 1 << 16;
+
+// Start recording events. If @file_name is not empty, the trace is written to
+// it when the process exits.
+void Start(const std::string& file_name);
+
+// Stop recording events. Events already recorded are kept.
+void Stop();
+
+namespace internal {
+extern std::atomic<bool> enabled;
+}  // namespace internal
+
+inline bool Enabled() {
+  return internal::enabled.load(std::memory_order_relaxed);
+}
+
+// Record the start or end of an event on the calling thread.
+void Begin(const char* name);
+void End(const char* name);
+
+// Name the calling thread in the trace.
+void SetThreadName(const char* name);
+
+// Write the events recorded so far by all threads to @file_name as Chrome
+// trace JSON. Threads may keep recording while the trace is written. Returns
+// false if the file could not be written.
+bool Write(const std::string& file_name);
+
+// Records an event spanning the lifetime of the scope.
+class Scope {
+ public:
+  explicit Scope(const char* name) : name_(Enabled() ? name : nullptr) {
+    if (name_ != nullptr) Begin(name_);
+  }
+
+  ~Scope() {
+    if (name_ != nullptr) End(name_);
+  }
+
+ private:
+  // Disable copy constructor and assignment.
+  Scope(const Scope&);
+  void operator=(const Scope&);
+
+  // Name of the event, or nullptr if tracing was disabled when it started.
+  const char* const name_;
+};
+
+}  // namespace trace
+}  // namespace util
+
+#define TRACE_CONCAT_INNER(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Trace the enclosing scope as an event named @name.
+#define TRACE_SCOPE(name) \
+  ::util::trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+// Trace the enclosing function.
+#define TRACE_FUNCTION() TRACE_SCOPE(__FUNCTION__)
+
+#endif  // SRC_UTIL_TRACE_H_
@@ -28,7 +28,12 @@
 #include "glog/logging.h"
 #include "shared/math/geometry.h"
 #include "shared/math/math_util.h"
+#include "shared/util/allocation_counter.h"
+#include "shared/util/arena.h"
+#include "shared/util/metrics.h"
+#include "shared/util/thread_pool.h"
 #include "shared/util/timer.h"
+#include "shared/util/trace.h"
 
 #include "slam.h"
 
@@ -61,6 +66,21 @@ using vector_map::VectorMap;
 //
 // ==========================================================
 
+namespace {
+util::metrics::Counter scans_received_(
+	"slam_scans_received_total", "Laser scans received");
+util::metrics::Counter scans_processed_(
+	"slam_scans_processed_total", "Laser scans matched and added to the map");
+util::metrics::Counter csm_candidates_(
+	"slam_csm_candidates_total", "Candidate poses scored by CSM");
+util::metrics::Gauge csm_allocations_(
+	"slam_csm_allocations",
+	"Heap allocations made by the last CSM, which should be 0 once warmed up");
+util::metrics::Histogram csm_time_(
+	"slam_csm_seconds", "Time to match a scan with CSM",
+	util::metrics::LatencyBounds());
+} // namespace
+
 void trimScan(vector<Vector2f>* cloud, int offset_count){
 	for (size_t i = 0; i < cloud->size()/offset_count; i++){
 		(*cloud)[i] = (*cloud)[i*offset_count];
@@ -125,7 +145,7 @@ vector<Vector2f>* SLAM::Scan2BaseLinkCloud(const LaserScan &s) const{
 
 // Done by Alex
 // Populates the grid with probabilities due to a laser scan
-void SLAM::applyScan(LaserScan scan){
+void SLAM::applyScan(const LaserScan &scan){
 	const vector<Vector2f>* points = Scan2BaseLinkCloud(scan);
 	prob_grid_.clear();
 
@@ -136,7 +156,13 @@ void SLAM::applyScan(LaserScan scan){
 }
 
 // Done by Alex
-Pose SLAM::ApplyCSM(LaserScan scan) {
+Pose SLAM::ApplyCSM(const LaserScan &scan) {
+	static CumulativeFunctionTimer function_timer_(__FUNCTION__);
+	CumulativeFunctionTimer::Invocation invoke(&function_timer_);
+	TRACE_FUNCTION();
+	const double t_start = GetMonotonicTime();
+	const util::AllocationCounter allocations;
+	util::Arena::Scope scope(&util::ThreadArena());
 	float max_cost = -std::numeric_limits<float>::infinity();
 	Pose best_pose = {{0,0},0};
 
@@ -144,23 +170,35 @@ Pose SLAM::ApplyCSM(LaserScan scan) {
 	trimScan(base_link_scan, CSM_scan_offset_);
 	int scan_size = base_link_scan->size();
 
-	float CSM_cost = 0.0;
-	float MM_cost = 0.0;
-	for (const auto &pose : possible_poses_){
-		float laser_scan_cost = 0.0;
-		
-		// Loop through laser points in this scan and add up the log likelihoods
-		for (const Vector2f &loc : *base_link_scan){
-
-			try{
-				// Transform laser scan to last pose's base_link frame
-				Vector2f mapped_loc = TransformNewScanToPrevPose(loc, pose.pose);
-				laser_scan_cost += prob_grid_.atLoc(mapped_loc);
-
-			}catch(std::out_of_range &e){
-				continue;
+	// Score the candidate poses in parallel
+	util::ArenaVector<float> laser_scan_costs(possible_poses_.size(), 0.0f,
+	                                         util::ArenaAllocator<float>(scope.arena()));
+	util::ThreadPool::Shared().ParallelFor(0, possible_poses_.size(), 8, [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; i++){
+			const Pose &pose = possible_poses_[i].pose;
+			float laser_scan_cost = 0.0;
+
+			// Loop through laser points in this scan and add up the log likelihoods
+			for (const Vector2f &loc : *base_link_scan){
+
+				try{
+					// Transform laser scan to last pose's base_link frame
+					Vector2f mapped_loc = TransformNewScanToPrevPose(loc, pose);
+					laser_scan_cost += prob_grid_.atLoc(mapped_loc);
+
+				}catch(std::out_of_range &e){
+					continue;
+				}
 			}
+			laser_scan_costs[i] = laser_scan_cost;
 		}
+	});
+
+	float CSM_cost = 0.0;
+	float MM_cost = 0.0;
+	for (size_t i = 0; i < possible_poses_.size(); i++){
+		const auto &pose = possible_poses_[i];
+		const float laser_scan_cost = laser_scan_costs[i];
 
 		// Factor in weighted motion model likelihood
 		float normalized_laser_cost  = laser_scan_cost/scan_size;
@@ -175,6 +213,9 @@ Pose SLAM::ApplyCSM(LaserScan scan) {
 		}
 	}
 	cout << "New pose selected!" << "\t CSM_cost: " << CSM_cost << "\tMM_cost: " << MM_cost << endl;
+	csm_candidates_.Increment(possible_poses_.size());
+	csm_allocations_.Set(allocations.Total());
+	csm_time_.Observe(GetMonotonicTime() - t_start);
 
 	return best_pose;
 }
@@ -196,11 +237,20 @@ void SLAM::ObserveLaser(const vector<float>& ranges,
                                      float angle_min,
                                      float angle_max,
                                      amrl_msgs::VisualizationMsg &viz) {
+	static CumulativeFunctionTimer function_timer_(__FUNCTION__);
+	CumulativeFunctionTimer::Invocation invoke(&function_timer_);
+	TRACE_FUNCTION();
 	// Test whether we need to update the map with the current laser scan
 	bool apply_scan_flag = update_scan_ or (odom_initialized_ and not prob_grid_init_);
+	scans_received_.Increment();
 
 	if (apply_scan_flag){
-		current_scan_ = LaserScan({ranges, range_min, range_max, angle_min, angle_max});
+		// Copy into the existing ranges, to reuse their storage
+		current_scan_.ranges.assign(ranges.begin(), ranges.end());
+		current_scan_.range_min = range_min;
+		current_scan_.range_max = range_max;
+		current_scan_.angle_min = angle_min;
+		current_scan_.angle_max = angle_max;
 		
 		// Transform the current scan centered around possible poses from
 		// motion model to find best fit with lookup table from previous scan
@@ -211,6 +261,7 @@ void SLAM::ObserveLaser(const vector<float>& ranges,
 		// Get lookup table, preparing for next scan
 		applyScan(current_scan_);
 		update_scan_ = false;
+		scans_processed_.Increment();
 	}
 	// if (prob_grid_init_) prob_grid_.showGrid(viz);
 }
@@ -257,6 +308,7 @@ void SLAM::ApplyMotionModel(Eigen::Vector2f loc, float angle, float dist_travele
 
 // Done by Mark
 void SLAM::ObserveOdometry(const Vector2f& odom_loc, const float odom_angle) {
+	TRACE_FUNCTION();
 	if (!odom_initialized_) {
 		prev_odom_angle_ = odom_angle;
 		prev_odom_loc_ = odom_loc;
@@ -287,6 +339,7 @@ void SLAM::ObserveOdometry(const Vector2f& odom_loc, const float odom_angle) {
 
 // Done by Mark
 void SLAM::updateMap(Pose CSM_pose) {
+	TRACE_FUNCTION();
 	// Reconstruct the map as a single aligned point cloud from all saved poses
 	// and their respective scans.
 	const int num_ranges = current_scan_.ranges.size();
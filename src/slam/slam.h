@@ -87,10 +87,10 @@ class SLAM {
   void ApplyMotionModel(Eigen::Vector2f loc, float angle, float dist_traveled, float angle_diff);
 
   // Store a scan as a prior in the probability grid
-  void applyScan(LaserScan s);
+  void applyScan(const LaserScan &s);
 
   // Apply Correlative Scan Matching Algorithm
-  Pose ApplyCSM(LaserScan s);
+  Pose ApplyCSM(const LaserScan &s);
 
  private:
 
@@ -28,147 +28,55 @@
 #include <termios.h>
 #include <vector>
 
-#include "eigen3/Eigen/Dense"
-#include "eigen3/Eigen/Geometry"
-#include "amrl_msgs/Localization2DMsg.h"
-#include "amrl_msgs/VisualizationMsg.h"
 #include "gflags/gflags.h"
-#include "geometry_msgs/PoseArray.h"
-#include "geometry_msgs/PoseWithCovarianceStamped.h"
-#include "sensor_msgs/LaserScan.h"
-#include "nav_msgs/Odometry.h"
 #include "ros/ros.h"
-#include "rosbag/bag.h"
-#include "rosbag/view.h"
-#include "ros/package.h"
 
-#include "config_reader/config_reader.h"
-#include "shared/math/math_util.h"
-#include "shared/math/line2d.h"
+#include "shared/ros/metrics_publisher.h"
 #include "shared/util/timer.h"
+#include "shared/util/thread_pool.h"
+#include "shared/util/trace.h"
 
-#include "slam.h"
-#include "vector_map/vector_map.h"
-#include "visualization/visualization.h"
-
-using amrl_msgs::VisualizationMsg;
-using geometry::line2f;
-using geometry::Line;
-using math_util::DegToRad;
-using math_util::RadToDeg;
-using ros::Time;
-using std::string;
-using std::vector;
-using Eigen::Vector2f;
-using visualization::ClearVisualizationMsg;
-using visualization::DrawArc;
-using visualization::DrawPoint;
-using visualization::DrawLine;
-using visualization::DrawParticle;
+#include "slam_node.h"
 
 // Create command line arguements
 DEFINE_string(laser_topic, "/scan", "Name of ROS topic for LIDAR data");
 DEFINE_string(odom_topic, "/odom", "Name of ROS topic for odometry data");
+DEFINE_string(loc_topic, "localization",
+              "Name of ROS topic to publish the pose on");
+DEFINE_string(trace, "", "Write a Chrome trace of the node to this file at exit");
+DEFINE_int32(threads, 0,
+             "Worker threads for parallel loops, 0 for one less than the "
+             "number of cores");
+DEFINE_int32(thread_nice, 0, "Niceness of the worker threads");
+DEFINE_double(metrics_period, 1.0,
+              "Seconds between metrics updates on /diagnostics, 0 to disable");
+DEFINE_string(metrics_file, "",
+              "Also write metrics to this file in Prometheus text format");
 
 DECLARE_int32(v);
 
-bool run_ = true;
-slam::SLAM slam_;
-ros::Publisher visualization_publisher_;
-ros::Publisher localization_publisher_;
-VisualizationMsg vis_msg_;
-VisualizationMsg grid_msg_;
-sensor_msgs::LaserScan last_laser_msg_;
-
-void InitializeMsgs() {
-  std_msgs::Header header;
-  header.frame_id = "map";
-  header.seq = 0;
-
-  vis_msg_ = visualization::NewVisualizationMessage("map", "slam");
-  grid_msg_ = visualization::NewVisualizationMessage("base_link", "slam_local");
-}
-
-void PublishMap() {
-  static double t_last = 0;
-  if (GetMonotonicTime() - t_last < 0.5) {
-    // Rate-limit visualization.
-    ClearVisualizationMsg(vis_msg_);
-    visualization_publisher_.publish(grid_msg_);
-    return;
-  }
-  t_last = GetMonotonicTime();
-  vis_msg_.header.stamp = ros::Time::now();
-  ClearVisualizationMsg(vis_msg_);
-
-  const vector<Vector2f> map = slam_.GetMap();
-  printf("Map: %lu points\n", map.size());
-  for (const Vector2f& p : map) {
-    visualization::DrawPoint(p, 0xC0C0C0, vis_msg_);
-  }
-  visualization_publisher_.publish(vis_msg_);
-  visualization_publisher_.publish(grid_msg_);
-}
-
-void PublishPose() {
-  Vector2f robot_loc(0, 0);
-  float robot_angle(0);
-  slam_.GetPose(&robot_loc, &robot_angle);
-  amrl_msgs::Localization2DMsg localization_msg;
-  localization_msg.pose.x = robot_loc.x();
-  localization_msg.pose.y = robot_loc.y();
-  localization_msg.pose.theta = robot_angle;
-  localization_publisher_.publish(localization_msg);
-}
-
-void LaserCallback(const sensor_msgs::LaserScan& msg) {
-  if (FLAGS_v > 0) {
-    printf("Laser t=%f\n", msg.header.stamp.toSec());
-  }
-  last_laser_msg_ = msg;
-  ClearVisualizationMsg(grid_msg_);
-  slam_.ObserveLaser(
-      msg.ranges,
-      msg.range_min,
-      msg.range_max,
-      msg.angle_min,
-      msg.angle_max,
-      grid_msg_);
-  PublishMap();
-  PublishPose();
-}
-
-void OdometryCallback(const nav_msgs::Odometry& msg) {
-  if (FLAGS_v > 0) {
-    printf("Odometry t=%f\n", msg.header.stamp.toSec());
-  }
-  const Vector2f odom_loc(msg.pose.pose.position.x, msg.pose.pose.position.y);
-  const float odom_angle =
-      2.0 * atan2(msg.pose.pose.orientation.z, msg.pose.pose.orientation.w);
-  slam_.ObserveOdometry(odom_loc, odom_angle);
-}
-
-
 int main(int argc, char** argv) {
   google::ParseCommandLineFlags(&argc, &argv, false);
+  if (!FLAGS_trace.empty()) util::trace::Start(FLAGS_trace);
+  util::ThreadPool::Options pool_options;
+  pool_options.num_threads = FLAGS_threads;
+  pool_options.nice = FLAGS_thread_nice;
+  util::ThreadPool::ConfigureShared(pool_options);
   // Initialize ROS.
   ros::init(argc, argv, "slam");
   ros::NodeHandle n;
-  InitializeMsgs();
-
-  visualization_publisher_ =
-      n.advertise<VisualizationMsg>("visualization", 1);
-  localization_publisher_ =
-      n.advertise<amrl_msgs::Localization2DMsg>("localization", 1);
 
-  ros::Subscriber laser_sub = n.subscribe(
-      FLAGS_laser_topic.c_str(),
-      1,
-      LaserCallback);
-  ros::Subscriber odom_sub = n.subscribe(
-      FLAGS_odom_topic.c_str(),
-      1,
-      OdometryCallback);
+  slam::SlamNode node(&n, FLAGS_laser_topic, FLAGS_odom_topic, FLAGS_loc_topic);
+  ros_helpers::MetricsPublisher metrics_publisher(
+      &n, "slam", FLAGS_metrics_period, FLAGS_metrics_file);
+  // Runs on the same thread as the callbacks, between scans.
+  ros::WallTimer stats_timer = n.createWallTimer(
+      ros::WallDuration(0.1), [&](const ros::WallTimerEvent&) {
+        metrics_publisher.Update();
+        if (FLAGS_v > 0) {
+          CumulativeFunctionTimer::PrintAllStatsEvery(5.0, stdout);
+        }
+      });
   ros::spin();
 
   return 0;
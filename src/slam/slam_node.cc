@@ -0,0 +1,130 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+\file    slam_node.cc
+\brief   ROS interface of SLAM
+\author  Joydeep Biswas, (C) 2019
+*/
+//========================================================================
+
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "eigen3/Eigen/Dense"
+#include "amrl_msgs/Localization2DMsg.h"
+#include "amrl_msgs/VisualizationMsg.h"
+#include "gflags/gflags.h"
+#include "nav_msgs/Odometry.h"
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+
+#include "shared/util/timer.h"
+#include "shared/util/trace.h"
+
+#include "slam_node.h"
+#include "visualization/visualization.h"
+#include "visualization/viz_channel.h"
+
+using amrl_msgs::Localization2DMsg;
+using amrl_msgs::VisualizationMsg;
+using std::string;
+using std::vector;
+using Eigen::Vector2f;
+
+DECLARE_int32(v);
+
+namespace slam {
+
+SlamNode::SlamNode(ros::NodeHandle* n,
+                   const string& laser_topic,
+                   const string& odom_topic,
+                   const string& loc_topic) :
+    vis_builder_("map", "slam"),
+    grid_builder_("base_link", "slam_local"),
+    t_last_map_(0) {
+  visualization_publisher_ =
+      n->advertise<VisualizationMsg>("visualization", 1);
+  localization_publisher_ = n->advertise<Localization2DMsg>(loc_topic, 1);
+  laser_sub_ = n->subscribe(laser_topic, 1, &SlamNode::LaserCallback, this);
+  odom_sub_ = n->subscribe(odom_topic, 1, &SlamNode::OdometryCallback, this);
+}
+
+void SlamNode::PublishMap() {
+  if (!visualization::kVisualizationEnabled) return;
+  TRACE_FUNCTION();
+  if (GetMonotonicTime() - t_last_map_ < 0.5) {
+    // Rate-limit visualization.
+    visualization::PublishVisualizationMsg(visualization_publisher_,
+                                           grid_builder_.Message());
+    return;
+  }
+  t_last_map_ = GetMonotonicTime();
+  VisualizationMsg& vis_msg = vis_builder_.Begin();
+
+  const vector<Vector2f> map = slam_.GetMap();
+  printf("Map: %lu points\n", map.size());
+  visualization::DrawPoints(map, 0xC0C0C0, vis_msg);
+  vis_builder_.Finish();
+  visualization::PublishVisualizationMsg(visualization_publisher_, vis_msg);
+  visualization::PublishVisualizationMsg(visualization_publisher_,
+                                         grid_builder_.Message());
+}
+
+void SlamNode::PublishPose() {
+  TRACE_FUNCTION();
+  Vector2f robot_loc(0, 0);
+  float robot_angle(0);
+  slam_.GetPose(&robot_loc, &robot_angle);
+  // Subscribers in this process receive this very message, so it must not
+  // be reused once published.
+  Localization2DMsg::Ptr localization_msg(new Localization2DMsg());
+  localization_msg->pose.x = robot_loc.x();
+  localization_msg->pose.y = robot_loc.y();
+  localization_msg->pose.theta = robot_angle;
+  localization_publisher_.publish(localization_msg);
+}
+
+void SlamNode::LaserCallback(const sensor_msgs::LaserScan::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  if (FLAGS_v > 0) {
+    printf("Laser t=%f\n", msg->header.stamp.toSec());
+  }
+  slam_.ObserveLaser(
+      msg->ranges,
+      msg->range_min,
+      msg->range_max,
+      msg->angle_min,
+      msg->angle_max,
+      grid_builder_.Begin());
+  grid_builder_.Finish();
+  PublishMap();
+  PublishPose();
+}
+
+void SlamNode::OdometryCallback(const nav_msgs::Odometry::ConstPtr& msg) {
+  TRACE_FUNCTION();
+  if (FLAGS_v > 0) {
+    printf("Odometry t=%f\n", msg->header.stamp.toSec());
+  }
+  const Vector2f odom_loc(msg->pose.pose.position.x,
+                          msg->pose.pose.position.y);
+  const float odom_angle =
+      2.0 * atan2(msg->pose.pose.orientation.z, msg->pose.pose.orientation.w);
+  slam_.ObserveOdometry(odom_loc, odom_angle);
+}
+
+}  // namespace slam
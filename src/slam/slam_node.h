@@ -0,0 +1,69 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+\file    slam_node.h
+\brief   ROS interface of SLAM, used by the slam node and by the
+         single-process robot node
+\author  Joydeep Biswas, (C) 2019
+*/
+//========================================================================
+
+#include <string>
+
+#include "amrl_msgs/Localization2DMsg.h"
+#include "amrl_msgs/VisualizationMsg.h"
+#include "nav_msgs/Odometry.h"
+#include "ros/ros.h"
+#include "sensor_msgs/LaserScan.h"
+
+#include "slam.h"
+#include "visualization/visualization.h"
+
+#ifndef SRC_SLAM_NODE_H_
+#define SRC_SLAM_NODE_H_
+
+namespace slam {
+
+class SlamNode {
+ public:
+  // Subscribes and advertises through @n, so the callbacks run on the
+  // callback queue of @n. Messages are received and published as shared
+  // pointers, so components in the same process hand them over without
+  // serializing or copying them.
+  SlamNode(ros::NodeHandle* n,
+           const std::string& laser_topic,
+           const std::string& odom_topic,
+           const std::string& loc_topic);
+
+ private:
+  void LaserCallback(const sensor_msgs::LaserScan::ConstPtr& msg);
+  void OdometryCallback(const nav_msgs::Odometry::ConstPtr& msg);
+
+  void PublishMap();
+  void PublishPose();
+
+  SLAM slam_;
+  ros::Publisher visualization_publisher_;
+  ros::Publisher localization_publisher_;
+  ros::Subscriber laser_sub_;
+  ros::Subscriber odom_sub_;
+  visualization::MessageBuilder vis_builder_;
+  visualization::MessageBuilder grid_builder_;
+  double t_last_map_;
+};
+
+}  // namespace slam
+
+#endif  // SRC_SLAM_NODE_H_
@@ -22,6 +22,8 @@
 #include "stdio.h"
 
 #include <algorithm>
+#include <map>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -32,6 +34,7 @@
 #include "shared/math/geometry.h"
 #include "shared/math/line2d.h"
 #include "shared/math/math_util.h"
+#include "shared/util/pthread_utils.h"
 #include "shared/util/timer.h"
 #include "vector_map.h"
 
@@ -40,6 +43,7 @@ using math_util::RadToDeg;
 using geometry::Cross;
 using geometry::Line;
 using geometry::line2f;
+using std::shared_ptr;
 using std::string;
 using std::vector;
 using Eigen::Vector2f;
@@ -385,6 +389,32 @@ void VectorMap::Load(const string& file) {
   file_name = file;
 }
 
+shared_ptr<const VectorMap> LoadShared(const string& file) {
+  typedef std::map<string, std::weak_ptr<const VectorMap>> MapCache;
+  static RcuThreadSafe<MapCache> cache;
+  // Finding a map that is already loaded takes no lock.
+  {
+    const shared_ptr<const MapCache> maps = cache.Get();
+    const auto it = maps->find(file);
+    if (it != maps->end()) {
+      shared_ptr<const VectorMap> map = it->second.lock();
+      if (map) return map;
+    }
+  }
+  // Parse the file without blocking lookups of other maps. If another
+  // thread loaded the same file meanwhile, share its copy instead.
+  shared_ptr<const VectorMap> map = std::make_shared<VectorMap>(file);
+  cache.Update([&file, &map](MapCache* maps) {
+    shared_ptr<const VectorMap> loaded = (*maps)[file].lock();
+    if (loaded) {
+      map = loaded;
+    } else {
+      (*maps)[file] = map;
+    }
+  });
+  return map;
+}
+
 bool VectorMap::Intersects(const Vector2f& v0, const Vector2f& v1) const {
   for (const line2f& l : lines) {
     if (l.Intersects(v0, v1)) return true;
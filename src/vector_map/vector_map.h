@@ -19,6 +19,7 @@
 */
 //========================================================================
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -78,6 +79,9 @@ struct VectorMap {
   std::string file_name;
 };
 
+// Load the map in @file, or return the instance already loaded by another
+// component of the same process. The map is freed once no one holds it.
+std::shared_ptr<const VectorMap> LoadShared(const std::string& file);
 
 
 }  // namespace vector_map
@@ -19,7 +19,9 @@
 */
 //========================================================================
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "eigen3/Eigen/Dense"
 #include "amrl_msgs/Pose2Df.h"
@@ -28,8 +30,11 @@
 #include "amrl_msgs/PathVisualization.h"
 #include "amrl_msgs/ColoredPoint2D.h"
 #include "amrl_msgs/VisualizationMsg.h"
+#include "glog/logging.h"
 #include "ros/ros.h"
 
+#include "shared/util/metrics.h"
+#include "shared/util/timer.h"
 #include "visualization.h"
 
 using Eigen::Vector2f;
@@ -40,6 +45,7 @@ using amrl_msgs::Pose2Df;
 using amrl_msgs::PathVisualization;
 using amrl_msgs::VisualizationMsg;
 using std::string;
+using std::vector;
 
 namespace {
 template <class T1, class T2>
@@ -48,6 +54,21 @@ void SetPoint(const T1& p1, T2* p2) {
   p2->y = p1.y();
 }
 
+vector<double> ByteBounds() {
+  vector<double> bounds;
+  for (double b = 256; b <= 64 * 1024 * 1024; b *= 4) bounds.push_back(b);
+  return bounds;
+}
+
+util::metrics::Histogram message_bytes_(
+    "visualization_message_bytes",
+    "Serialized size of published visualization messages",
+    ByteBounds());
+util::metrics::Histogram publish_time_(
+    "visualization_publish_seconds",
+    "Time to publish a visualization message, including serialization",
+    util::metrics::LatencyBounds());
+
 }  // namespace
 
 namespace visualization {
@@ -138,4 +159,101 @@ void DrawPathOption(const float curvature,
   option.clearance = clearance;
   msg.path_options.push_back(option);
 }
+
+void DrawPoints(const vector<Vector2f>& points,
+                uint32_t color,
+                VisualizationMsg& msg) {
+  const size_t start = msg.points.size();
+  msg.points.resize(start + points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    ColoredPoint2D& point = msg.points[start + i];
+    SetPoint(points[i], &point.point);
+    point.color = color;
+  }
+}
+
+void DrawLines(const vector<Vector2f>& p0,
+               const vector<Vector2f>& p1,
+               uint32_t color,
+               VisualizationMsg& msg) {
+  CHECK_EQ(p0.size(), p1.size());
+  const size_t start = msg.lines.size();
+  msg.lines.resize(start + p0.size());
+  for (size_t i = 0; i < p0.size(); ++i) {
+    ColoredLine2D& line = msg.lines[start + i];
+    SetPoint(p0[i], &line.p0);
+    SetPoint(p1[i], &line.p1);
+    line.color = color;
+  }
+}
+
+void DrawLineStrip(const vector<Vector2f>& points,
+                   uint32_t color,
+                   VisualizationMsg& msg) {
+  if (points.size() < 2) return;
+  const size_t start = msg.lines.size();
+  msg.lines.resize(start + points.size() - 1);
+  for (size_t i = 0; i + 1 < points.size(); ++i) {
+    ColoredLine2D& line = msg.lines[start + i];
+    SetPoint(points[i], &line.p0);
+    SetPoint(points[i + 1], &line.p1);
+    line.color = color;
+  }
+}
+
+void DrawCrosses(const vector<Vector2f>& locations,
+                 float size,
+                 uint32_t color,
+                 VisualizationMsg& msg) {
+  const Vector2f d0(size, size);
+  const Vector2f d1(size, -size);
+  const size_t start = msg.lines.size();
+  msg.lines.resize(start + 2 * locations.size());
+  for (size_t i = 0; i < locations.size(); ++i) {
+    ColoredLine2D& line0 = msg.lines[start + 2 * i];
+    ColoredLine2D& line1 = msg.lines[start + 2 * i + 1];
+    SetPoint(Vector2f(locations[i] + d0), &line0.p0);
+    SetPoint(Vector2f(locations[i] - d0), &line0.p1);
+    SetPoint(Vector2f(locations[i] + d1), &line1.p0);
+    SetPoint(Vector2f(locations[i] - d1), &line1.p1);
+    line0.color = color;
+    line1.color = color;
+  }
+}
+
+MessageBuilder::MessageBuilder(const string& frame, const string& ns) :
+    msg_(NewVisualizationMessage(frame, ns)),
+    max_particles_(0),
+    max_path_options_(0),
+    max_points_(0),
+    max_lines_(0),
+    max_arcs_(0) {}
+
+VisualizationMsg& MessageBuilder::Begin() {
+  ClearVisualizationMsg(msg_);
+  msg_.particles.reserve(max_particles_);
+  msg_.path_options.reserve(max_path_options_);
+  msg_.points.reserve(max_points_);
+  msg_.lines.reserve(max_lines_);
+  msg_.arcs.reserve(max_arcs_);
+  return msg_;
+}
+
+void MessageBuilder::Finish() {
+  max_particles_ = std::max(max_particles_, msg_.particles.size());
+  max_path_options_ = std::max(max_path_options_, msg_.path_options.size());
+  max_points_ = std::max(max_points_, msg_.points.size());
+  max_lines_ = std::max(max_lines_, msg_.lines.size());
+  max_arcs_ = std::max(max_arcs_, msg_.arcs.size());
+}
+
+void PublishVisualizationMsg(const ros::Publisher& publisher,
+                             VisualizationMsg& msg) {
+  if (!publisher) return;
+  msg.header.stamp = ros::Time::now();
+  message_bytes_.Observe(ros::serialization::serializationLength(msg));
+  const double t_start = GetMonotonicTime();
+  publisher.publish(msg);
+  publish_time_.Observe(GetMonotonicTime() - t_start);
+}
 }  // namespace visualization
@@ -22,9 +22,14 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
 #include "eigen3/Eigen/Dense"
 #include "amrl_msgs/VisualizationMsg.h"
+#include "ros/ros.h"
+
+#ifndef VISUALIZATION_H
+#define VISUALIZATION_H
 
 namespace visualization {
 
@@ -70,4 +75,72 @@ void DrawPathOption(const float curvature,
                     const float clearance,
                     amrl_msgs::VisualizationMsg& msg);
 
+// Bulk versions of the above, which grow the message once per call rather
+// than once per element.
+
+// Add points of the same color.
+void DrawPoints(const std::vector<Eigen::Vector2f>& points,
+                uint32_t color,
+                amrl_msgs::VisualizationMsg& msg);
+
+// Add lines from p0[i] to p1[i]. Both arrays must have the same size.
+void DrawLines(const std::vector<Eigen::Vector2f>& p0,
+               const std::vector<Eigen::Vector2f>& p1,
+               uint32_t color,
+               amrl_msgs::VisualizationMsg& msg);
+
+// Add lines joining consecutive points.
+void DrawLineStrip(const std::vector<Eigen::Vector2f>& points,
+                   uint32_t color,
+                   amrl_msgs::VisualizationMsg& msg);
+
+// Add a "X" at each location.
+void DrawCrosses(const std::vector<Eigen::Vector2f>& locations,
+                 float size,
+                 uint32_t color,
+                 amrl_msgs::VisualizationMsg& msg);
+
+// A visualization message that is redrawn and published over and over.
+// Clearing it keeps the memory of its element lists, and Begin() reserves as
+// much as the largest message built so far, so that once warmed up, drawing
+// does not allocate.
+// ==============================
+// MessageBuilder builder("map", "particle_filter");
+// void Publish() {
+//   amrl_msgs::VisualizationMsg& msg = builder.Begin();
+//   DrawPoints(points, 0x06990d, msg);
+//   builder.Finish();
+//   PublishVisualizationMsg(publisher, msg);
+// }
+// ==============================
+class MessageBuilder {
+ public:
+  MessageBuilder(const std::string& frame, const std::string& ns);
+
+  // Clear the message, and return it to draw into.
+  amrl_msgs::VisualizationMsg& Begin();
+
+  // Record the size of the drawn message for the next Begin().
+  void Finish();
+
+  amrl_msgs::VisualizationMsg& Message() { return msg_; }
+
+ private:
+  amrl_msgs::VisualizationMsg msg_;
+  // Largest number of each element type drawn so far.
+  size_t max_particles_;
+  size_t max_path_options_;
+  size_t max_points_;
+  size_t max_lines_;
+  size_t max_arcs_;
+};
+
+// Stamp and publish @msg, recording its serialized size and the time taken
+// to publish it, which includes serializing it for every remote subscriber,
+// in the visualization_* metrics.
+void PublishVisualizationMsg(const ros::Publisher& publisher,
+                             amrl_msgs::VisualizationMsg& msg);
+
 }  // namespace visualization
+
+#endif  // VISUALIZATION_H
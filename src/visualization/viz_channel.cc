@@ -0,0 +1,168 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+
+#include <stdint.h>
+#include <string.h>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "amrl_msgs/VisualizationMsg.h"
+
+#include "visualization.h"
+#include "viz_channel.h"
+
+using amrl_msgs::VisualizationMsg;
+using std::string;
+using std::vector;
+
+namespace {
+
+// FNV-1a hash of the drawn elements, field by field, since the message
+// structs carry more than their fields.
+class Hasher {
+ public:
+  Hasher() : hash_(14695981039346656037ULL) {}
+
+  void Add(uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+      hash_ ^= (value >> (8 * i)) & 0xFF;
+      hash_ *= 1099511628211ULL;
+    }
+  }
+
+  void Add(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    Add(bits);
+  }
+
+  template <class Point>
+  void AddPoint(const Point& p) {
+    Add(static_cast<float>(p.x));
+    Add(static_cast<float>(p.y));
+  }
+
+  uint64_t Hash() const { return hash_; }
+
+ private:
+  uint64_t hash_;
+};
+
+uint64_t HashElements(const VisualizationMsg& msg) {
+  Hasher hasher;
+  for (const auto& p : msg.particles) {
+    hasher.Add(static_cast<float>(p.x));
+    hasher.Add(static_cast<float>(p.y));
+    hasher.Add(static_cast<float>(p.theta));
+  }
+  for (const auto& p : msg.path_options) {
+    hasher.Add(static_cast<float>(p.curvature));
+    hasher.Add(static_cast<float>(p.distance));
+    hasher.Add(static_cast<float>(p.clearance));
+  }
+  for (const auto& p : msg.points) {
+    hasher.AddPoint(p.point);
+    hasher.Add(static_cast<uint32_t>(p.color));
+  }
+  for (const auto& l : msg.lines) {
+    hasher.AddPoint(l.p0);
+    hasher.AddPoint(l.p1);
+    hasher.Add(static_cast<uint32_t>(l.color));
+  }
+  for (const auto& a : msg.arcs) {
+    hasher.AddPoint(a.center);
+    hasher.Add(static_cast<float>(a.radius));
+    hasher.Add(static_cast<float>(a.start_angle));
+    hasher.Add(static_cast<float>(a.end_angle));
+    hasher.Add(static_cast<uint32_t>(a.color));
+  }
+  // Separate the element types, so that moving an element from one list to
+  // the next changes the hash.
+  hasher.Add(static_cast<uint32_t>(msg.particles.size()));
+  hasher.Add(static_cast<uint32_t>(msg.path_options.size()));
+  hasher.Add(static_cast<uint32_t>(msg.points.size()));
+  hasher.Add(static_cast<uint32_t>(msg.lines.size()));
+  hasher.Add(static_cast<uint32_t>(msg.arcs.size()));
+  return hasher.Hash();
+}
+
+// Keep @n elements of @v, picked with a uniform stride so that the remaining
+// elements still cover the whole layer. Returns the number dropped.
+template <class T>
+size_t Decimate(size_t n, vector<T>* v) {
+  const size_t size = v->size();
+  if (n >= size) return 0;
+  for (size_t i = 0; i < n; ++i) {
+    (*v)[i] = (*v)[i * size / n];
+  }
+  v->resize(n);
+  return size - n;
+}
+
+}  // namespace
+
+namespace visualization {
+
+const double VizChannel::kRefreshPeriod = 5.0;
+
+VizChannel::VizChannel(const string& frame,
+                       const string& ns,
+                       double min_period,
+                       size_t max_elements) :
+    builder_(frame, ns),
+    min_period_(min_period),
+    max_elements_(max_elements),
+    t_drawn_(-std::numeric_limits<double>::infinity()),
+    t_published_(-std::numeric_limits<double>::infinity()),
+    hash_(0),
+    num_published_(0),
+    num_unchanged_(0),
+    num_decimated_(0) {}
+
+VisualizationMsg& VizChannel::Begin() {
+  return builder_.Begin();
+}
+
+bool VizChannel::Finish(double now) {
+  t_drawn_ = now;
+  builder_.Finish();
+  VisualizationMsg& msg = builder_.Message();
+  const size_t total = msg.particles.size() + msg.path_options.size() +
+      msg.points.size() + msg.lines.size() + msg.arcs.size();
+  if (total > max_elements_) {
+    // Scale every element type down by the same factor.
+    const double scale = static_cast<double>(max_elements_) / total;
+    num_decimated_ +=
+        Decimate(msg.particles.size() * scale, &msg.particles) +
+        Decimate(msg.path_options.size() * scale, &msg.path_options) +
+        Decimate(msg.points.size() * scale, &msg.points) +
+        Decimate(msg.lines.size() * scale, &msg.lines) +
+        Decimate(msg.arcs.size() * scale, &msg.arcs);
+  }
+
+  const uint64_t hash = HashElements(msg);
+  if (hash == hash_ && now - t_published_ < kRefreshPeriod) {
+    ++num_unchanged_;
+    return false;
+  }
+  hash_ = hash;
+  t_published_ = now;
+  ++num_published_;
+  return true;
+}
+
+}  // namespace visualization
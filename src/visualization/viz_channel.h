@@ -0,0 +1,100 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+//
+// A VizChannel is one visualization layer (one message namespace) with its
+// own redraw rate and element budget. A layer is redrawn only when it is due,
+// thinned out by a uniform stride when it is over budget, and published only
+// when its contents changed or the last copy is getting old:
+// ==============================
+// VizChannel frontier("map", "frontier", 1.0, 2000);
+// if (frontier.Due(now)) {
+//   planner.PlotFrontier(frontier.Begin());
+//   if (frontier.Finish(now)) viz_pub.publish(frontier.Message());
+// }
+// ==============================
+// Building with -DVISUALIZATION_DISABLED makes kVisualizationEnabled false,
+// so that code guarded by it is compiled away.
+
+#include <stdint.h>
+
+#include <string>
+
+#include "amrl_msgs/VisualizationMsg.h"
+#include "visualization/visualization.h"
+
+#ifndef VIZ_CHANNEL_H
+#define VIZ_CHANNEL_H
+
+namespace visualization {
+
+#ifdef VISUALIZATION_DISABLED
+const bool kVisualizationEnabled = false;
+#else
+const bool kVisualizationEnabled = true;
+#endif
+
+class VizChannel {
+ public:
+  // @min_period is the minimum time between redraws in seconds, and
+  // @max_elements the number of points, lines, arcs, particles and path
+  // options that the layer may publish.
+  VizChannel(const std::string& frame,
+             const std::string& ns,
+             double min_period,
+             size_t max_elements);
+
+  // Whether the layer should be redrawn at time @now.
+  bool Due(double now) const { return now - t_drawn_ >= min_period_; }
+
+  // Time since the layer was last redrawn.
+  double Staleness(double now) const { return now - t_drawn_; }
+
+  // Clear the layer and return the message to draw it into.
+  amrl_msgs::VisualizationMsg& Begin();
+
+  // Mark the layer as redrawn at time @now, and apply the element budget to
+  // it. Returns true if it should be published, i.e. it changed since it was
+  // last published, or the last copy is older than the refresh period.
+  bool Finish(double now);
+
+  amrl_msgs::VisualizationMsg& Message() { return builder_.Message(); }
+
+  // Number of times the layer was published, or redrawn but skipped because
+  // it had not changed.
+  uint64_t NumPublished() const { return num_published_; }
+  uint64_t NumUnchanged() const { return num_unchanged_; }
+  // Number of elements dropped to stay within the budget.
+  uint64_t NumDecimated() const { return num_decimated_; }
+
+ private:
+  // Unchanged layers are republished after this many seconds, so that late
+  // subscribers and dropped messages are eventually caught up.
+  static const double kRefreshPeriod;
+
+  MessageBuilder builder_;
+  const double min_period_;
+  const size_t max_elements_;
+  double t_drawn_;
+  double t_published_;
+  // Hash of the contents last published.
+  uint64_t hash_;
+  uint64_t num_published_;
+  uint64_t num_unchanged_;
+  uint64_t num_decimated_;
+};
+
+}  // namespace visualization
+
+#endif  // VIZ_CHANNEL_H